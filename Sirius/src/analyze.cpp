@@ -0,0 +1,254 @@
+#include "analyze.h"
+#include "movegen.h"
+#include "search.h"
+#include "uci/fen.h"
+#include "uci/move.h"
+#include "uci/wdl.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+constexpr u64 PROGRESS_INTERVAL = 1000;
+
+struct EpdPosition
+{
+    std::string fen;
+    std::string id;
+    // san moves from the bm and am operations
+    std::vector<std::string> bestMoves;
+    std::vector<std::string> avoidMoves;
+};
+
+// the fen fields, with the move counters if they are there, followed by operations
+// that each end with a semicolon, such as `bm Nf3 Qd1;` or `id "position 1";`
+EpdPosition parseEpdLine(const std::string& line)
+{
+    EpdPosition position;
+    std::istringstream stream(line);
+    std::string field;
+    for (i32 i = 0; i < 4 && stream >> field; i++)
+        position.fen += (i > 0 ? " " : "") + field;
+
+    std::string operations;
+    std::getline(stream, operations);
+    std::istringstream counters(operations);
+    std::string halfMove, fullMove;
+    auto isNumber = [](const std::string& str)
+    {
+        return std::all_of(
+            str.begin(), str.end(), [](char c) { return std::isdigit(static_cast<u8>(c)); });
+    };
+    if (counters >> halfMove >> fullMove && isNumber(halfMove) && isNumber(fullMove))
+    {
+        position.fen += " " + halfMove + " " + fullMove;
+        std::getline(counters, operations);
+    }
+
+    std::istringstream opStream(operations);
+    std::string operation;
+    while (std::getline(opStream, operation, ';'))
+    {
+        std::istringstream opTokens(operation);
+        std::string opcode, operand;
+        opTokens >> opcode;
+        if (opcode == "bm" || opcode == "am")
+        {
+            auto& moves = opcode == "bm" ? position.bestMoves : position.avoidMoves;
+            while (opTokens >> operand)
+                moves.push_back(operand);
+        }
+        else if (opcode == "id")
+        {
+            std::getline(opTokens >> std::ws, operand);
+            if (operand.size() >= 2 && operand.front() == '"' && operand.back() == '"')
+                operand = operand.substr(1, operand.size() - 2);
+            position.id = operand;
+        }
+    }
+    return position;
+}
+
+// suites write moves in san with annotations, but some use uci notation instead
+Move parseEpdMove(const Board& board, const MoveList& legalMoves, std::string moveStr)
+{
+    while (!moveStr.empty() && std::string_view("+#!?").find(moveStr.back()) != std::string::npos)
+        moveStr.pop_back();
+    auto find = uci::findMoveFromSAN(board, legalMoves, moveStr.c_str());
+    if (find.result != uci::MoveStrFind::Result::FOUND)
+        find = uci::findMoveFromUCI(board, legalMoves, moveStr.c_str());
+    return find.result == uci::MoveStrFind::Result::FOUND ? find.move : Move::nullmove();
+}
+
+std::string scoreString(i32 score)
+{
+    if (!isMateScore(score))
+        return "cp " + std::to_string(uci::normalizedScore(score));
+    if (score > 0)
+        return "mate " + std::to_string((SCORE_MATE - score + 1) / 2);
+    return "mate -" + std::to_string((score + SCORE_MATE) / 2);
+}
+
+struct AnalyzeStats
+{
+    std::atomic<u64> analyzed = 0;
+    // positions with bm or am operations
+    std::atomic<u64> tested = 0;
+    std::atomic<u64> solved = 0;
+};
+
+// the result line for the position, and whether it was solved if it has a test
+std::pair<std::string, std::optional<bool>> analyzePosition(
+    search::Search& search, const SearchLimits& limits, const EpdPosition& position)
+{
+    if (!uci::isValidFen(position.fen.c_str()))
+        return {"invalid fen", std::nullopt};
+
+    Board board;
+    board.setToFen(position.fen.c_str());
+    MoveList legalMoves;
+    genMoves<MoveGenType::LEGAL>(board, legalMoves);
+    if (legalMoves.size() == 0)
+        return {"no legal moves", std::nullopt};
+
+    SearchInfo info = search.analysisSearch(limits, board);
+    Move bestMove = info.pv[0];
+
+    std::ostringstream result;
+    result << "bestmove " << uci::convMoveToSAN(board, legalMoves, bestMove) << " score "
+           << scoreString(info.score) << " depth " << info.depth << " nodes " << info.nodes
+           << " pv";
+    Board pvBoard = board;
+    for (Move move : info.pv)
+    {
+        result << ' ' << uci::convMoveToUCI(pvBoard, move);
+        pvBoard.makeMove(move);
+    }
+
+    if (position.bestMoves.empty() && position.avoidMoves.empty())
+        return {result.str(), std::nullopt};
+
+    auto contains = [&](const std::vector<std::string>& moves)
+    {
+        return std::any_of(moves.begin(), moves.end(), [&](const std::string& move)
+            { return parseEpdMove(board, legalMoves, move) == bestMove; });
+    };
+    bool solved = (position.bestMoves.empty() || contains(position.bestMoves))
+        && !contains(position.avoidMoves);
+    result << (solved ? " solved" : " failed");
+    return {result.str(), solved};
+}
+
+}
+
+void analyzeEpd(const AnalyzeConfig& config)
+{
+    std::ifstream epdFile(config.epdFilename);
+    if (!epdFile.is_open())
+    {
+        std::cout << "Could not open file " << config.epdFilename << std::endl;
+        return;
+    }
+
+    std::vector<EpdPosition> positions;
+    std::string line;
+    for (u64 lineNumber = 1; std::getline(epdFile, line); lineNumber++)
+    {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (line.find_first_not_of(" \t") == std::string::npos)
+            continue;
+        positions.push_back(parseEpdLine(line));
+        if (positions.back().id.empty())
+            positions.back().id = "line " + std::to_string(lineNumber);
+    }
+
+    std::ofstream outFile;
+    if (!config.outputFilename.empty())
+    {
+        outFile.open(config.outputFilename);
+        if (!outFile.is_open())
+        {
+            std::cout << "Could not open file " << config.outputFilename << std::endl;
+            return;
+        }
+    }
+    std::ostream& out = outFile.is_open() ? outFile : std::cout;
+
+    SearchLimits limits = {};
+    limits.maxDepth = config.depth > 0 ? config.depth : MAX_PLY;
+    limits.maxNodes = config.nodes;
+    limits.maxTime = Duration(config.movetime);
+
+    // one search per thread rather than one search with many threads, since each
+    // search is short and positions are independent
+    std::vector<std::unique_ptr<search::Search>> searches;
+    usize hashPerThread = std::max<usize>(config.hashMB / config.numThreads, 1);
+    for (u32 i = 0; i < config.numThreads; i++)
+        searches.push_back(std::make_unique<search::Search>(hashPerThread));
+
+    AnalyzeStats stats;
+    std::mutex outputMutex;
+    auto startTime = std::chrono::steady_clock::now();
+    auto printProgress = [&]()
+    {
+        f64 seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - startTime)
+                          .count();
+        u64 analyzed = stats.analyzed.load();
+        std::cout << "Analyzed " << analyzed << " of " << positions.size() << " positions in "
+                  << seconds << " seconds, "
+                  << static_cast<u64>(static_cast<f64>(analyzed) / std::max(seconds, 1e-3))
+                  << " positions/s";
+        if (stats.tested > 0)
+        {
+            std::cout << ", solved " << stats.solved << " of " << stats.tested << " ("
+                      << 100.0 * static_cast<f64>(stats.solved) / static_cast<f64>(stats.tested)
+                      << "%)";
+        }
+        std::cout << std::endl;
+    };
+
+    {
+        std::atomic<usize> nextPosition = 0;
+        std::vector<std::jthread> threads;
+        threads.reserve(config.numThreads);
+        for (auto& search : searches)
+        {
+            threads.emplace_back(
+                [&, searchPtr = search.get()]()
+                {
+                    usize idx;
+                    while ((idx = nextPosition.fetch_add(1)) < positions.size())
+                    {
+                        auto [result, solved] = analyzePosition(*searchPtr, limits, positions[idx]);
+
+                        std::lock_guard<std::mutex> guard(outputMutex);
+                        out << positions[idx].id << ": " << result << '\n';
+                        if (solved.has_value())
+                        {
+                            stats.tested++;
+                            stats.solved += *solved;
+                        }
+                        // results are streamed, so they can be followed as they are found
+                        out.flush();
+                        if (++stats.analyzed % PROGRESS_INTERVAL == 0)
+                            printProgress();
+                    }
+                });
+        }
+    }
+
+    printProgress();
+}
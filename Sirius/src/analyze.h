@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+
+#include "defs.h"
+
+struct AnalyzeConfig
+{
+    std::string epdFilename;
+    // empty to print the results instead
+    std::string outputFilename;
+    // 0 for no limit
+    u64 nodes;
+    i32 depth;
+    i64 movetime;
+    u32 numThreads;
+    // split evenly between the threads
+    i32 hashMB;
+};
+
+// searches every position of an EPD file, each on one thread with a slice of the hash, and
+// prints each result as soon as it is found. Positions with bm or am operations are scored
+// as solved if the best move is one of the bm moves and none of the am moves
+void analyzeEpd(const AnalyzeConfig& config);
@@ -0,0 +1,141 @@
+#include "engine.h"
+#include "../attacks.h"
+#include "../cuckoo.h"
+#include "../eval/endgame.h"
+#include "../eval/nnue.h"
+#include "../movegen.h"
+#include "../uci/fen.h"
+#include "../uci/move.h"
+
+#include <algorithm>
+#include <mutex>
+
+namespace sirius
+{
+
+void init()
+{
+    static std::once_flag initFlag;
+    std::call_once(initFlag,
+        []()
+        {
+            attacks::init();
+            cuckoo::init();
+            search::init();
+            eval::endgames::init();
+            eval::nnue::init();
+        });
+}
+
+// the board needs the attack tables, so they have to be set up before it is constructed
+Engine::Engine()
+    : m_Board((init(), Board()))
+{
+    m_Search.setReporter(this);
+}
+
+Engine::~Engine()
+{
+    // the callbacks may refer to things that are destroyed along with the engine
+    m_Search.stop();
+    m_Search.setReporter(nullptr);
+}
+
+void Engine::setHashSize(i32 mb)
+{
+    m_Search.stop();
+    m_Search.setTTSize(std::max(mb, 1));
+}
+
+void Engine::setThreads(i32 count)
+{
+    m_Search.stop();
+    m_Search.setThreads(std::max(count, 1));
+}
+
+void Engine::newGame()
+{
+    m_Search.stop();
+    m_Search.newGame();
+}
+
+bool Engine::setPosition(const std::string& fen, const std::vector<std::string>& moves, bool frc)
+{
+    if (!uci::isValidFen(fen.c_str()))
+        return false;
+
+    Board board;
+    board.setToFen(fen.c_str(), frc);
+    for (const std::string& moveStr : moves)
+    {
+        MoveList legalMoves;
+        genMoves<MoveGenType::LEGAL>(board, legalMoves);
+        auto find = uci::findMoveFromUCI(board, legalMoves, moveStr.c_str());
+        if (find.result != uci::MoveStrFind::Result::FOUND)
+            return false;
+        board.makeMove(find.move);
+    }
+
+    m_Search.stop();
+    m_Board = board;
+    return true;
+}
+
+const Board& Engine::board() const
+{
+    return m_Board;
+}
+
+std::string Engine::moveToString(Move move) const
+{
+    return uci::convMoveToUCI(m_Board, move);
+}
+
+void Engine::setInfoCallback(InfoCallback callback)
+{
+    m_Search.stop();
+    m_InfoCallback = std::move(callback);
+}
+
+void Engine::setBestMoveCallback(BestMoveCallback callback)
+{
+    m_Search.stop();
+    m_BestMoveCallback = std::move(callback);
+}
+
+void Engine::go(const SearchLimits& limits)
+{
+    SearchLimits searchLimits = limits;
+    if (searchLimits.maxDepth == 0)
+        searchLimits.maxDepth = MAX_PLY;
+    m_Search.run(searchLimits, m_Board);
+}
+
+void Engine::stop()
+{
+    m_Search.stop();
+}
+
+void Engine::wait()
+{
+    m_Search.wait();
+}
+
+bool Engine::searching() const
+{
+    return m_Search.searching();
+}
+
+void Engine::reportSearchInfo(const SearchInfo& info) const
+{
+    if (m_InfoCallback)
+        m_InfoCallback(info);
+}
+
+void Engine::reportBestMove(Move bestMove) const
+{
+    if (m_BestMoveCallback)
+        m_BestMoveCallback(bestMove);
+}
+
+}
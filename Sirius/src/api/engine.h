@@ -0,0 +1,71 @@
+#pragma once
+
+#include "../board.h"
+#include "../search.h"
+#include "../time_man.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace sirius
+{
+
+// sets up the tables shared by every engine in the process, which are read only
+// afterwards. Engines call it when they are created, and it only runs once
+void init();
+
+// an engine with its own position, search threads and hash tables, which can be used
+// alongside any number of others in the same process. Searches run on the engine's own
+// threads, and their output is passed to the callbacks from the main search thread
+class Engine : private search::SearchReporter
+{
+public:
+    using InfoCallback = std::function<void(const SearchInfo& info)>;
+    using BestMoveCallback = std::function<void(Move bestMove)>;
+
+    Engine();
+    ~Engine();
+
+    Engine(const Engine&) = delete;
+    Engine& operator=(const Engine&) = delete;
+
+    // these stop any search in progress first
+    void setHashSize(i32 mb);
+    void setThreads(i32 count);
+    // clears the hash tables and histories
+    void newGame();
+
+    // sets the position to fen followed by moves in uci notation, stopping any search
+    // in progress first. Returns false and leaves the position as it was if the fen or
+    // one of the moves isn't valid
+    bool setPosition(const std::string& fen, const std::vector<std::string>& moves = {},
+        bool frc = false);
+    const Board& board() const;
+    // the move in uci notation for the current position
+    std::string moveToString(Move move) const;
+
+    // these also stop any search in progress first
+    void setInfoCallback(InfoCallback callback);
+    void setBestMoveCallback(BestMoveCallback callback);
+
+    // starts searching the current position and returns immediately, after waiting
+    // for the previous search to finish. A maxDepth of 0 means no depth limit, and a
+    // position without legal moves reports a nullmove from the search thread without searching
+    void go(const SearchLimits& limits);
+    void stop();
+    // blocks until the search in progress finishes by itself
+    void wait();
+    bool searching() const;
+
+private:
+    void reportSearchInfo(const SearchInfo& info) const override;
+    void reportBestMove(Move bestMove) const override;
+
+    Board m_Board;
+    search::Search m_Search;
+    InfoCallback m_InfoCallback;
+    BestMoveCallback m_BestMoveCallback;
+};
+
+}
@@ -0,0 +1,155 @@
+#include "sirius_c.h"
+#include "../uci/move.h"
+#include "../uci/wdl.h"
+#include "engine.h"
+
+#include <sstream>
+
+struct sirius_engine
+{
+    sirius::Engine engine;
+};
+
+namespace
+{
+
+// the pv is converted on a copy of the position the search started from
+std::string pvToString(Board board, const std::vector<Move>& pv)
+{
+    std::string result;
+    for (Move move : pv)
+    {
+        if (!result.empty())
+            result += ' ';
+        result += uci::convMoveToUCI(board, move);
+        board.makeMove(move);
+    }
+    return result;
+}
+
+}
+
+extern "C"
+{
+
+sirius_engine* sirius_engine_create(void)
+{
+    return new sirius_engine();
+}
+
+void sirius_engine_destroy(sirius_engine* engine)
+{
+    delete engine;
+}
+
+void sirius_engine_set_hash(sirius_engine* engine, int32_t mb)
+{
+    engine->engine.setHashSize(mb);
+}
+
+void sirius_engine_set_threads(sirius_engine* engine, int32_t count)
+{
+    engine->engine.setThreads(count);
+}
+
+void sirius_engine_new_game(sirius_engine* engine)
+{
+    engine->engine.newGame();
+}
+
+void sirius_engine_set_callbacks(sirius_engine* engine, sirius_info_callback info_callback,
+    sirius_bestmove_callback bestmove_callback, void* user_data)
+{
+    sirius::Engine& cppEngine = engine->engine;
+    if (info_callback)
+    {
+        cppEngine.setInfoCallback(
+            [&cppEngine, info_callback, user_data](const SearchInfo& info)
+            {
+                sirius_search_info cInfo = {};
+                cInfo.depth = info.depth;
+                cInfo.sel_depth = info.selDepth;
+                cInfo.hashfull = info.hashfull;
+                cInfo.nodes = info.nodes;
+                cInfo.time_ms = info.time.count();
+                if (isMateScore(info.score))
+                    cInfo.mate = info.score > 0 ? (SCORE_MATE - info.score + 1) / 2
+                                                : -(info.score + SCORE_MATE) / 2;
+                else
+                    cInfo.score_cp = uci::normalizedScore(info.score);
+                cInfo.lowerbound = info.lowerbound;
+                cInfo.upperbound = info.upperbound;
+                std::string pv = pvToString(cppEngine.board(), info.pv);
+                cInfo.pv = pv.c_str();
+                info_callback(&cInfo, user_data);
+            });
+    }
+    else
+    {
+        cppEngine.setInfoCallback(nullptr);
+    }
+
+    if (bestmove_callback)
+    {
+        cppEngine.setBestMoveCallback(
+            [&cppEngine, bestmove_callback, user_data](Move bestMove)
+            {
+                std::string move = cppEngine.moveToString(bestMove);
+                bestmove_callback(move.c_str(), user_data);
+            });
+    }
+    else
+    {
+        cppEngine.setBestMoveCallback(nullptr);
+    }
+}
+
+int sirius_engine_set_position(
+    sirius_engine* engine, const char* fen, const char* moves, int frc)
+{
+    if (!fen)
+        return 0;
+
+    std::vector<std::string> moveList;
+    if (moves)
+    {
+        std::istringstream stream(moves);
+        std::string move;
+        while (stream >> move)
+            moveList.push_back(move);
+    }
+    return engine->engine.setPosition(fen, moveList, frc != 0);
+}
+
+void sirius_engine_go(sirius_engine* engine, const sirius_limits* limits)
+{
+    SearchLimits searchLimits = {};
+    searchLimits.maxDepth = limits->depth;
+    searchLimits.maxNodes = limits->nodes;
+    searchLimits.maxTime = Duration(limits->movetime_ms);
+    for (i32 color = 0; color < 2; color++)
+    {
+        searchLimits.clock.timeLeft[color] = Duration(limits->time_left_ms[color]);
+        searchLimits.clock.increments[color] = Duration(limits->increment_ms[color]);
+    }
+    searchLimits.clock.enabled = limits->time_left_ms[0] > 0 || limits->time_left_ms[1] > 0;
+    searchLimits.overhead = Duration(limits->overhead_ms);
+    engine->engine.go(searchLimits);
+}
+
+void sirius_engine_stop(sirius_engine* engine)
+{
+    engine->engine.stop();
+}
+
+void sirius_engine_wait(sirius_engine* engine)
+{
+    engine->engine.wait();
+}
+
+int sirius_engine_searching(const sirius_engine* engine)
+{
+    return engine->engine.searching();
+}
+
+}
@@ -0,0 +1,71 @@
+#ifndef SIRIUS_C_H
+#define SIRIUS_C_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// a C interface to sirius::Engine, see api/engine.h
+
+typedef struct sirius_engine sirius_engine;
+
+typedef struct sirius_limits
+{
+    // 0 for no limit on each of these
+    int32_t depth;
+    uint64_t nodes;
+    int64_t movetime_ms;
+    // indexed by white then black, the clock is used if either side has time left
+    int64_t time_left_ms[2];
+    int64_t increment_ms[2];
+    int64_t overhead_ms;
+} sirius_limits;
+
+typedef struct sirius_search_info
+{
+    int32_t depth;
+    int32_t sel_depth;
+    int32_t hashfull;
+    uint64_t nodes;
+    int64_t time_ms;
+    // in centipawns, normalized the same way as the uci output, and 0 for mate scores
+    int32_t score_cp;
+    // moves until mate, negative when being mated, or 0
+    int32_t mate;
+    int32_t lowerbound;
+    int32_t upperbound;
+    // uci moves separated by spaces, only valid during the callback
+    const char* pv;
+} sirius_search_info;
+
+// called from the engine's main search thread
+typedef void (*sirius_info_callback)(const sirius_search_info* info, void* user_data);
+// the move is in uci notation, and is "0000" if the position has no legal moves
+typedef void (*sirius_bestmove_callback)(const char* move, void* user_data);
+
+sirius_engine* sirius_engine_create(void);
+void sirius_engine_destroy(sirius_engine* engine);
+
+void sirius_engine_set_hash(sirius_engine* engine, int32_t mb);
+void sirius_engine_set_threads(sirius_engine* engine, int32_t count);
+void sirius_engine_new_game(sirius_engine* engine);
+void sirius_engine_set_callbacks(sirius_engine* engine, sirius_info_callback info_callback,
+    sirius_bestmove_callback bestmove_callback, void* user_data);
+
+// moves are in uci notation separated by spaces, and may be NULL.
+// Returns 0 and leaves the position unchanged if the fen or a move is invalid
+int sirius_engine_set_position(
+    sirius_engine* engine, const char* fen, const char* moves, int frc);
+
+void sirius_engine_go(sirius_engine* engine, const sirius_limits* limits);
+void sirius_engine_stop(sirius_engine* engine);
+void sirius_engine_wait(sirius_engine* engine);
+int sirius_engine_searching(const sirius_engine* engine);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
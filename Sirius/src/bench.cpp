@@ -1,4 +1,6 @@
 #include "bench.h"
+#include "eval/eval.h"
+#include "movegen.h"
 
 // clang-format off
 // fens from stormphrax, which got them from alexandria, ultimately came from bitgenie
@@ -80,3 +82,45 @@ void runBench(search::Search& search, i32 depth)
         / std::chrono::duration_cast<std::chrono::duration<f64>>(t2 - t1).count();
     std::cout << nodes << " nodes " << static_cast<i32>(nps) << " nps" << std::endl;
 }
+
+// evaluates every child of the bench positions, which includes
+// replaying the eval state updates like in search
+void runEvalBench(i32 iterations)
+{
+    std::unique_ptr<search::SearchThread> thread =
+        std::make_unique<search::SearchThread>(0, std::thread());
+    PawnTable pawnTable;
+
+    u64 evals = 0;
+    // summed so the evaluations can't be optimized out
+    i64 evalSum = 0;
+    auto t1 = std::chrono::steady_clock::now();
+
+    for (auto fen : fens)
+    {
+        Board& board = thread->board;
+        board.setToFen(fen);
+        thread->evalState.init(board, pawnTable);
+
+        MoveList moves;
+        genMoves<MoveGenType::LEGAL>(board, moves);
+
+        for (i32 i = 0; i < iterations; i++)
+        {
+            for (Move move : moves)
+            {
+                board.makeMove(move, thread->evalState);
+                evalSum += eval::evaluate(board, thread.get());
+                board.unmakeMove(thread->evalState);
+                evals++;
+            }
+        }
+    }
+
+    auto t2 = std::chrono::steady_clock::now();
+
+    f64 evalsPerSec = static_cast<f64>(evals)
+        / std::chrono::duration_cast<std::chrono::duration<f64>>(t2 - t1).count();
+    std::cout << evals << " evals " << static_cast<i64>(evalsPerSec) << " evals/s"
+              << " (sum " << evalSum << ")" << std::endl;
+}
@@ -3,3 +3,4 @@
 #include "search.h"
 
 void runBench(search::Search& search, i32 depth);
+void runEvalBench(i32 iterations);
@@ -0,0 +1,148 @@
+#include "archive.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace viriformat
+{
+
+namespace
+{
+
+constexpr u64 INDEX_MAGIC = 0x5849565353524953; // "SIRSSVIX"
+constexpr u64 INDEX_VERSION = 1;
+
+struct IndexHeader
+{
+    u64 magic;
+    u64 version;
+    u64 archiveSize;
+    u64 modifiedTime;
+    u64 gameCount;
+};
+
+}
+
+Game GameView::toGame() const
+{
+    Game game;
+    game.startpos = startpos();
+    game.moves.reserve(m_MoveCount);
+    for (usize i = 0; i < m_MoveCount; i++)
+        game.moves.push_back(move(i));
+    return game;
+}
+
+bool Archive::open(const std::string& filename)
+{
+    close();
+
+    if (!m_File.open(filename))
+        return false;
+    m_File.adviseSequential();
+
+    std::error_code ec;
+    m_ModifiedTime = static_cast<u64>(
+        std::filesystem::last_write_time(filename, ec).time_since_epoch().count());
+
+    std::string indexFilename = filename + ".idx";
+    if (!loadIndex(indexFilename))
+    {
+        buildIndex();
+        if (gameCount() > 0)
+            saveIndex(indexFilename);
+    }
+
+    // an interrupted write leaves a partial game at the end, which is left out of the index,
+    // but a file without a single complete game isn't an archive
+    if (gameCount() == 0)
+    {
+        close();
+        return false;
+    }
+    if (m_Offsets.back() < m_File.size())
+        std::cout << "Ignoring " << m_File.size() - m_Offsets.back()
+                  << " bytes of a truncated game at the end of " << filename << std::endl;
+    return true;
+}
+
+void Archive::close()
+{
+    m_File.close();
+    m_Offsets.clear();
+}
+
+usize Archive::gameCount() const
+{
+    return m_Offsets.empty() ? 0 : m_Offsets.size() - 1;
+}
+
+usize Archive::sizeBytes() const
+{
+    return m_File.size();
+}
+
+GameView Archive::game(usize idx) const
+{
+    u64 begin = m_Offsets[idx];
+    u64 end = m_Offsets[idx + 1];
+    // the start position and the null terminator take the same space as 9 moves
+    usize moveCount = (end - begin - sizeof(marlinformat::PackedBoard)) / 4 - 1;
+    return GameView(m_File.data() + begin, moveCount);
+}
+
+bool Archive::loadIndex(const std::string& indexFilename)
+{
+    std::ifstream file(indexFilename, std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    IndexHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || header.magic != INDEX_MAGIC || header.version != INDEX_VERSION
+        || header.archiveSize != m_File.size() || header.modifiedTime != m_ModifiedTime)
+        return false;
+
+    m_Offsets.resize(header.gameCount + 1);
+    file.read(reinterpret_cast<char*>(m_Offsets.data()),
+        static_cast<std::streamsize>(m_Offsets.size() * sizeof(u64)));
+    if (!file || m_Offsets.back() > m_File.size())
+    {
+        m_Offsets.clear();
+        return false;
+    }
+    return true;
+}
+
+void Archive::buildIndex()
+{
+    // each game ends at its null move, and the bytes after the last one are left out
+    m_Offsets.assign(1, 0);
+    u64 pos = sizeof(marlinformat::PackedBoard);
+    while (pos + 4 <= m_File.size())
+    {
+        u32 moveData;
+        std::memcpy(&moveData, m_File.data() + pos, sizeof(moveData));
+        pos += 4;
+        if (moveData != 0)
+            continue;
+        m_Offsets.push_back(pos);
+        pos += sizeof(marlinformat::PackedBoard);
+    }
+}
+
+void Archive::saveIndex(const std::string& indexFilename) const
+{
+    std::ofstream file(indexFilename, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+        return;
+
+    IndexHeader header = {
+        INDEX_MAGIC, INDEX_VERSION, m_File.size(), m_ModifiedTime, gameCount()};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(m_Offsets.data()),
+        static_cast<std::streamsize>(m_Offsets.size() * sizeof(u64)));
+}
+
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "../util/mapped_file.h"
+#include "viriformat.h"
+
+#include <cstring>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace viriformat
+{
+
+// a game in a mapped archive, which reads straight from the mapping
+class GameView
+{
+public:
+    GameView(const u8* data, usize moveCount);
+
+    marlinformat::PackedBoard startpos() const;
+    usize moveCount() const;
+    std::pair<ViriMove, i16> move(usize idx) const;
+    // the moves as they are stored, the move in the low 16 bits and the score in the high 16
+    std::span<const u32> rawMoves() const;
+
+    Game toGame() const;
+
+private:
+    const u8* m_Data;
+    usize m_MoveCount;
+};
+
+// a memory mapped viriformat file with the offset of every game, which are loaded from
+// <file>.idx if it is up to date, and otherwise found by scanning the file and saved there
+class Archive
+{
+public:
+    // false if the file can't be mapped or has no complete games. A truncated
+    // game at the end of the file is left out with a warning
+    bool open(const std::string& filename);
+    void close();
+
+    usize gameCount() const;
+    usize sizeBytes() const;
+    GameView game(usize idx) const;
+
+    // calls func(threadIdx, gameIdx, game) for every game in [begin, end),
+    // split into one contiguous range for each thread
+    template<typename Func>
+    void parallelForEach(u32 numThreads, usize begin, usize end, const Func& func) const;
+
+private:
+    bool loadIndex(const std::string& indexFilename);
+    void buildIndex();
+    void saveIndex(const std::string& indexFilename) const;
+
+    MappedFile m_File;
+    u64 m_ModifiedTime = 0;
+    // one past the last game is also stored, so that games can be sized without scanning
+    std::vector<u64> m_Offsets;
+};
+
+inline GameView::GameView(const u8* data, usize moveCount)
+    : m_Data(data), m_MoveCount(moveCount)
+{
+}
+
+inline marlinformat::PackedBoard GameView::startpos() const
+{
+    marlinformat::PackedBoard result;
+    std::memcpy(&result, m_Data, sizeof(result));
+    return result;
+}
+
+inline usize GameView::moveCount() const
+{
+    return m_MoveCount;
+}
+
+inline std::pair<ViriMove, i16> GameView::move(usize idx) const
+{
+    u32 moveData = rawMoves()[idx];
+    return {ViriMove(moveData & 0xFFFF), static_cast<i16>(moveData >> 16)};
+}
+
+inline std::span<const u32> GameView::rawMoves() const
+{
+    // every game is a multiple of 4 bytes long, so the moves are aligned to 4 bytes
+    return {reinterpret_cast<const u32*>(m_Data + sizeof(marlinformat::PackedBoard)),
+        m_MoveCount};
+}
+
+template<typename Func>
+void Archive::parallelForEach(u32 numThreads, usize begin, usize end, const Func& func) const
+{
+    std::vector<std::jthread> threads;
+    threads.reserve(numThreads);
+    usize count = end - begin;
+    for (u32 i = 0; i < numThreads; i++)
+    {
+        threads.emplace_back(
+            [=, this, &func]()
+            {
+                for (usize idx = begin + count * i / numThreads;
+                     idx < begin + count * (i + 1) / numThreads; idx++)
+                    func(i, idx, game(idx));
+            });
+    }
+}
+
+}
@@ -0,0 +1,36 @@
+#include "bulletformat.h"
+
+namespace bulletformat
+{
+
+ChessBoard packBoard(const Board& board, i32 score, marlinformat::WDL wdl)
+{
+    ChessBoard result = {};
+    Color stm = board.sideToMove();
+    i32 flip = stm == Color::WHITE ? 0 : 56;
+
+    Bitboard occ = board.allPieces();
+    Bitboard relativeOcc = Bitboard(0);
+    while (occ.any())
+        relativeOcc |= Bitboard::fromSquare(Square(occ.poplsb().value() ^ flip));
+
+    result.occ = relativeOcc.value();
+    usize index = 0;
+    while (relativeOcc.any())
+    {
+        Square sq = Square(relativeOcc.poplsb().value() ^ flip);
+        Piece piece = board.pieceAt(sq);
+        u8 code = static_cast<u8>(getPieceType(piece)) | ((getPieceColor(piece) != stm) << 3);
+        result.pieces[index / 2] |= code << (4 * (index % 2));
+        index++;
+    }
+
+    u8 whiteResult = static_cast<u8>(wdl);
+    result.score = static_cast<i16>(stm == Color::WHITE ? score : -score);
+    result.result = stm == Color::WHITE ? whiteResult : 2 - whiteResult;
+    result.kingSq = static_cast<u8>(board.kingSq(stm).value() ^ flip);
+    result.oppKingSq = static_cast<u8>(board.kingSq(~stm).value() ^ flip ^ 56);
+    return result;
+}
+
+}
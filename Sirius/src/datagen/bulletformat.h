@@ -0,0 +1,29 @@
+#pragma once
+
+#include "marlinformat.h"
+
+namespace bulletformat
+{
+
+// bullet's ChessBoard, which is always from the perspective of the side to move,
+// so the board is flipped vertically and the colors are swapped when black is to move
+struct ChessBoard
+{
+    u64 occ;
+    // 4 bits per piece in the order of occ, the piece type with bit 3 set for the opponent
+    std::array<u8, 16> pieces;
+    i16 score;
+    // 0 for a loss, 1 for a draw and 2 for a win
+    u8 result;
+    u8 kingSq;
+    // flipped vertically
+    u8 oppKingSq;
+    std::array<u8, 3> extra;
+};
+
+static_assert(sizeof(ChessBoard) == 32);
+
+// score and wdl are from white's perspective, as in marlinformat
+ChessBoard packBoard(const Board& board, i32 score, marlinformat::WDL wdl);
+
+}
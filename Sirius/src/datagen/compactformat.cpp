@@ -0,0 +1,459 @@
+#include "compactformat.h"
+#include "../movegen.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace compactformat
+{
+
+namespace
+{
+
+constexpr u32 MAGIC = 0x46474353; // "SCGF"
+constexpr u32 VERSION = 1;
+constexpr usize BLOCK_SIZE = 1 << 20;
+// a block is written once it reaches BLOCK_SIZE, so no stream is much larger than it
+constexpr u32 MAX_STREAM_SIZE = 4 * BLOCK_SIZE;
+
+// rANS with 32 bit state and byte wise renormalization, as in ryg_rans
+constexpr u32 PROB_BITS = 12;
+constexpr u32 PROB_SCALE = 1 << PROB_BITS;
+constexpr u32 RANS_L = 1u << 23;
+
+struct SymbolTable
+{
+    std::array<u16, 256> freqs;
+    std::array<u16, 256> cums;
+};
+
+void writeU32(std::vector<u8>& out, u32 value)
+{
+    for (i32 i = 0; i < 4; i++)
+        out.push_back(static_cast<u8>(value >> (8 * i)));
+}
+
+u32 readU32(const u8* data)
+{
+    return data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<u32>(data[3]) << 24);
+}
+
+void writeVarint(std::vector<u8>& out, u32 value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(static_cast<u8>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<u8>(value));
+}
+
+// false if the varint runs past the end of the data or is longer than a u32
+bool readVarint(const std::vector<u8>& data, usize& pos, u32& value)
+{
+    value = 0;
+    for (u32 shift = 0; shift < 32 && pos < data.size(); shift += 7)
+    {
+        u8 byte = data[pos++];
+        value |= static_cast<u32>(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+u32 zigzag(i32 value)
+{
+    return (static_cast<u32>(value) << 1) ^ static_cast<u32>(value >> 31);
+}
+
+i32 unzigzag(u32 value)
+{
+    return static_cast<i32>(value >> 1) ^ -static_cast<i32>(value & 1);
+}
+
+// scales the symbol counts to sum to PROB_SCALE, keeping every symbol that occurs
+SymbolTable buildTable(const std::vector<u8>& data)
+{
+    std::array<u64, 256> counts = {};
+    for (u8 byte : data)
+        counts[byte]++;
+
+    SymbolTable table = {};
+    u32 total = 0;
+    for (usize i = 0; i < 256; i++)
+    {
+        if (counts[i] == 0)
+            continue;
+        table.freqs[i] = static_cast<u16>(std::max<u64>(counts[i] * PROB_SCALE / data.size(), 1));
+        total += table.freqs[i];
+    }
+
+    // rounding down leaves some probability over, which goes to the most common symbol,
+    // but rounding rare symbols up to 1 can take too much, which is taken from the most common
+    auto largest = [&]()
+    { return std::max_element(table.freqs.begin(), table.freqs.end()) - table.freqs.begin(); };
+    if (total < PROB_SCALE)
+        table.freqs[largest()] = static_cast<u16>(table.freqs[largest()] + PROB_SCALE - total);
+    for (; total > PROB_SCALE; total--)
+        table.freqs[largest()]--;
+
+    u32 cum = 0;
+    for (usize i = 0; i < 256; i++)
+    {
+        table.cums[i] = static_cast<u16>(cum);
+        cum += table.freqs[i];
+    }
+    return table;
+}
+
+// raw size, compressed size, the frequencies if not empty, then the rANS bytes
+void encodeStream(const std::vector<u8>& data, std::vector<u8>& out)
+{
+    writeU32(out, static_cast<u32>(data.size()));
+    if (data.empty())
+    {
+        writeU32(out, 0);
+        return;
+    }
+
+    SymbolTable table = buildTable(data);
+
+    // symbols are encoded in reverse so that they are decoded forwards
+    std::vector<u8> buffer(data.size() * 2 + 16);
+    u8* ptr = buffer.data() + buffer.size();
+    u32 x = RANS_L;
+    for (usize i = data.size(); i-- > 0;)
+    {
+        u32 freq = table.freqs[data[i]];
+        u32 xMax = ((RANS_L >> PROB_BITS) << 8) * freq;
+        while (x >= xMax)
+        {
+            *--ptr = static_cast<u8>(x);
+            x >>= 8;
+        }
+        x = ((x / freq) << PROB_BITS) + (x % freq) + table.cums[data[i]];
+    }
+    for (i32 i = 3; i >= 0; i--)
+        *--ptr = static_cast<u8>(x >> (8 * i));
+
+    usize compressedSize = buffer.data() + buffer.size() - ptr;
+    writeU32(out, static_cast<u32>(compressedSize));
+    for (u16 freq : table.freqs)
+    {
+        out.push_back(static_cast<u8>(freq));
+        out.push_back(static_cast<u8>(freq >> 8));
+    }
+    out.insert(out.end(), ptr, ptr + compressedSize);
+}
+
+bool decodeStream(std::istream& is, std::vector<u8>& data)
+{
+    u8 sizes[8];
+    if (!is.read(reinterpret_cast<char*>(sizes), sizeof(sizes)))
+        return false;
+    u32 rawSize = readU32(sizes);
+    u32 compressedSize = readU32(sizes + 4);
+    // checked before allocating, so that a corrupt size can't ask for gigabytes.
+    // The encoder's buffer holds at most 2 bytes per symbol and the final state
+    if (rawSize > MAX_STREAM_SIZE || compressedSize > 2 * rawSize + 16)
+        return false;
+    data.resize(rawSize);
+    if (rawSize == 0)
+        return true;
+
+    std::array<u8, 512> freqBytes;
+    std::vector<u8> compressed(compressedSize);
+    if (!is.read(reinterpret_cast<char*>(freqBytes.data()), freqBytes.size())
+        || !is.read(reinterpret_cast<char*>(compressed.data()), compressedSize))
+        return false;
+
+    SymbolTable table = {};
+    std::array<u8, PROB_SCALE> slotSymbols;
+    u32 cum = 0;
+    for (usize i = 0; i < 256; i++)
+    {
+        table.freqs[i] = static_cast<u16>(freqBytes[2 * i] | (freqBytes[2 * i + 1] << 8));
+        table.cums[i] = static_cast<u16>(cum);
+        if (cum + table.freqs[i] > PROB_SCALE)
+            return false;
+        std::fill_n(slotSymbols.begin() + cum, table.freqs[i], static_cast<u8>(i));
+        cum += table.freqs[i];
+    }
+    if (cum != PROB_SCALE)
+        return false;
+
+    if (compressedSize < 4)
+        return false;
+    const u8* ptr = compressed.data();
+    const u8* end = ptr + compressedSize;
+    u32 x = readU32(ptr);
+    ptr += 4;
+    for (u32 i = 0; i < rawSize; i++)
+    {
+        u32 slot = x & (PROB_SCALE - 1);
+        u8 symbol = slotSymbols[slot];
+        data[i] = symbol;
+        x = table.freqs[symbol] * (x >> PROB_BITS) + slot - table.cums[symbol];
+        while (x < RANS_L && ptr < end)
+            x = (x << 8) | *ptr++;
+    }
+    return true;
+}
+
+}
+
+Writer::Writer(std::ostream& os)
+    : m_Stream(os), m_GameCount(0), m_Finished(false)
+{
+    std::vector<u8> header;
+    writeU32(header, MAGIC);
+    writeU32(header, VERSION);
+    m_Stream.write(reinterpret_cast<const char*>(header.data()), header.size());
+}
+
+Writer::~Writer()
+{
+    finish();
+}
+
+bool Writer::write(const viriformat::Game& game)
+{
+    // the indices are found before anything is written, so that a game with
+    // a move that isn't legal leaves the block unchanged
+    std::vector<u8> moveIndices;
+    moveIndices.reserve(game.moves.size());
+    Board board = marlinformat::unpackBoard(game.startpos).board;
+    for (auto [viriMove, score] : game.moves)
+    {
+        MoveList moves;
+        genMoves<MoveGenType::LEGAL>(board, moves);
+        u32 idx = 0;
+        while (idx < moves.size() && viriformat::ViriMove(moves[idx]) != viriMove)
+            idx++;
+        if (idx == moves.size())
+            return false;
+        moveIndices.push_back(static_cast<u8>(idx));
+        board.makeMove(moves[idx]);
+    }
+
+    const u8* startpos = reinterpret_cast<const u8*>(&game.startpos);
+    m_Headers.insert(m_Headers.end(), startpos, startpos + sizeof(game.startpos));
+    writeVarint(m_Headers, static_cast<u32>(game.moves.size()));
+    m_MoveIndices.insert(m_MoveIndices.end(), moveIndices.begin(), moveIndices.end());
+
+    i32 prevScore = 0;
+    for (auto [viriMove, score] : game.moves)
+    {
+        writeVarint(m_ScoreDeltas, zigzag(score - prevScore));
+        prevScore = score;
+    }
+
+    m_GameCount++;
+    if (m_Headers.size() + m_MoveIndices.size() + m_ScoreDeltas.size() >= BLOCK_SIZE)
+        writeBlock();
+    return true;
+}
+
+void Writer::finish()
+{
+    if (m_Finished)
+        return;
+    if (m_GameCount > 0)
+        writeBlock();
+    m_Stream.flush();
+    m_Finished = true;
+}
+
+void Writer::writeBlock()
+{
+    std::vector<u8> block;
+    writeU32(block, m_GameCount);
+    encodeStream(m_Headers, block);
+    encodeStream(m_MoveIndices, block);
+    encodeStream(m_ScoreDeltas, block);
+    m_Stream.write(reinterpret_cast<const char*>(block.data()), block.size());
+
+    m_GameCount = 0;
+    m_Headers.clear();
+    m_MoveIndices.clear();
+    m_ScoreDeltas.clear();
+}
+
+Reader::Reader(std::istream& is)
+    : m_Stream(is), m_GamesLeft(0), m_HeaderPos(0), m_MoveIndexPos(0), m_ScoreDeltaPos(0)
+{
+    u8 header[8];
+    m_Valid = m_Stream.read(reinterpret_cast<char*>(header), sizeof(header))
+        && readU32(header) == MAGIC && readU32(header + 4) == VERSION;
+}
+
+bool Reader::valid() const
+{
+    return m_Valid;
+}
+
+bool Reader::read(viriformat::Game& game)
+{
+    if (m_GamesLeft == 0 && !readBlock())
+        return false;
+    m_GamesLeft--;
+
+    // the streams of a block are only checked to decode, so every index into
+    // them is checked here, and the stream is invalid from the first bad game
+    auto corrupt = [this]()
+    {
+        m_Valid = false;
+        m_GamesLeft = 0;
+        return false;
+    };
+
+    u32 moveCount;
+    if (m_Headers.size() - m_HeaderPos < sizeof(game.startpos))
+        return corrupt();
+    std::memcpy(&game.startpos, m_Headers.data() + m_HeaderPos, sizeof(game.startpos));
+    m_HeaderPos += sizeof(game.startpos);
+    if (!readVarint(m_Headers, m_HeaderPos, moveCount)
+        || moveCount > m_MoveIndices.size() - m_MoveIndexPos)
+        return corrupt();
+
+    game.moves.clear();
+    game.moves.reserve(moveCount);
+    Board board = marlinformat::unpackBoard(game.startpos).board;
+    i32 score = 0;
+    for (u32 i = 0; i < moveCount; i++)
+    {
+        MoveList moves;
+        genMoves<MoveGenType::LEGAL>(board, moves);
+        u8 idx = m_MoveIndices[m_MoveIndexPos++];
+        u32 delta;
+        if (idx >= moves.size() || !readVarint(m_ScoreDeltas, m_ScoreDeltaPos, delta))
+            return corrupt();
+        Move move = moves[idx];
+        score += unzigzag(delta);
+        game.moves.push_back({viriformat::ViriMove(move), static_cast<i16>(score)});
+        if (i + 1 < moveCount)
+            board.makeMove(move);
+    }
+    return true;
+}
+
+bool Reader::readBlock()
+{
+    if (!m_Valid || m_Stream.peek() == EOF)
+        return false;
+
+    u8 countBytes[4];
+    m_HeaderPos = m_MoveIndexPos = m_ScoreDeltaPos = 0;
+    if (!m_Stream.read(reinterpret_cast<char*>(countBytes), sizeof(countBytes))
+        || !decodeStream(m_Stream, m_Headers) || !decodeStream(m_Stream, m_MoveIndices)
+        || !decodeStream(m_Stream, m_ScoreDeltas))
+    {
+        m_Valid = false;
+        m_GamesLeft = 0;
+        return false;
+    }
+    m_GamesLeft = readU32(countBytes);
+    return m_GamesLeft > 0;
+}
+
+}
+
+namespace datagen
+{
+
+namespace
+{
+
+f64 megabytes(u64 bytes)
+{
+    return static_cast<f64>(bytes) / (1024.0 * 1024.0);
+}
+
+void reportConversion(u64 games, u64 viriBytes, u64 compactBytes, f64 seconds)
+{
+    std::cout << "Converted " << games << " games in " << seconds << "s" << std::endl;
+    std::cout << "viriformat: " << megabytes(viriBytes) << " MB, compact: "
+              << megabytes(compactBytes) << " MB, ratio "
+              << static_cast<f64>(viriBytes) / static_cast<f64>(std::max<u64>(compactBytes, 1))
+              << std::endl;
+    std::cout << megabytes(viriBytes) / seconds << " MB/s of viriformat" << std::endl;
+}
+
+}
+
+void compressGames(const std::string& inputFilename, const std::string& outputFilename)
+{
+    std::ifstream inputFile(inputFilename, std::ios::binary);
+    if (!inputFile.is_open())
+    {
+        std::cout << "Could not open file " << inputFilename << std::endl;
+        return;
+    }
+    std::ofstream outputFile(outputFilename, std::ios::binary);
+
+    auto startTime = std::chrono::steady_clock::now();
+    u64 games = 0;
+    u64 skipped = 0;
+    {
+        compactformat::Writer writer(outputFile);
+        while (inputFile.peek() != EOF)
+        {
+            if (writer.write(viriformat::Game::read(inputFile)))
+                games++;
+            else
+                skipped++;
+        }
+    }
+    auto endTime = std::chrono::steady_clock::now();
+    outputFile.close();
+
+    if (skipped > 0)
+        std::cout << "Skipped " << skipped << " games with an illegal move" << std::endl;
+
+    reportConversion(games, std::filesystem::file_size(inputFilename),
+        std::filesystem::file_size(outputFilename),
+        std::chrono::duration<f64>(endTime - startTime).count());
+}
+
+void decompressGames(const std::string& inputFilename, const std::string& outputFilename)
+{
+    std::ifstream inputFile(inputFilename, std::ios::binary);
+    if (!inputFile.is_open())
+    {
+        std::cout << "Could not open file " << inputFilename << std::endl;
+        return;
+    }
+
+    compactformat::Reader reader(inputFile);
+    if (!reader.valid())
+    {
+        std::cout << inputFilename << " is not a compact game file" << std::endl;
+        return;
+    }
+    std::ofstream outputFile(outputFilename, std::ios::binary);
+
+    auto startTime = std::chrono::steady_clock::now();
+    u64 games = 0;
+    viriformat::Game game;
+    while (reader.read(game))
+    {
+        game.write(outputFile);
+        games++;
+    }
+    outputFile.close();
+    auto endTime = std::chrono::steady_clock::now();
+
+    if (!reader.valid())
+        std::cout << inputFilename << " is corrupt after " << games << " games" << std::endl;
+
+    reportConversion(games, std::filesystem::file_size(outputFilename),
+        std::filesystem::file_size(inputFilename),
+        std::chrono::duration<f64>(endTime - startTime).count());
+}
+
+}
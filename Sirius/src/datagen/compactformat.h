@@ -0,0 +1,73 @@
+#pragma once
+
+#include "viriformat.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+// a compact encoding of viriformat games. Each game is a start position, the
+// index of each move in the legal move list, and the change in score after each
+// move, written as varints. The games are grouped into blocks of about 1 MiB,
+// and each block is split into one stream of each kind, which are compressed
+// separately with a static rANS coder
+namespace compactformat
+{
+
+class Writer
+{
+public:
+    explicit Writer(std::ostream& os);
+    ~Writer();
+
+    // false if the game has a move that isn't legal, in which case it isn't written
+    bool write(const viriformat::Game& game);
+    // writes the last partial block, called by the destructor if not called before
+    void finish();
+
+private:
+    void writeBlock();
+
+    std::ostream& m_Stream;
+    u32 m_GameCount;
+    std::vector<u8> m_Headers;
+    std::vector<u8> m_MoveIndices;
+    std::vector<u8> m_ScoreDeltas;
+    bool m_Finished;
+};
+
+class Reader
+{
+public:
+    explicit Reader(std::istream& is);
+
+    // false if the stream is not in this format, or once a corrupt block or game is read
+    bool valid() const;
+    // false at the end of the stream
+    bool read(viriformat::Game& game);
+
+private:
+    bool readBlock();
+
+    std::istream& m_Stream;
+    bool m_Valid;
+    u32 m_GamesLeft;
+    std::vector<u8> m_Headers;
+    std::vector<u8> m_MoveIndices;
+    std::vector<u8> m_ScoreDeltas;
+    usize m_HeaderPos;
+    usize m_MoveIndexPos;
+    usize m_ScoreDeltaPos;
+};
+
+}
+
+namespace datagen
+{
+
+// convert between viriformat and the compact format, reporting
+// the compression ratio and the throughput of the conversion
+void compressGames(const std::string& inputFilename, const std::string& outputFilename);
+void decompressGames(const std::string& inputFilename, const std::string& outputFilename);
+
+}
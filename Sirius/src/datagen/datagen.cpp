@@ -3,27 +3,35 @@
 #include "../board.h"
 #include "../movegen.h"
 #include "../search.h"
+#include "../util/mpsc_queue.h"
 #include "../util/scharnagl.h"
+#include "../uci/fen.h"
+#include "opening_book.h"
 #include "viriformat.h"
+#include <algorithm>
 #include <atomic>
 #include <csignal>
+#include <cstdio>
 #include <filesystem>
 #include <fstream>
+#include <memory>
+#include <optional>
 #include <random>
+#include <sstream>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 
 namespace datagen
 {
 
 constexpr u32 BATCH_SIZE = 128;
+constexpr i32 MAX_OPENING_SCORE = 300;
 std::atomic_bool stop = false;
 
-enum class GameResult
-{
-    MATED,
-    DRAW,
-    NON_TERMINAL
-};
-
 GameResult gameResult(const Board& board)
 {
     MoveList moves;
@@ -83,17 +91,76 @@ Board genOpening(std::mt19937& gen, bool DFRC)
     }
 }
 
-viriformat::Game runGame(std::mt19937& gen, const Config& config)
+// a short search of the opening, so that unbalanced openings are rejected
+// without first doing a search with the node limits of the game
+bool openingBalanced(search::Search& search, const Board& board, u32 nodes)
+{
+    if (nodes == 0)
+        return true;
+
+    SearchLimits limits = {};
+    limits.softNodes = nodes;
+    limits.maxNodes = nodes;
+    limits.maxDepth = MAX_PLY;
+    i32 score = search.datagenSearch(limits, board).first;
+    if (std::abs(score) <= MAX_OPENING_SCORE)
+        return true;
+
+    search.newGame();
+    return false;
+}
+
+struct Opening
+{
+    Board board;
+    // the line of the book it came from, or nothing for random openings
+    std::optional<usize> bookIdx;
+};
+
+// an opening from the book if there is one, and otherwise from random moves,
+// that passes the prefilter. The verdict on each book opening is kept in the
+// book, so openings are only searched the first time any thread uses them
+Opening pickOpening(
+    std::mt19937& gen, const Config& config, OpeningBook* book, search::Search& search)
+{
+    while (book && book->size() > 0)
+    {
+        usize idx = book->next();
+        if (idx == book->size())
+            break;
+        if (book->verdict(idx) == OpeningBook::Verdict::ACCEPTED)
+        {
+            Board board;
+            board.setToFen(book->fen(idx), config.DFRC);
+            return {board, idx};
+        }
+
+        std::string fen = book->fen(idx);
+        bool valid = uci::isValidFen(fen.c_str());
+        Board board;
+        if (valid)
+            board.setToFen(fen, config.DFRC);
+        bool accepted = valid && gameResult(board) == GameResult::NON_TERMINAL
+            && openingBalanced(search, board, config.openingNodes);
+        book->setVerdict(
+            idx, accepted ? OpeningBook::Verdict::ACCEPTED : OpeningBook::Verdict::REJECTED);
+        if (accepted)
+            return {board, idx};
+    }
+
+    for (;;)
+    {
+        Board board = genOpening(gen, config.DFRC);
+        if (openingBalanced(search, board, config.openingNodes))
+            return {board, std::nullopt};
+    }
+}
+
+viriformat::Game runGame(std::mt19937& gen, const Config& config, OpeningBook* book)
 {
-    constexpr i32 WIN_ADJ_THRESHOLD = 2000;
-    constexpr i32 WIN_ADJ_PLIES = 5;
-    constexpr i32 DRAW_ADJ_MOVE_NUM = 50;
-    constexpr i32 DRAW_ADJ_THRESHOLD = 7;
-    constexpr i32 DRAW_ADJ_PLIES = 8;
-    constexpr i32 MAX_OPENING_SCORE = 300;
-
-    Board startpos = genOpening(gen, config.DFRC);
     ColorArray<search::Search> searches = {search::Search(8), search::Search(8)};
+    Opening opening = pickOpening(gen, config, book, searches[Color::WHITE]);
+    Board startpos = opening.board;
     SearchLimits limits = {};
     limits.softNodes = config.softLimit;
     limits.maxNodes = config.hardLimit;
@@ -116,8 +183,12 @@ viriformat::Game runGame(std::mt19937& gen, const Config& config)
 
         if (game.moves.size() == 0 && score > MAX_OPENING_SCORE)
         {
+            // so that no thread plays the opening again
+            if (opening.bookIdx)
+                book->setVerdict(*opening.bookIdx, OpeningBook::Verdict::REJECTED);
             searches[board.sideToMove()].newGame();
-            board = startpos = genOpening(gen, config.DFRC);
+            opening = pickOpening(gen, config, book, searches[Color::WHITE]);
+            board = startpos = opening.board;
             continue;
         }
 
@@ -179,12 +250,218 @@ viriformat::Game runGame(std::mt19937& gen, const Config& config)
     return game;
 }
 
-std::string tmpFilename(i32 threadID)
+// a batch of games serialized by a datagen thread, or the end of the games if null
+using GameBatch = std::unique_ptr<std::string>;
+
+// writes the batches from every datagen thread to the output from one thread, so the
+// games are written straight to their final files. The files are synced periodically,
+// after which a manifest records how much of each file is complete, so that a run can
+// be resumed and its output used up to there even if it's interrupted
+class DatagenWriter
 {
-    return "datagen_tmp" + std::to_string(threadID) + ".bin";
+public:
+    DatagenWriter(const Config& config)
+        : m_Config(config)
+    {
+        m_Buffer.reserve(WRITE_SIZE);
+    }
+
+    ~DatagenWriter()
+    {
+        if (m_File)
+            std::fclose(m_File);
+    }
+
+    // restores the state from the manifest and truncates the files to it, returns the
+    // number of games already written, or nothing if the run can't be resumed because
+    // its settings differ from the manifest or its files can't be opened
+    std::optional<u64> resume()
+    {
+        std::ifstream manifest(manifestFilename());
+        if (!manifest.is_open())
+            return 0;
+
+        std::string tok;
+        Shard shard;
+        std::vector<std::pair<std::string, std::string>> manifestSettings;
+        while (manifest >> tok)
+        {
+            if (tok == "games")
+                manifest >> m_Games;
+            else if (tok == "shard" && manifest >> shard.filename >> shard.games >> shard.bytes)
+                m_Shards.push_back(shard);
+            else if (std::string value; manifest >> value)
+                manifestSettings.push_back({tok, value});
+        }
+
+        // games played with different settings can't be mixed into the same output
+        for (const auto& [name, value] : settings())
+        {
+            auto it = std::find_if(manifestSettings.begin(), manifestSettings.end(),
+                [&name](const auto& setting)
+                {
+                    return setting.first == name;
+                });
+            std::string manifestValue = it == manifestSettings.end() ? "" : it->second;
+            if (manifestValue != value)
+            {
+                std::cout << "Cannot resume from " << manifestFilename() << ", it was written with "
+                          << name << " '" << manifestValue << "' instead of '" << value << "'"
+                          << std::endl;
+                return {};
+            }
+        }
+
+        if (m_Shards.empty())
+            return m_Games = 0;
+
+        for (const auto& existing : m_Shards)
+        {
+            std::error_code error;
+            std::filesystem::resize_file(existing.filename, existing.bytes, error);
+            if (error)
+            {
+                std::cout << "Could not open file " << existing.filename << std::endl;
+                return {};
+            }
+        }
+        m_File = std::fopen(m_Shards.back().filename.c_str(), "ab");
+        if (!m_File)
+        {
+            std::cout << "Could not open file " << m_Shards.back().filename << std::endl;
+            return {};
+        }
+        return m_Games;
+    }
+
+    // returns false if a new file couldn't be opened
+    bool write(const std::string& batch)
+    {
+        if ((!m_File || (m_Config.shardGames > 0 && m_Shards.back().games >= m_Config.shardGames))
+            && !openShard())
+            return false;
+
+        m_Buffer += batch;
+        m_Shards.back().bytes += batch.size();
+        m_Shards.back().games += BATCH_SIZE;
+        m_Games += BATCH_SIZE;
+        m_UnsyncedBytes += batch.size();
+
+        // only write whole buffers until the next sync
+        while (m_Buffer.size() >= WRITE_SIZE)
+        {
+            std::fwrite(m_Buffer.data(), 1, WRITE_SIZE, m_File);
+            m_Buffer.erase(0, WRITE_SIZE);
+        }
+
+        if (m_UnsyncedBytes >= SYNC_SIZE)
+            sync();
+        return true;
+    }
+
+    void sync()
+    {
+        if (!m_File)
+            return;
+
+        std::fwrite(m_Buffer.data(), 1, m_Buffer.size(), m_File);
+        m_Buffer.clear();
+        std::fflush(m_File);
+#ifdef _WIN32
+        _commit(_fileno(m_File));
+#else
+        fsync(fileno(m_File));
+#endif
+        m_UnsyncedBytes = 0;
+        writeManifest();
+    }
+
+    u64 games() const
+    {
+        return m_Games;
+    }
+
+private:
+    static constexpr usize WRITE_SIZE = 4 * 1024 * 1024;
+    static constexpr u64 SYNC_SIZE = 64 * 1024 * 1024;
+
+    struct Shard
+    {
+        std::string filename;
+        u64 games = 0;
+        u64 bytes = 0;
+    };
+
+    std::string manifestFilename() const
+    {
+        return m_Config.outputFilename + ".manifest";
+    }
+
+    bool openShard()
+    {
+        if (m_File)
+        {
+            sync();
+            std::fclose(m_File);
+        }
+
+        Shard shard;
+        shard.filename = m_Config.shardGames == 0
+            ? m_Config.outputFilename
+            : m_Config.outputFilename + "." + std::to_string(m_Shards.size());
+        m_File = std::fopen(shard.filename.c_str(), "wb");
+        if (!m_File)
+        {
+            std::cout << "Could not open file " << shard.filename << std::endl;
+            return false;
+        }
+        m_Shards.push_back(shard);
+        return true;
+    }
+
+    // the settings that the games depend on, which must match to resume a run.
+    // Empty values are left out of the manifest
+    std::vector<std::pair<std::string, std::string>> settings() const
+    {
+        return {
+            {"softlimit", std::to_string(m_Config.softLimit)},
+            {"hardlimit", std::to_string(m_Config.hardLimit)},
+            {"dfrc", std::to_string(m_Config.DFRC)},
+            {"book", m_Config.bookFilename},
+            {"openingnodes", std::to_string(m_Config.openingNodes)},
+            {"shardgames", std::to_string(m_Config.shardGames)},
+        };
+    }
+
+    // written to a temporary file and renamed so that it is never partially written
+    void writeManifest() const
+    {
+        std::string filename = manifestFilename();
+        {
+            std::ofstream manifest(filename + ".tmp", std::ios::trunc);
+            manifest << "games " << m_Games << '\n';
+            for (const auto& [name, value] : settings())
+            {
+                if (!value.empty())
+                    manifest << name << ' ' << value << '\n';
+            }
+            for (const auto& shard : m_Shards)
+                manifest << "shard " << shard.filename << ' ' << shard.games << ' ' << shard.bytes
+                         << '\n';
+        }
+        std::filesystem::rename(filename + ".tmp", filename);
+    }
+
+    const Config& m_Config;
+    std::FILE* m_File = nullptr;
+    std::string m_Buffer;
+    std::vector<Shard> m_Shards;
+    u64 m_Games = 0;
+    u64 m_UnsyncedBytes = 0;
 };
 
-void datagenThread(u32 threadID, const Config& config, u32& gamesLeft, std::mutex& mutex)
+void datagenThread(u32 threadID, const Config& config, OpeningBook* book, u32& gamesLeft,
+    std::mutex& mutex, MPSCQueue<GameBatch>& queue)
 {
     std::random_device rd;
     auto seed = rd();
@@ -194,8 +471,6 @@ void datagenThread(u32 threadID, const Config& config, u32& gamesLeft, std::mute
     }
     std::mt19937 gen(seed);
 
-    std::ofstream outFile(tmpFilename(threadID), std::ios::binary);
-
     u32 totalGames = 0;
 
     while (!stop)
@@ -219,13 +494,15 @@ void datagenThread(u32 threadID, const Config& config, u32& gamesLeft, std::mute
 
         totalGames += BATCH_SIZE;
 
+        std::ostringstream batch;
         for (i32 i = 0; i < BATCH_SIZE; i++)
         {
-            auto game = runGame(gen, config);
-            game.write(outFile);
+            auto game = runGame(gen, config, book);
+            game.write(batch);
 
             totalPositions += game.moves.size() + 1;
         }
+        queue.push(std::make_unique<std::string>(std::move(batch).str()));
 
         auto currTime = std::chrono::steady_clock::now();
         f32 seconds =
@@ -253,6 +530,16 @@ extern "C" void signalHandler(int sig)
 void runDatagen(Config config)
 {
     config.numGames -= config.numGames % BATCH_SIZE;
+
+    DatagenWriter writer(config);
+    std::optional<u64> resumed = writer.resume();
+    if (!resumed)
+        return;
+    u64 gamesDone = *resumed;
+    if (gamesDone > 0)
+        std::cout << "Resuming after " << gamesDone << " games from " << config.outputFilename
+                  << ".manifest" << std::endl;
+
     std::cout << "Generating " << config.numGames << " games with " << config.numThreads
               << " threads" << std::endl;
     std::cout << "Using " << config.hardLimit << " nodes hard limit and " << config.softLimit
@@ -260,45 +547,68 @@ void runDatagen(Config config)
     if (config.DFRC)
         std::cout << "Doing DFRC datagen" << std::endl;
 
+    std::unique_ptr<OpeningBook> book;
+    if (!config.bookFilename.empty())
+    {
+        book = std::make_unique<OpeningBook>();
+        if (!book->open(config.bookFilename, std::random_device()()))
+        {
+            std::cout << "Could not open book " << config.bookFilename << std::endl;
+            return;
+        }
+        std::cout << "Using " << book->size() << " openings from " << config.bookFilename
+                  << std::endl;
+    }
+    if (config.openingNodes > 0)
+        std::cout << "Rejecting openings scored above " << MAX_OPENING_SCORE << " after "
+                  << config.openingNodes << " nodes" << std::endl;
+
     std::vector<std::thread> threads;
     std::mutex lock;
     stop = false;
     std::signal(SIGINT, signalHandler);
 
-    u32 gamesLeft = config.numGames;
+    u32 gamesLeft = static_cast<u32>(config.numGames - std::min<u64>(gamesDone, config.numGames));
+
+    MPSCQueue<GameBatch> queue;
+    std::thread writerThread(
+        [&writer, &queue]()
+        {
+            // after a failed write the batches are dropped until the threads stop
+            bool failed = false;
+            for (;;)
+            {
+                for (auto& batch : queue.popAll())
+                {
+                    if (!batch)
+                        return;
+                    if (!failed && !writer.write(*batch))
+                    {
+                        failed = true;
+                        stop = true;
+                    }
+                }
+            }
+        });
 
     for (u32 i = 0; i < config.numThreads; i++)
     {
         threads.push_back(std::thread(
-            [i, &lock, &gamesLeft, &config]()
+            [i, &lock, &gamesLeft, &config, &book, &queue]()
             {
-                datagenThread(i, config, gamesLeft, lock);
+                datagenThread(i, config, book.get(), gamesLeft, lock, queue);
             }));
     }
 
     for (auto& thread : threads)
         thread.join();
 
-    std::this_thread::sleep_for(std::chrono::seconds(1));
-
-    std::ofstream outputFile(config.outputFilename, std::ios::binary);
+    queue.push(nullptr);
+    writerThread.join();
+    writer.sync();
 
-    for (u32 i = 0; i < config.numThreads; i++)
-    {
-        std::ifstream tmpFile(tmpFilename(i), std::ios::binary);
-        if (!tmpFile.is_open())
-        {
-            std::cout << "Could not open file " << tmpFilename(i) << " for writing to final output"
-                      << std::endl;
-            break;
-        }
-        std::cout << "Merging games written from thread " << i << std::endl;
-        outputFile << tmpFile.rdbuf();
-        std::cout << "Finished merging games written from thread " << i << std::endl;
-        tmpFile.close();
-        if (!std::filesystem::remove(tmpFilename(i)))
-            std::cout << "Could not delete temporary file " << tmpFilename(i) << std::endl;
-    }
+    std::cout << "Finished with " << writer.games() << " games written to "
+              << config.outputFilename << std::endl;
 }
 
 }
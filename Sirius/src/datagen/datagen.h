@@ -4,11 +4,30 @@
 #include <mutex>
 #include <string>
 
+#include "../board.h"
 #include "../defs.h"
 
 namespace datagen
 {
 
+// a game is adjudicated as won once the score has been at least WIN_ADJ_THRESHOLD for
+// WIN_ADJ_PLIES plies in a row, and as drawn after move DRAW_ADJ_MOVE_NUM once the
+// score has been within DRAW_ADJ_THRESHOLD of 0 for DRAW_ADJ_PLIES plies in a row
+constexpr i32 WIN_ADJ_THRESHOLD = 2000;
+constexpr i32 WIN_ADJ_PLIES = 5;
+constexpr i32 DRAW_ADJ_MOVE_NUM = 50;
+constexpr i32 DRAW_ADJ_THRESHOLD = 7;
+constexpr i32 DRAW_ADJ_PLIES = 8;
+
+enum class GameResult
+{
+    MATED,
+    DRAW,
+    NON_TERMINAL
+};
+
+GameResult gameResult(const Board& board);
+
 struct Config
 {
     u32 softLimit;
@@ -17,8 +36,16 @@ struct Config
     u32 numThreads;
     bool DFRC;
     std::string outputFilename;
+    // games per output file, or 0 to write everything to outputFilename
+    u32 shardGames;
+    // EPD or FEN file to take the openings from instead of playing random moves
+    std::string bookFilename;
+    // node limit of the search that rejects unbalanced openings before a game, or 0 for none
+    u32 openingNodes;
 };
 
+// plays games and writes them to the output as they finish, resuming
+// from the manifest next to the output if a previous run was interrupted
 void runDatagen(Config config);
 
 }
@@ -0,0 +1,232 @@
+#include "dedup.h"
+#include "../util/bloom_filter.h"
+#include "../util/parallel_for.h"
+#include "../util/phase.h"
+#include "viriformat.h"
+#include "writer.h"
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace datagen
+{
+
+namespace
+{
+
+constexpr usize CHUNK_RECORDS = 1 << 16;
+constexpr usize CHUNK_GAMES = 4096;
+// a viriformat game takes at least 4 bytes per position
+constexpr u64 VIRI_BYTES_PER_POSITION = 4;
+
+struct PhaseCounts
+{
+    std::array<u64, PHASE_COUNT> total = {};
+    std::array<u64, PHASE_COUNT> duplicates = {};
+
+    void add(const PhaseCounts& other)
+    {
+        for (i32 i = 0; i < PHASE_COUNT; i++)
+        {
+            total[i] += other.total[i];
+            duplicates[i] += other.duplicates[i];
+        }
+    }
+};
+
+struct ChunkPosition
+{
+    marlinformat::PackedBoard record;
+    u64 key;
+    i32 phase;
+    // the thread that owns the filter block of the key
+    u32 owner;
+    bool duplicate;
+};
+
+ChunkPosition makePosition(const BlockedBloomFilter& filter, const Board& board,
+    const marlinformat::PackedBoard& record, u32 numThreads)
+{
+    u64 key = board.zkey().value;
+    return {record, key, boardPhase(board),
+        static_cast<u32>(filter.blockIndex(key) % numThreads), false};
+}
+
+// checks the positions of a chunk against the filter and writes the ones that are new. Each
+// thread only inserts the keys in its own blocks of the filter, in the order of the input, so
+// the first occurrence of a position is always the one that is kept
+void dedupChunk(std::vector<ChunkPosition>& positions, BlockedBloomFilter& filter,
+    std::vector<PhaseCounts>& threadCounts, DataWriter& writer)
+{
+    {
+        std::vector<std::jthread> threads;
+        threads.reserve(threadCounts.size());
+        for (u32 i = 0; i < threadCounts.size(); i++)
+        {
+            threads.emplace_back(
+                [&, i]()
+                {
+                    auto& counts = threadCounts[i];
+                    for (auto& position : positions)
+                    {
+                        if (position.owner != i)
+                            continue;
+                        counts.total[position.phase]++;
+                        position.duplicate = filter.insert(position.key);
+                        if (position.duplicate)
+                            counts.duplicates[position.phase]++;
+                    }
+                });
+        }
+    }
+
+    for (const auto& position : positions)
+        if (!position.duplicate)
+            writer.write(&position.record, sizeof(position.record));
+}
+
+void dedupMarlinformat(std::ifstream& inputFile, DataWriter& writer, BlockedBloomFilter& filter,
+    std::vector<PhaseCounts>& threadCounts)
+{
+    u32 numThreads = static_cast<u32>(threadCounts.size());
+    std::vector<marlinformat::PackedBoard> records(CHUNK_RECORDS);
+    std::vector<ChunkPosition> positions;
+    while (inputFile)
+    {
+        inputFile.read(reinterpret_cast<char*>(records.data()),
+            static_cast<std::streamsize>(records.size() * sizeof(marlinformat::PackedBoard)));
+        usize count = static_cast<usize>(inputFile.gcount()) / sizeof(marlinformat::PackedBoard);
+
+        positions.resize(count);
+        parallelFor(numThreads, count,
+            [&](u32, usize begin, usize end)
+            {
+                for (usize i = begin; i < end; i++)
+                {
+                    Board board = marlinformat::unpackBoard(records[i]).board;
+                    positions[i] = makePosition(filter, board, records[i], numThreads);
+                }
+            });
+
+        dedupChunk(positions, filter, threadCounts, writer);
+    }
+}
+
+void dedupViriformat(std::ifstream& inputFile, DataWriter& writer, BlockedBloomFilter& filter,
+    std::vector<PhaseCounts>& threadCounts)
+{
+    u32 numThreads = static_cast<u32>(threadCounts.size());
+    std::vector<viriformat::Game> games;
+    // index of the first position of each game in the chunk
+    std::vector<usize> offsets;
+    std::vector<ChunkPosition> positions;
+    while (inputFile.peek() != EOF)
+    {
+        games.clear();
+        offsets.clear();
+        usize count = 0;
+        while (games.size() < CHUNK_GAMES && inputFile.peek() != EOF)
+        {
+            games.push_back(viriformat::Game::read(inputFile));
+            offsets.push_back(count);
+            count += games.back().moves.size();
+        }
+
+        positions.resize(count);
+        parallelFor(numThreads, games.size(),
+            [&](u32, usize begin, usize end)
+            {
+                for (usize i = begin; i < end; i++)
+                {
+                    auto [board, score, wdl] = marlinformat::unpackBoard(games[i].startpos);
+                    usize idx = offsets[i];
+                    for (auto [viriMove, moveScore] : games[i].moves)
+                    {
+                        positions[idx++] = makePosition(filter, board,
+                            marlinformat::packBoard(board, moveScore, wdl), numThreads);
+                        board.makeMove(viriMove.toMove());
+                    }
+                }
+            });
+
+        dedupChunk(positions, filter, threadCounts, writer);
+    }
+}
+
+}
+
+void dedup(const DedupConfig& config)
+{
+    std::ifstream inputFile(config.inputFilename, std::ios::binary);
+    if (!inputFile.is_open())
+    {
+        std::cout << "Could not open file " << config.inputFilename << std::endl;
+        return;
+    }
+
+    DataWriter writer(config.outputFilename, 0);
+    if (!writer.isOpen())
+    {
+        std::cout << "Could not open file " << config.outputFilename << std::endl;
+        return;
+    }
+
+    u64 expectedPositions = config.expectedPositions;
+    if (expectedPositions == 0)
+    {
+        u64 inputSize = std::filesystem::file_size(config.inputFilename);
+        expectedPositions = config.format == DedupFormat::MARLINFORMAT
+            ? inputSize / sizeof(marlinformat::PackedBoard)
+            : inputSize / VIRI_BYTES_PER_POSITION;
+    }
+
+    BlockedBloomFilter filter(expectedPositions, config.falsePositiveRate);
+    std::cout << "Using a " << static_cast<f64>(filter.sizeBytes()) / (1024.0 * 1024.0)
+              << " MB bloom filter with " << filter.hashCount() << " hashes for "
+              << expectedPositions << " positions" << std::endl;
+
+    std::vector<PhaseCounts> threadCounts(config.numThreads);
+    auto startTime = std::chrono::steady_clock::now();
+    if (config.format == DedupFormat::MARLINFORMAT)
+        dedupMarlinformat(inputFile, writer, filter, threadCounts);
+    else
+        dedupViriformat(inputFile, writer, filter, threadCounts);
+    writer.flush();
+    auto endTime = std::chrono::steady_clock::now();
+
+    PhaseCounts counts;
+    for (const auto& thread : threadCounts)
+        counts.add(thread);
+
+    u64 total = 0;
+    u64 duplicates = 0;
+    std::cout << "phase  positions  duplicates   rate" << std::endl;
+    for (i32 i = 0; i < PHASE_COUNT; i++)
+    {
+        total += counts.total[i];
+        duplicates += counts.duplicates[i];
+        f64 rate = counts.total[i] == 0
+            ? 0.0
+            : 100.0 * static_cast<f64>(counts.duplicates[i]) / static_cast<f64>(counts.total[i]);
+        char row[64];
+        std::snprintf(row, sizeof(row), "%5d %10llu %11llu %5.1f%%", i,
+            static_cast<unsigned long long>(counts.total[i]),
+            static_cast<unsigned long long>(counts.duplicates[i]), rate);
+        std::cout << row << std::endl;
+    }
+
+    f64 seconds = std::chrono::duration<f64>(endTime - startTime).count();
+    f64 rate = total == 0 ? 0.0 : 100.0 * static_cast<f64>(duplicates) / static_cast<f64>(total);
+    std::cout << "Kept " << total - duplicates << " of " << total << " positions, "
+              << rate << "% duplicates, "
+              << static_cast<u64>(static_cast<f64>(total) / seconds) << " positions/s"
+              << std::endl;
+}
+
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+
+#include "../defs.h"
+
+namespace datagen
+{
+
+enum class DedupFormat
+{
+    VIRIFORMAT,
+    MARLINFORMAT
+};
+
+struct DedupConfig
+{
+    std::string inputFilename;
+    std::string outputFilename;
+    DedupFormat format;
+    // the bloom filter is sized for this many positions, estimated from the size of
+    // the input if 0. The memory used is about 1.44 * log2(1 / fpr) bits per position
+    u64 expectedPositions;
+    f64 falsePositiveRate;
+    u32 numThreads;
+};
+
+// writes the positions of a viriformat or marlinformat file whose zobrist key has not
+// been seen before as marlinformat records, in the order of the input, using a bloom filter
+// to remember the keys. False positives drop a small fraction of unique positions, but no
+// duplicates are kept, and the first occurrence of a position is kept whatever the threads
+void dedup(const DedupConfig& config);
+
+}
@@ -1,11 +1,16 @@
 #include "extract.h"
 #include "../move_ordering.h"
-#include "viriformat.h"
+#include "../util/phase.h"
+#include "archive.h"
+#include "bulletformat.h"
+#include "writer.h"
 
 #include <algorithm>
-#include <fstream>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <limits>
 #include <random>
-#include <sstream>
 
 namespace datagen
 {
@@ -26,14 +31,6 @@ f32 phaseScaleFactor(i32 phase)
 
 }
 
-i32 boardPhase(const Board& board)
-{
-    i32 phase = 4 * board.pieces(PieceType::QUEEN).popcount()
-        + 2 * board.pieces(PieceType::ROOK).popcount()
-        + (board.pieces(PieceType::BISHOP) | board.pieces(PieceType::KNIGHT)).popcount();
-    return std::min(phase, 24);
-}
-
 bool filterPos(const Board& board, Move move, i32 score, marlinformat::WDL wdl)
 {
     if (board.checkers().any())
@@ -43,124 +40,224 @@ bool filterPos(const Board& board, Move move, i32 score, marlinformat::WDL wdl)
     return false;
 }
 
-bool dropPosition(f32 keepProb, std::mt19937& gen)
+namespace
+{
+
+constexpr usize CHUNK_GAMES = 8192;
+
+struct Position
+{
+    marlinformat::PackedBoard board;
+    i32 phase;
+};
+
+// a uniform sample of at most capacity of the positions offered to it
+class Reservoir
+{
+public:
+    void setCapacity(u64 capacity)
+    {
+        m_Capacity = capacity;
+    }
+
+    void offer(const marlinformat::PackedBoard& board, std::mt19937_64& gen)
+    {
+        m_Seen++;
+        if (m_Boards.size() < m_Capacity)
+        {
+            m_Boards.push_back(board);
+            return;
+        }
+
+        std::uniform_int_distribution<u64> dist(0, m_Seen - 1);
+        u64 idx = dist(gen);
+        if (idx < m_Capacity)
+            m_Boards[idx] = board;
+    }
+
+    u64 seen() const
+    {
+        return m_Seen;
+    }
+
+    std::vector<marlinformat::PackedBoard>& boards()
+    {
+        return m_Boards;
+    }
+
+private:
+    u64 m_Capacity = 0;
+    u64 m_Seen = 0;
+    std::vector<marlinformat::PackedBoard> m_Boards;
+};
+
+void sampleGame(
+    const viriformat::GameView& game, u32 ppg, std::mt19937& gen, std::vector<Position>& positions)
+{
+    std::vector<Position> currPositions;
+    auto [board, score, wdl] = marlinformat::unpackBoard(game.startpos());
+    for (usize i = 0; i < game.moveCount(); i++)
+    {
+        auto [viriMove, score] = game.move(i);
+        Move move = viriMove.toMove();
+        if (filterPos(board, move, score, wdl))
+        {
+            board.makeMove(move);
+            continue;
+        }
+
+        marlinformat::PackedBoard packedBoard = marlinformat::packBoard(board, score, wdl);
+        currPositions.push_back({packedBoard, boardPhase(board)});
+        board.makeMove(move);
+    }
+
+    std::sample(
+        currPositions.begin(), currPositions.end(), std::back_inserter(positions), ppg, gen);
+}
+
+void writeRecord(
+    DataWriter& writer, ExtractFormat format, const marlinformat::PackedBoard& packedBoard)
 {
-    std::uniform_real_distribution<f32> dist(0.0, 1.0);
-    f32 u = dist(gen);
-    return u >= keepProb;
+    if (format == ExtractFormat::MARLINFORMAT)
+    {
+        writer.write(&packedBoard, sizeof(packedBoard));
+        return;
+    }
+
+    auto [board, score, wdl] = marlinformat::unpackBoard(packedBoard);
+    if (format == ExtractFormat::BULLETFORMAT)
+    {
+        bulletformat::ChessBoard chessBoard = bulletformat::packBoard(board, score, wdl);
+        writer.write(&chessBoard, sizeof(chessBoard));
+        return;
+    }
+
+    std::string line = board.fenStr() + " | " + std::to_string(score) + "cp | ";
+    switch (wdl)
+    {
+        case marlinformat::WDL::BLACK_WIN:
+            line += "0.0";
+            break;
+        case marlinformat::WDL::DRAW:
+            line += "0.5";
+            break;
+        case marlinformat::WDL::WHITE_WIN:
+            line += "1.0";
+            break;
+    }
+    line += '\n';
+    writer.write(line.data(), line.size());
 }
 
-void extract(std::string dataFilename, std::string outputFilename, u32 maxGames, u32 ppg)
+}
+
+void extract(const ExtractConfig& config)
 {
     std::random_device rd;
     auto seed = rd();
-    std::mt19937 gen(seed);
+    std::mt19937_64 gen(seed);
     std::cout << "Using seed " << seed << std::endl;
 
-    std::ifstream inputFile(dataFilename, std::ios::binary);
-    std::ofstream outputFile(outputFilename, std::ios::app);
-    std::vector<viriformat::Game> games;
+    viriformat::Archive archive;
+    if (!archive.open(config.dataFilename))
+    {
+        std::cout << "Could not open file " << config.dataFilename << std::endl;
+        return;
+    }
+    DataWriter writer(config.outputFilename, config.shardSize);
+    if (!writer.isOpen())
+    {
+        std::cout << "Could not open file " << config.outputFilename << std::endl;
+        return;
+    }
 
-    if (!inputFile.is_open())
-        std::cout << "Could not open file " << dataFilename << std::endl;
+    std::cout << "Sampling a maximum of " << config.ppg << " positions per game" << std::endl;
 
-    while (inputFile.peek() != EOF && games.size() < maxGames)
+    // each phase gets a share of the memory proportional to how often we want it to occur,
+    // so that the reservoirs can only run out for phases there are too many of anyway
+    std::array<Reservoir, PHASE_COUNT> reservoirs;
+    f32 desiredSum = 0.0f;
+    for (i32 i = 0; i < PHASE_COUNT; i++)
+        desiredSum += dists::phaseScaleFactor(i);
+    for (i32 i = 0; i < PHASE_COUNT; i++)
     {
-        auto game = viriformat::Game::read(inputFile);
-        games.push_back(game);
+        f64 share = dists::phaseScaleFactor(i) / desiredSum;
+        reservoirs[i].setCapacity(
+            std::max<u64>(static_cast<u64>(static_cast<f64>(config.maxPositions) * share), 1));
     }
 
-    std::cout << "Finished loading " << games.size() << " games from " << dataFilename << std::endl;
-    std::cout << "Sampling a maximum of " << ppg << " positions per game" << std::endl;
+    u32 numThreads = config.numThreads;
+    std::vector<std::vector<Position>> threadPositions(numThreads);
+    std::vector<std::mt19937> threadGens;
+    for (u32 i = 0; i < numThreads; i++)
+        threadGens.emplace_back(static_cast<u32>(gen()));
 
-    struct Position
-    {
-        marlinformat::PackedBoard board;
-        i32 phase;
-    };
-    std::vector<Position> positions;
-    for (auto game : games)
+    auto startTime = std::chrono::steady_clock::now();
+    u64 totalGames = std::min<u64>(archive.gameCount(), config.maxGames);
+    u64 totalSampled = 0;
+
+    // the archive is mapped, so the chunks only bound how many positions are sampled at once
+    for (u64 chunkBegin = 0; chunkBegin < totalGames; chunkBegin += CHUNK_GAMES)
     {
-        std::vector<Position> currPositions;
-        auto [board, score, wdl] = marlinformat::unpackBoard(game.startpos);
-        for (auto [viriMove, score] : game.moves)
+        u64 chunkEnd = std::min<u64>(chunkBegin + CHUNK_GAMES, totalGames);
+        for (auto& positions : threadPositions)
+            positions.clear();
+        archive.parallelForEach(numThreads, chunkBegin, chunkEnd,
+            [&](u32 threadIdx, usize, const viriformat::GameView& game)
+            { sampleGame(game, config.ppg, threadGens[threadIdx], threadPositions[threadIdx]); });
+
+        for (const auto& positions : threadPositions)
         {
-            Move move = viriMove.toMove();
-            if (filterPos(board, move, score, wdl))
-            {
-                board.makeMove(move);
-                continue;
-            }
-
-            marlinformat::PackedBoard packedBoard = marlinformat::packBoard(board, score, wdl);
-            currPositions.push_back({packedBoard, boardPhase(board)});
-            board.makeMove(move);
+            totalSampled += positions.size();
+            for (const auto& pos : positions)
+                reservoirs[pos.phase].offer(pos.board, gen);
         }
 
-        std::sample(currPositions.begin(), currPositions.end(), std::back_inserter(positions), ppg, gen);
+        auto now = std::chrono::steady_clock::now();
+        f64 seconds = std::chrono::duration<f64>(now - startTime).count();
+        std::cout << "Read " << chunkEnd << " games, sampled " << totalSampled << " positions, "
+                  << static_cast<u64>(static_cast<f64>(chunkEnd) / seconds) << " games/s"
+                  << std::endl;
     }
 
-    std::cout << "Sampled " << positions.size() << " positions from " << games.size() << " games"
+    std::cout << "Finished reading " << totalGames << " games from " << config.dataFilename
               << std::endl;
     std::cout << "Adjusting distribution" << std::endl;
 
-    u32 phaseCounts[25] = {};
-    for (const auto& pos : positions)
-        phaseCounts[pos.phase]++;
-
-    f32 phaseKeepProbs[25] = {};
-    f32 phaseNormConst = 100.0f;
-    for (i32 i = 0; i <= 24; i++)
+    // keep all of the kept positions of the phase that is most underrepresented
+    // relative to the distribution we want, and fewer of the others to match it
+    f32 phaseNormConst = std::numeric_limits<f32>::max();
+    for (i32 i = 0; i < PHASE_COUNT; i++)
     {
-        f32 observed = static_cast<f32>(phaseCounts[i]) / static_cast<f32>(positions.size());
-        // this is not actually the desired probability, but it still works
-        f32 desired = dists::phaseScaleFactor(i);
-        phaseKeepProbs[i] = desired / observed;
-        phaseNormConst = std::min(phaseNormConst, observed / desired);
+        if (reservoirs[i].seen() == 0)
+            continue;
+        f32 kept = static_cast<f32>(reservoirs[i].boards().size());
+        phaseNormConst = std::min(phaseNormConst, kept / dists::phaseScaleFactor(i));
     }
 
-    for (i32 i = 0; i <= 24; i++)
-        phaseKeepProbs[i] = std::min(phaseKeepProbs[i] * phaseNormConst, 1.0f);
-
-    for (i32 i = 0; i < positions.size(); i++)
+    std::vector<marlinformat::PackedBoard> boards;
+    for (i32 i = 0; i < PHASE_COUNT; i++)
     {
-        const auto& pos = positions[i];
-        if (dropPosition(phaseKeepProbs[pos.phase], gen))
-        {
-            positions[i] = std::move(positions.back());
-            positions.pop_back();
-            i--;
-        }
+        auto& phaseBoards = reservoirs[i].boards();
+        usize count = std::min(phaseBoards.size(),
+            static_cast<usize>(std::lround(dists::phaseScaleFactor(i) * phaseNormConst)));
+        std::shuffle(phaseBoards.begin(), phaseBoards.end(), gen);
+        boards.insert(boards.end(), phaseBoards.begin(), phaseBoards.begin() + count);
+        std::vector<marlinformat::PackedBoard>().swap(phaseBoards);
     }
 
     std::cout << "Shuffling" << std::endl;
-    std::shuffle(positions.begin(), positions.end(), gen);
+    std::shuffle(boards.begin(), boards.end(), gen);
     std::cout << "Writing to output file" << std::endl;
-    for (const auto& pos : positions)
-    {
-        auto [board, score, wdl] = marlinformat::unpackBoard(pos.board);
-        std::stringstream ss;
-        ss << board.fenStr() << " | ";
-        ss << score << "cp | ";
-        switch (wdl)
-        {
-            case marlinformat::WDL::BLACK_WIN:
-                ss << "0.0";
-                break;
-            case marlinformat::WDL::DRAW:
-                ss << "0.5";
-                break;
-            case marlinformat::WDL::WHITE_WIN:
-                ss << "1.0";
-                break;
-        }
-        ss << '\n';
-        outputFile << ss.str();
-    }
-    outputFile.flush();
+    for (const auto& board : boards)
+        writeRecord(writer, config.format, board);
+    writer.flush();
 
-    std::cout << "Finished extracting " << positions.size() << " fens from " << games.size()
-              << " games" << std::endl;
+    auto endTime = std::chrono::steady_clock::now();
+    f64 seconds = std::chrono::duration<f64>(endTime - startTime).count();
+    std::cout << "Finished extracting " << boards.size() << " positions from " << totalGames
+              << " games into " << writer.shardCount() << " file(s) in " << seconds << "s"
+              << std::endl;
 }
 
 }
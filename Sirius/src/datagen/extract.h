@@ -3,11 +3,38 @@
 #include <cstdint>
 #include <string>
 
+#include "../board.h"
 #include "../defs.h"
 
 namespace datagen
 {
 
-void extract(std::string dataFile, std::string outFile, u32 maxGames, u32 ppg);
+enum class ExtractFormat
+{
+    // "<fen> | <score>cp | <result>" lines
+    TEXT,
+    // 32 byte marlinformat::PackedBoard records
+    MARLINFORMAT,
+    // 32 byte bulletformat::ChessBoard records
+    BULLETFORMAT
+};
+
+struct ExtractConfig
+{
+    std::string dataFilename;
+    std::string outputFilename;
+    ExtractFormat format;
+    // positions per output file, or 0 to write everything to outputFilename
+    u64 shardSize;
+    u32 maxGames;
+    u32 ppg;
+    u32 numThreads;
+    // bounds the memory used, and so also the number of positions written
+    u64 maxPositions;
+};
+
+// streams games from a viriformat file, sampling at most ppg positions per game and
+// rebalancing them by phase, without ever holding more than maxPositions positions
+void extract(const ExtractConfig& config);
 
 }
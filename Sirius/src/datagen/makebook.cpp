@@ -0,0 +1,154 @@
+#include "makebook.h"
+#include "../polyglot.h"
+#include "../util/murmur.h"
+#include "archive.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+namespace datagen
+{
+
+namespace
+{
+
+struct BookMove
+{
+    u64 key;
+    u16 move;
+
+    bool operator==(const BookMove& other) const = default;
+};
+
+struct BookMoveHash
+{
+    usize operator()(const BookMove& bookMove) const
+    {
+        return murmurHash3(bookMove.key ^ bookMove.move);
+    }
+};
+
+struct MoveResults
+{
+    u32 wins;
+    u32 draws;
+    u32 losses;
+
+    u32 games() const
+    {
+        return wins + draws + losses;
+    }
+};
+
+using ResultMap = std::unordered_map<BookMove, MoveResults, BookMoveHash>;
+
+// the weights of the moves of one position, which are consecutive after sorting
+void scaleWeights(std::vector<polyglot::Entry>& entries, const std::vector<u64>& scores,
+    usize begin, usize end)
+{
+    u64 maxScore = *std::max_element(scores.begin() + begin, scores.begin() + end);
+    for (usize i = begin; i < end; i++)
+    {
+        u64 weight = maxScore > 0xFFFF ? scores[i] * 0xFFFF / maxScore : scores[i];
+        entries[i].weight = static_cast<u16>(weight);
+    }
+}
+
+}
+
+void makeBook(const MakeBookConfig& config)
+{
+    viriformat::Archive archive;
+    if (!archive.open(config.dataFilename))
+    {
+        std::cout << "Could not open file " << config.dataFilename << std::endl;
+        return;
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    // each thread counts the results of its own games, and they are merged afterwards
+    std::vector<ResultMap> threadResults(config.numThreads);
+    archive.parallelForEach(config.numThreads, 0, archive.gameCount(),
+        [&](u32 threadIdx, usize, const viriformat::GameView& game)
+        {
+            auto& results = threadResults[threadIdx];
+            auto [board, startScore, wdl] = marlinformat::unpackBoard(game.startpos());
+            usize plies = std::min<usize>(game.moveCount(), config.maxPly);
+            for (usize i = 0; i < plies; i++)
+            {
+                Move move = game.move(i).first.toMove();
+                auto& moveResults = results[{polyglot::hashKey(board), polyglot::encodeMove(move)}];
+                if (wdl == marlinformat::WDL::DRAW)
+                    moveResults.draws++;
+                else if ((wdl == marlinformat::WDL::WHITE_WIN)
+                    == (board.sideToMove() == Color::WHITE))
+                    moveResults.wins++;
+                else
+                    moveResults.losses++;
+                board.makeMove(move);
+            }
+        });
+
+    ResultMap& results = threadResults[0];
+    for (u32 i = 1; i < config.numThreads; i++)
+    {
+        for (const auto& [bookMove, moveResults] : threadResults[i])
+        {
+            auto& merged = results[bookMove];
+            merged.wins += moveResults.wins;
+            merged.draws += moveResults.draws;
+            merged.losses += moveResults.losses;
+        }
+        ResultMap().swap(threadResults[i]);
+    }
+
+    std::vector<polyglot::Entry> entries;
+    for (const auto& [bookMove, moveResults] : results)
+    {
+        if (moveResults.games() < config.minGames)
+            continue;
+        entries.push_back({bookMove.key, bookMove.move, 0, 0});
+    }
+
+    // sorting first puts the moves of each position next to each other
+    std::sort(entries.begin(), entries.end(),
+        [](const polyglot::Entry& a, const polyglot::Entry& b) { return a.key < b.key; });
+    std::vector<u64> scores(entries.size());
+    for (usize i = 0; i < entries.size(); i++)
+    {
+        const auto& moveResults = results.at({entries[i].key, entries[i].move});
+        scores[i] = 2ull * moveResults.wins + moveResults.draws;
+    }
+    usize positions = 0;
+    for (usize begin = 0; begin < entries.size(); positions++)
+    {
+        usize end = begin + 1;
+        while (end < entries.size() && entries[end].key == entries[begin].key)
+            end++;
+        scaleWeights(entries, scores, begin, end);
+        begin = end;
+    }
+
+    try
+    {
+        polyglot::writeBook(config.outputFilename, entries);
+    }
+    catch (const std::runtime_error& e)
+    {
+        std::cout << e.what() << std::endl;
+        return;
+    }
+
+    auto endTime = std::chrono::steady_clock::now();
+    f64 seconds = std::chrono::duration<f64>(endTime - startTime).count();
+    std::cout << "Wrote " << entries.size() << " moves from " << positions << " positions of "
+              << archive.gameCount() << " games to " << config.outputFilename << " in "
+              << seconds << " seconds" << std::endl;
+}
+
+}
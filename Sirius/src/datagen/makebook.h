@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+
+#include "../defs.h"
+
+namespace datagen
+{
+
+struct MakeBookConfig
+{
+    std::string dataFilename;
+    std::string outputFilename;
+    // only the first maxPly moves of each game are added
+    u32 maxPly;
+    // moves that were played fewer times than this from a position are left out
+    u32 minGames;
+    u32 numThreads;
+};
+
+// builds a polyglot book from the games of a viriformat file. Each move is weighted by
+// 2 * wins + draws from the perspective of the side that played it, and the weights of a
+// position are scaled down together if the largest doesn't fit in 16 bits
+void makeBook(const MakeBookConfig& config);
+
+}
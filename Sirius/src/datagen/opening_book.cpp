@@ -0,0 +1,91 @@
+#include "opening_book.h"
+
+#include <algorithm>
+#include <cctype>
+#include <random>
+#include <sstream>
+
+namespace datagen
+{
+
+bool OpeningBook::open(const std::string& filename, u64 seed)
+{
+    if (!m_File.open(filename))
+        return false;
+
+    const char* data = reinterpret_cast<const char*>(m_File.data());
+    const char* end = data + m_File.size();
+    m_Offsets.clear();
+    for (const char* line = data; line < end;)
+    {
+        const char* lineEnd = std::find(line, end, '\n');
+        if (lineEnd != line && *line != '\r')
+            m_Offsets.push_back(static_cast<u64>(line - data));
+        line = lineEnd + 1;
+    }
+
+    std::mt19937_64 gen(seed);
+    std::shuffle(m_Offsets.begin(), m_Offsets.end(), gen);
+
+    m_Verdicts = std::make_unique<std::atomic<Verdict>[]>(m_Offsets.size());
+    for (usize i = 0; i < m_Offsets.size(); i++)
+        m_Verdicts[i].store(Verdict::UNKNOWN, std::memory_order_relaxed);
+    m_Next = 0;
+    return !m_Offsets.empty();
+}
+
+usize OpeningBook::size() const
+{
+    return m_Offsets.size();
+}
+
+usize OpeningBook::next()
+{
+    for (usize i = 0; i < m_Offsets.size(); i++)
+    {
+        usize idx = m_Next.fetch_add(1, std::memory_order_relaxed) % m_Offsets.size();
+        if (verdict(idx) != Verdict::REJECTED)
+            return idx;
+    }
+    return m_Offsets.size();
+}
+
+std::string OpeningBook::fen(usize idx) const
+{
+    const char* data = reinterpret_cast<const char*>(m_File.data());
+    const char* begin = data + m_Offsets[idx];
+    const char* end = std::find(begin, data + m_File.size(), '\n');
+    std::istringstream stream{std::string(begin, end)};
+    std::vector<std::string> parts;
+    for (std::string part; parts.size() < 6 && stream >> part;)
+        parts.push_back(part);
+
+    // EPD lines have operations after the position instead of the move counters
+    auto isNumber = [](std::string_view part)
+    {
+        return !part.empty()
+            && std::all_of(part.begin(), part.end(), [](char c) { return std::isdigit(c); });
+    };
+    usize fieldCount = parts.size() >= 6 && isNumber(parts[4]) && isNumber(parts[5]) ? 6 : 4;
+
+    std::string result;
+    for (usize i = 0; i < std::min(fieldCount, parts.size()); i++)
+    {
+        if (i > 0)
+            result += ' ';
+        result += parts[i];
+    }
+    return result;
+}
+
+OpeningBook::Verdict OpeningBook::verdict(usize idx) const
+{
+    return m_Verdicts[idx].load(std::memory_order_relaxed);
+}
+
+void OpeningBook::setVerdict(usize idx, Verdict verdict)
+{
+    m_Verdicts[idx].store(verdict, std::memory_order_relaxed);
+}
+
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "../util/mapped_file.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace datagen
+{
+
+// the positions of an EPD or FEN file, one per line, which is mapped rather than loaded.
+// Threads share one shuffled order of the lines, so that every opening is used once
+// before any is used again, and the prefilter result of each opening is remembered
+class OpeningBook
+{
+public:
+    enum class Verdict : u8
+    {
+        UNKNOWN,
+        ACCEPTED,
+        REJECTED
+    };
+
+    bool open(const std::string& filename, u64 seed);
+
+    usize size() const;
+    // the next opening that hasn't been rejected, or size() if every opening has been
+    usize next();
+    // the first 4 fields of the line, and the move counters if it has them
+    std::string fen(usize idx) const;
+
+    Verdict verdict(usize idx) const;
+    void setVerdict(usize idx, Verdict verdict);
+
+private:
+    MappedFile m_File;
+    // start of each non empty line, in the shuffled order
+    std::vector<u64> m_Offsets;
+    std::unique_ptr<std::atomic<Verdict>[]> m_Verdicts;
+    std::atomic<u64> m_Next = 0;
+};
+
+}
@@ -0,0 +1,453 @@
+#include "pgn.h"
+#include "../search.h"
+#include "../uci/fen.h"
+#include "../uci/move.h"
+#include "../uci/wdl.h"
+#include "../util/mapped_file.h"
+#include "viriformat.h"
+#include "writer.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace datagen
+{
+
+namespace
+{
+
+// bytes of the file each thread parses before the games are written out
+constexpr usize THREAD_CHUNK_BYTES = 16 * 1024 * 1024;
+
+struct ParseCounts
+{
+    u64 games = 0;
+    u64 positions = 0;
+    u64 noResult = 0;
+    u64 invalid = 0;
+
+    void add(const ParseCounts& other)
+    {
+        games += other.games;
+        positions += other.positions;
+        noResult += other.noResult;
+        invalid += other.invalid;
+    }
+};
+
+bool isBlank(const char* begin, const char* end)
+{
+    return std::all_of(begin, end, [](char c) { return std::isspace(static_cast<u8>(c)); });
+}
+
+const char* lineEnd(const char* line, const char* end)
+{
+    return std::find(line, end, '\n');
+}
+
+// a game starts at a tag line when the last line before it that isn't blank is not
+// a tag line too, which is true of the first tag of every game in an export format pgn
+bool isGameStart(const char* data, const char* line)
+{
+    if (*line != '[')
+        return false;
+    while (line != data)
+    {
+        const char* prevEnd = line - 1;
+        const char* prevLine = prevEnd;
+        while (prevLine != data && prevLine[-1] != '\n')
+            prevLine--;
+        if (!isBlank(prevLine, prevEnd))
+            return *prevLine != '[';
+        line = prevLine;
+    }
+    return true;
+}
+
+// the start of the first game that starts at or after pos
+const char* nextGameStart(const char* data, const char* end, const char* pos)
+{
+    const char* line = pos;
+    if (line != data && line[-1] != '\n')
+    {
+        line = lineEnd(line, end);
+        if (line != end)
+            line++;
+    }
+    while (line != end)
+    {
+        if (isGameStart(data, line))
+            return line;
+        line = lineEnd(line, end);
+        if (line != end)
+            line++;
+    }
+    return end;
+}
+
+std::optional<marlinformat::WDL> parseResult(std::string_view result)
+{
+    if (result == "1-0")
+        return marlinformat::WDL::WHITE_WIN;
+    if (result == "0-1")
+        return marlinformat::WDL::BLACK_WIN;
+    if (result == "1/2-1/2")
+        return marlinformat::WDL::DRAW;
+    return std::nullopt;
+}
+
+// a score in pawns, or a mate in moves when it starts with # or M,
+// converted to the internal scale and signed from the given perspective
+std::optional<i32> parseScore(std::string_view str)
+{
+    bool negative = false;
+    if (!str.empty() && (str[0] == '+' || str[0] == '-'))
+    {
+        negative = str[0] == '-';
+        str.remove_prefix(1);
+    }
+
+    bool mate = !str.empty() && (str[0] == '#' || str[0] == 'M');
+    if (mate)
+    {
+        str.remove_prefix(1);
+        if (!str.empty() && (str[0] == '+' || str[0] == '-'))
+        {
+            negative = str[0] == '-';
+            str.remove_prefix(1);
+        }
+    }
+    if (str.empty() || !std::isdigit(static_cast<u8>(str[0])))
+        return std::nullopt;
+
+    std::string num(str);
+    f64 value = std::strtod(num.c_str(), nullptr);
+    i32 score = mate
+        ? SCORE_MATE - std::max(2 * static_cast<i32>(value) - 1, 0)
+        : static_cast<i32>(std::lround(value * uci::NormalizeToPawnValue));
+    score = std::clamp(score, -SCORE_MATE, SCORE_MATE);
+    return negative ? -score : score;
+}
+
+// the score in a comment after a move, from white's perspective. [%eval] scores are
+// already from white's perspective, and cutechess scores are from the side that moved
+std::optional<i32> commentScore(std::string_view comment, Color mover)
+{
+    usize evalPos = comment.find("[%eval ");
+    if (evalPos != std::string_view::npos)
+    {
+        std::string_view eval = comment.substr(evalPos + 7);
+        return parseScore(eval.substr(0, eval.find_first_of(" ,]")));
+    }
+
+    usize begin = comment.find_first_not_of(" \t\r\n");
+    if (begin == std::string_view::npos)
+        return std::nullopt;
+    std::string_view token = comment.substr(begin);
+    usize slash = token.find('/');
+    if (slash == std::string_view::npos || token.find_first_of(" \t\r\n") < slash)
+        return std::nullopt;
+    auto score = parseScore(token.substr(0, slash));
+    if (score && mover == Color::BLACK)
+        score = -*score;
+    return score;
+}
+
+// the score from white's perspective
+i16 searchScore(search::Search& search, const SearchLimits& limits, const Board& board)
+{
+    i32 score = search.datagenSearch(limits, board).first;
+    if (board.sideToMove() == Color::BLACK)
+        score = -score;
+    return static_cast<i16>(score);
+}
+
+enum class ParseResult
+{
+    OK,
+    NO_RESULT,
+    INVALID
+};
+
+class GameParser
+{
+public:
+    GameParser(const PgnConfig& config)
+    {
+        if (config.scores == PgnScores::SEARCH)
+        {
+            m_Search = std::make_unique<search::Search>(16);
+            m_Limits.softNodes = config.searchNodes;
+            m_Limits.maxNodes = config.searchNodes;
+            m_Limits.maxDepth = MAX_PLY;
+        }
+        m_Scores = config.scores;
+    }
+
+    ParseResult parse(const char* begin, const char* end, viriformat::Game& game)
+    {
+        std::string fen;
+        std::optional<marlinformat::WDL> wdl;
+        bool frc = false;
+
+        const char* line = begin;
+        while (line != end)
+        {
+            const char* lineStop = lineEnd(line, end);
+            if (!isBlank(line, lineStop) && *line != '[')
+                break;
+            if (*line == '[')
+                parseTag(std::string_view(line, lineStop), fen, wdl, frc);
+            line = lineStop == end ? end : lineStop + 1;
+        }
+
+        Board board;
+        if (!fen.empty())
+        {
+            if (!uci::isValidFen(fen.c_str()))
+                return ParseResult::INVALID;
+            board.setToFen(fen, frc);
+        }
+        Board startpos = board;
+        game.moves.clear();
+
+        constexpr usize npos = std::string::npos;
+        bool needsScore = false;
+        std::string token;
+        const char* pos = line;
+        while (pos != end)
+        {
+            char c = *pos;
+            if (std::isspace(static_cast<u8>(c)))
+            {
+                pos++;
+            }
+            else if (c == '{' || c == ';')
+            {
+                const char* commentEnd = std::find(pos + 1, end, c == '{' ? '}' : '\n');
+                if (needsScore && m_Scores == PgnScores::COMMENTS)
+                {
+                    auto score = commentScore(
+                        std::string_view(pos + 1, commentEnd), ~board.sideToMove());
+                    if (score)
+                    {
+                        game.moves.back().second = static_cast<i16>(*score);
+                        needsScore = false;
+                    }
+                }
+                pos = commentEnd == end ? end : commentEnd + 1;
+            }
+            else if (c == '(')
+            {
+                pos = skipVariation(pos, end);
+            }
+            else
+            {
+                const char* tokenEnd = pos;
+                while (tokenEnd != end && !std::isspace(static_cast<u8>(*tokenEnd))
+                    && *tokenEnd != '{' && *tokenEnd != '(' && *tokenEnd != ';')
+                    tokenEnd++;
+                token.assign(pos, tokenEnd);
+                pos = tokenEnd;
+
+                if (token == "*" || parseResult(token))
+                {
+                    if (token != "*")
+                        wdl = parseResult(token);
+                    break;
+                }
+                if (token[0] == '$' || token[0] == '%')
+                    continue;
+
+                // move numbers can be attached to the move, as in "12.e4" or "12...e5"
+                usize moveBegin = token.find_first_not_of("0123456789");
+                if (moveBegin == npos)
+                    continue;
+                if (moveBegin > 0 && token[moveBegin] == '.')
+                    token.erase(0, token.find_first_not_of('.', moveBegin));
+                while (!token.empty() && std::string_view("!?+#").find(token.back()) != npos)
+                    token.pop_back();
+                if (token.empty())
+                    continue;
+                if (token[0] == '0')
+                    std::replace(token.begin(), token.end(), '0', 'O');
+
+                MoveList legalMoves;
+                genMoves<MoveGenType::LEGAL>(board, legalMoves);
+                auto find = uci::findMoveFromSAN(board, legalMoves, token.c_str());
+                if (find.result != uci::MoveStrFind::Result::FOUND)
+                    return ParseResult::INVALID;
+
+                i16 score = m_Search ? searchScore(*m_Search, m_Limits, board) : 0;
+                game.moves.push_back({viriformat::ViriMove(find.move), score});
+                board.makeMove(find.move);
+                needsScore = true;
+            }
+        }
+
+        if (!wdl)
+            return ParseResult::NO_RESULT;
+        if (m_Search)
+            m_Search->newGame();
+        game.startpos = marlinformat::packBoard(startpos, 0, *wdl);
+        return ParseResult::OK;
+    }
+
+private:
+    static void parseTag(std::string_view tag, std::string& fen,
+        std::optional<marlinformat::WDL>& wdl, bool& frc)
+    {
+        usize nameEnd = tag.find(' ');
+        usize valueBegin = tag.find('"');
+        usize valueEnd = tag.rfind('"');
+        if (nameEnd == std::string_view::npos || valueBegin == std::string_view::npos
+            || valueEnd <= valueBegin)
+            return;
+        std::string_view name = tag.substr(1, nameEnd - 1);
+        std::string_view value = tag.substr(valueBegin + 1, valueEnd - valueBegin - 1);
+        if (name == "FEN")
+            fen = value;
+        else if (name == "Result")
+            wdl = parseResult(value);
+        else if (name == "Variant")
+            frc = value.find("960") != std::string_view::npos;
+    }
+
+    static const char* skipVariation(const char* pos, const char* end)
+    {
+        i32 depth = 0;
+        for (; pos != end; pos++)
+        {
+            if (*pos == '{')
+            {
+                pos = std::find(pos, end, '}');
+                if (pos == end)
+                    return end;
+            }
+            else if (*pos == '(')
+                depth++;
+            else if (*pos == ')' && --depth == 0)
+                return pos + 1;
+        }
+        return end;
+    }
+
+    PgnScores m_Scores;
+    std::unique_ptr<search::Search> m_Search;
+    SearchLimits m_Limits = {};
+};
+
+}
+
+void pgnToViri(const PgnConfig& config)
+{
+    MappedFile file;
+    if (!file.open(config.inputFilename))
+    {
+        std::cout << "Could not open file " << config.inputFilename << std::endl;
+        return;
+    }
+    file.adviseSequential();
+    DataWriter writer(config.outputFilename, 0);
+    if (!writer.isOpen())
+    {
+        std::cout << "Could not open file " << config.outputFilename << std::endl;
+        return;
+    }
+
+    u32 numThreads = config.numThreads;
+    std::vector<std::unique_ptr<GameParser>> parsers;
+    for (u32 i = 0; i < numThreads; i++)
+        parsers.push_back(std::make_unique<GameParser>(config));
+    std::vector<std::string> outputs(numThreads);
+    std::vector<ParseCounts> threadCounts(numThreads);
+
+    const char* data = reinterpret_cast<const char*>(file.data());
+    const char* end = data + file.size();
+    ParseCounts counts;
+    auto startTime = std::chrono::steady_clock::now();
+
+    const char* chunkBegin = nextGameStart(data, end, data);
+    while (chunkBegin != end)
+    {
+        // each thread gets the games starting in its part of the chunk
+        std::vector<const char*> bounds = {chunkBegin};
+        for (u32 i = 0; i < numThreads; i++)
+        {
+            usize remaining = static_cast<usize>(end - bounds.back());
+            const char* target = bounds.back() + std::min(THREAD_CHUNK_BYTES, remaining);
+            bounds.push_back(nextGameStart(data, end, target));
+        }
+
+        {
+            std::vector<std::jthread> threads;
+            threads.reserve(numThreads);
+            for (u32 i = 0; i < numThreads; i++)
+            {
+                threads.emplace_back(
+                    [&, i]()
+                    {
+                        std::ostringstream stream;
+                        viriformat::Game game;
+                        const char* gameBegin = bounds[i];
+                        while (gameBegin != bounds[i + 1])
+                        {
+                            const char* gameEnd = nextGameStart(data, end, gameBegin + 1);
+                            switch (parsers[i]->parse(gameBegin, gameEnd, game))
+                            {
+                                case ParseResult::OK:
+                                    game.write(stream);
+                                    threadCounts[i].games++;
+                                    threadCounts[i].positions += game.moves.size();
+                                    break;
+                                case ParseResult::NO_RESULT:
+                                    threadCounts[i].noResult++;
+                                    break;
+                                case ParseResult::INVALID:
+                                    threadCounts[i].invalid++;
+                                    break;
+                            }
+                            gameBegin = gameEnd;
+                        }
+                        outputs[i] = std::move(stream).str();
+                    });
+            }
+        }
+
+        for (u32 i = 0; i < numThreads; i++)
+        {
+            writer.write(outputs[i].data(), outputs[i].size());
+            counts.add(threadCounts[i]);
+            threadCounts[i] = {};
+        }
+        chunkBegin = bounds.back();
+
+        auto now = std::chrono::steady_clock::now();
+        f64 seconds = std::chrono::duration<f64>(now - startTime).count();
+        std::cout << "Converted " << counts.games << " games, "
+                  << static_cast<u64>(static_cast<f64>(counts.games) / seconds) << " games/s, "
+                  << 100.0 * static_cast<f64>(chunkBegin - data) / static_cast<f64>(file.size())
+                  << "% of the file" << std::endl;
+    }
+    writer.flush();
+
+    f64 seconds =
+        std::chrono::duration<f64>(std::chrono::steady_clock::now() - startTime).count();
+    std::cout << "Finished converting " << counts.games << " games with " << counts.positions
+              << " positions to " << config.outputFilename << " in " << seconds << "s, "
+              << static_cast<u64>(static_cast<f64>(counts.games) / seconds) << " games/s"
+              << std::endl;
+    std::cout << "Skipped " << counts.noResult << " games without a result and "
+              << counts.invalid << " games with invalid moves" << std::endl;
+}
+
+}
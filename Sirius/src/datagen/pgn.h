@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+
+#include "../defs.h"
+
+namespace datagen
+{
+
+enum class PgnScores
+{
+    // every position is scored 0
+    NONE,
+    // scores are taken from [%eval ...] comments or cutechess style "+0.25/12" comments
+    // after each move, and positions without one are scored 0
+    COMMENTS,
+    // every position is scored by a search of searchNodes nodes
+    SEARCH
+};
+
+struct PgnConfig
+{
+    std::string inputFilename;
+    std::string outputFilename;
+    PgnScores scores;
+    u64 searchNodes;
+    u32 numThreads;
+};
+
+// converts the games of a pgn file to viriformat, with the result of each game taken from
+// its movetext or its Result tag. Games without a result or with moves that can't be
+// parsed are skipped. The file is mapped and split between threads on game boundaries
+void pgnToViri(const PgnConfig& config);
+
+}
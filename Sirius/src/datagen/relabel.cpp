@@ -0,0 +1,229 @@
+#include "relabel.h"
+#include "../search.h"
+#include "viriformat.h"
+#include "writer.h"
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace datagen
+{
+
+namespace
+{
+
+constexpr usize CHUNK_RECORDS = 4096;
+constexpr usize CHUNK_GAMES = 64;
+
+struct Checkpoint
+{
+    u64 inputOffset = 0;
+    u64 outputSize = 0;
+    u64 positions = 0;
+};
+
+std::string checkpointFilename(const RelabelConfig& config)
+{
+    return config.outputFilename + ".checkpoint";
+}
+
+bool readCheckpoint(const RelabelConfig& config, Checkpoint& checkpoint)
+{
+    std::ifstream file(checkpointFilename(config));
+    if (!file.is_open())
+        return false;
+    file >> checkpoint.inputOffset >> checkpoint.outputSize >> checkpoint.positions;
+    return static_cast<bool>(file);
+}
+
+// written to a temporary file and renamed so that it is never partially written
+void writeCheckpoint(const RelabelConfig& config, const Checkpoint& checkpoint)
+{
+    std::string filename = checkpointFilename(config);
+    {
+        std::ofstream file(filename + ".tmp", std::ios::trunc);
+        file << checkpoint.inputOffset << ' ' << checkpoint.outputSize << ' '
+             << checkpoint.positions << std::endl;
+    }
+    std::filesystem::rename(filename + ".tmp", filename);
+}
+
+// the score from white's perspective
+i16 searchScore(search::Search& search, const SearchLimits& limits, const Board& board)
+{
+    i32 score = search.datagenSearch(limits, board).first;
+    if (board.sideToMove() == Color::BLACK)
+        score = -score;
+    return static_cast<i16>(score);
+}
+
+class Relabeler
+{
+public:
+    Relabeler(const RelabelConfig& config)
+    {
+        m_Limits.softNodes = config.softNodes;
+        m_Limits.maxNodes = config.hardNodes;
+        m_Limits.maxDepth = config.depth;
+        for (u32 i = 0; i < config.numThreads; i++)
+            m_Searches.push_back(std::make_unique<search::Search>(config.hashMB));
+    }
+
+    // items are handed out one at a time, since their search times vary a lot
+    template<typename T, typename Func>
+    void run(std::vector<T>& items, const Func& func)
+    {
+        std::atomic<usize> nextItem = 0;
+        std::vector<std::jthread> threads;
+        threads.reserve(m_Searches.size());
+        for (auto& search : m_Searches)
+        {
+            threads.emplace_back(
+                [&, searchPtr = search.get()]()
+                {
+                    usize idx;
+                    while ((idx = nextItem.fetch_add(1)) < items.size())
+                        func(*searchPtr, items[idx]);
+                });
+        }
+    }
+
+    // returns the number of positions relabeled
+    u64 relabelRecords(std::vector<marlinformat::PackedBoard>& records)
+    {
+        run(records,
+            [this](search::Search& search, marlinformat::PackedBoard& record)
+            {
+                Board board = marlinformat::unpackBoard(record).board;
+                record.score = searchScore(search, m_Limits, board);
+            });
+        return records.size();
+    }
+
+    u64 relabelGames(std::vector<viriformat::Game>& games)
+    {
+        run(games,
+            [this](search::Search& search, viriformat::Game& game)
+            {
+                search.newGame();
+                Board board = marlinformat::unpackBoard(game.startpos).board;
+                for (auto& [viriMove, score] : game.moves)
+                {
+                    score = searchScore(search, m_Limits, board);
+                    board.makeMove(viriMove.toMove());
+                }
+            });
+
+        u64 positions = 0;
+        for (const auto& game : games)
+            positions += game.moves.size();
+        return positions;
+    }
+
+private:
+    SearchLimits m_Limits = {};
+    std::vector<std::unique_ptr<search::Search>> m_Searches;
+};
+
+}
+
+void relabel(const RelabelConfig& config)
+{
+    std::ifstream inputFile(config.inputFilename, std::ios::binary);
+    if (!inputFile.is_open())
+    {
+        std::cout << "Could not open file " << config.inputFilename << std::endl;
+        return;
+    }
+
+    Checkpoint checkpoint;
+    if (readCheckpoint(config, checkpoint) && std::filesystem::exists(config.outputFilename))
+    {
+        std::cout << "Resuming from checkpoint after " << checkpoint.positions << " positions"
+                  << std::endl;
+        // anything written after the checkpoint will be written again
+        std::filesystem::resize_file(config.outputFilename, checkpoint.outputSize);
+        inputFile.seekg(static_cast<std::streamoff>(checkpoint.inputOffset));
+    }
+    else
+    {
+        checkpoint = {};
+        std::ofstream(config.outputFilename, std::ios::binary | std::ios::trunc);
+    }
+
+    DataWriter writer(config.outputFilename, 0);
+    if (!writer.isOpen())
+    {
+        std::cout << "Could not open file " << config.outputFilename << std::endl;
+        return;
+    }
+
+    std::cout << "Relabeling with " << config.numThreads << " threads, " << config.softNodes
+              << " soft nodes, " << config.hardNodes << " hard nodes and depth " << config.depth
+              << std::endl;
+
+    Relabeler relabeler(config);
+    std::vector<marlinformat::PackedBoard> records;
+    std::vector<viriformat::Game> games;
+    u64 positions = 0;
+    auto startTime = std::chrono::steady_clock::now();
+
+    while (inputFile.peek() != EOF)
+    {
+        u64 chunkPositions;
+        if (config.format == RelabelFormat::MARLINFORMAT)
+        {
+            records.resize(CHUNK_RECORDS);
+            inputFile.read(reinterpret_cast<char*>(records.data()),
+                static_cast<std::streamsize>(records.size() * sizeof(marlinformat::PackedBoard)));
+            records.resize(
+                static_cast<usize>(inputFile.gcount()) / sizeof(marlinformat::PackedBoard));
+            inputFile.clear();
+
+            chunkPositions = relabeler.relabelRecords(records);
+            for (const auto& record : records)
+                writer.write(&record, sizeof(record));
+        }
+        else
+        {
+            games.clear();
+            while (games.size() < CHUNK_GAMES && inputFile.peek() != EOF)
+                games.push_back(viriformat::Game::read(inputFile));
+
+            chunkPositions = relabeler.relabelGames(games);
+            for (const auto& game : games)
+            {
+                // viriformat games are written through a stream
+                std::ostringstream stream;
+                game.write(stream);
+                std::string bytes = stream.str();
+                writer.write(bytes.data(), bytes.size());
+            }
+        }
+        writer.flush();
+
+        checkpoint.inputOffset = static_cast<u64>(inputFile.tellg());
+        checkpoint.outputSize = std::filesystem::file_size(config.outputFilename);
+        checkpoint.positions += chunkPositions;
+        positions += chunkPositions;
+        writeCheckpoint(config, checkpoint);
+
+        auto now = std::chrono::steady_clock::now();
+        f64 seconds = std::chrono::duration<f64>(now - startTime).count();
+        std::cout << "Relabeled " << checkpoint.positions << " positions, "
+                  << static_cast<u64>(static_cast<f64>(positions) / seconds) << " positions/s"
+                  << std::endl;
+    }
+
+    std::filesystem::remove(checkpointFilename(config));
+    std::cout << "Finished relabeling " << checkpoint.positions << " positions" << std::endl;
+}
+
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+
+#include "../defs.h"
+
+namespace datagen
+{
+
+enum class RelabelFormat
+{
+    VIRIFORMAT,
+    MARLINFORMAT
+};
+
+struct RelabelConfig
+{
+    std::string inputFilename;
+    std::string outputFilename;
+    RelabelFormat format;
+    // 0 for no limit
+    u64 softNodes;
+    u64 hardNodes;
+    i32 depth;
+    u32 numThreads;
+    i32 hashMB;
+};
+
+// rescores every position of a viriformat or marlinformat file with a new search,
+// writing the same records in the same order with the new scores. A checkpoint
+// is written after every chunk, and the relabel resumes from it if it exists
+void relabel(const RelabelConfig& config);
+
+}
@@ -0,0 +1,344 @@
+#include "shuffle.h"
+#include "marlinformat.h"
+#include "writer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <thread>
+
+namespace datagen
+{
+
+namespace
+{
+
+using Record = marlinformat::PackedBoard;
+static_assert(sizeof(Record) == 32);
+
+constexpr usize READ_BLOCK_RECORDS = 1 << 15;
+constexpr usize MIN_BUCKET_BUFFER_RECORDS = 1 << 8;
+constexpr usize MAX_BUCKET_BUFFER_RECORDS = 1 << 16;
+// well below the usual limit of 1024 open files, buckets that need more are scattered again
+constexpr usize MAX_OPEN_BUCKETS = 256;
+// bucket sizes vary a little, and the second pass needs one bucket per thread in memory
+constexpr f64 BUCKET_SLACK = 1.25;
+
+struct Bucket
+{
+    std::mutex mutex;
+    std::ofstream file;
+    std::string filename;
+};
+
+struct InputFile
+{
+    std::string filename;
+    // index of the first record of this file among all records
+    u64 begin;
+    u64 count;
+};
+
+// removes the bucket files that are still there when it's destroyed, so
+// that none are left behind when shuffling stops early
+struct TempFiles
+{
+    ~TempFiles()
+    {
+        for (const auto& filename : filenames)
+        {
+            std::error_code ec;
+            std::filesystem::remove(filename, ec);
+        }
+    }
+
+    std::vector<std::string> filenames;
+};
+
+struct ScatterPlan
+{
+    usize bucketCount;
+    // records buffered for each bucket by each thread
+    usize bufferRecords;
+};
+
+f64 megabytes(u64 records)
+{
+    return static_cast<f64>(records * sizeof(Record)) / (1024.0 * 1024.0);
+}
+
+// scatters the records in [begin, end) of all the inputs to random buckets
+void scatterRange(const std::vector<InputFile>& inputs, u64 begin, u64 end,
+    std::vector<Bucket>& buckets, usize bufferRecords, u64 seed)
+{
+    std::mt19937_64 gen(seed);
+    std::uniform_int_distribution<usize> bucketDist(0, buckets.size() - 1);
+    std::vector<std::vector<Record>> buffers(buckets.size());
+    for (auto& buffer : buffers)
+        buffer.reserve(bufferRecords);
+
+    auto flushBuffer = [&](usize bucketIdx)
+    {
+        auto& buffer = buffers[bucketIdx];
+        std::lock_guard<std::mutex> lock(buckets[bucketIdx].mutex);
+        buckets[bucketIdx].file.write(reinterpret_cast<const char*>(buffer.data()),
+            static_cast<std::streamsize>(buffer.size() * sizeof(Record)));
+        buffer.clear();
+    };
+
+    std::vector<Record> block(READ_BLOCK_RECORDS);
+    for (const auto& input : inputs)
+    {
+        u64 fileBegin = std::max(begin, input.begin);
+        u64 fileEnd = std::min(end, input.begin + input.count);
+        if (fileBegin >= fileEnd)
+            continue;
+
+        std::ifstream file(input.filename, std::ios::binary);
+        file.seekg(static_cast<std::streamoff>((fileBegin - input.begin) * sizeof(Record)));
+        for (u64 pos = fileBegin; pos < fileEnd; pos += READ_BLOCK_RECORDS)
+        {
+            usize count = static_cast<usize>(std::min<u64>(READ_BLOCK_RECORDS, fileEnd - pos));
+            file.read(reinterpret_cast<char*>(block.data()),
+                static_cast<std::streamsize>(count * sizeof(Record)));
+            for (usize i = 0; i < count; i++)
+            {
+                usize bucketIdx = bucketDist(gen);
+                buffers[bucketIdx].push_back(block[i]);
+                if (buffers[bucketIdx].size() == bufferRecords)
+                    flushBuffer(bucketIdx);
+            }
+        }
+    }
+
+    for (usize i = 0; i < buckets.size(); i++)
+        if (!buffers[i].empty())
+            flushBuffer(i);
+}
+
+// the number of buckets to split the records into so that each is expected to take at most
+// leafBytes, limited by the open files and by the scatter buffers of every thread having to
+// fit in memoryBytes, or nothing if the buffers of even two buckets don't fit
+std::optional<ScatterPlan> planScatter(u64 records, u64 leafBytes, u64 memoryBytes, u32 numThreads)
+{
+    f64 bytes = static_cast<f64>(records * sizeof(Record)) * BUCKET_SLACK;
+    usize needed =
+        std::max<usize>(static_cast<usize>(std::ceil(bytes / static_cast<f64>(leafBytes))), 1);
+
+    u64 threadBytes = memoryBytes / numThreads;
+    u64 readBytes = READ_BLOCK_RECORDS * sizeof(Record);
+    if (threadBytes <= readBytes)
+        return std::nullopt;
+    u64 bufferBytes = threadBytes - readBytes;
+    usize maxBuckets =
+        static_cast<usize>(bufferBytes / (MIN_BUCKET_BUFFER_RECORDS * sizeof(Record)));
+
+    usize bucketCount = std::min({needed, MAX_OPEN_BUCKETS, maxBuckets});
+    if (bucketCount == 0 || (needed > 1 && bucketCount < 2))
+        return std::nullopt;
+
+    usize bufferRecords = std::min<usize>(
+        static_cast<usize>(bufferBytes / (bucketCount * sizeof(Record))),
+        MAX_BUCKET_BUFFER_RECORDS);
+    return ScatterPlan{bucketCount, bufferRecords};
+}
+
+// scatters the records of the inputs to new buckets named <prefix>.<i>, and returns
+// them as inputs for the next pass, or nothing if a bucket couldn't be written
+std::optional<std::vector<InputFile>> scatter(const std::vector<InputFile>& inputs,
+    u64 totalRecords, const ScatterPlan& plan, const std::string& prefix, u32 numThreads,
+    std::mt19937_64& gen, TempFiles& tempFiles)
+{
+    std::vector<Bucket> buckets(plan.bucketCount);
+    for (usize i = 0; i < buckets.size(); i++)
+    {
+        buckets[i].filename = prefix + "." + std::to_string(i);
+        tempFiles.filenames.push_back(buckets[i].filename);
+        buckets[i].file.open(buckets[i].filename, std::ios::binary | std::ios::trunc);
+        if (!buckets[i].file.is_open())
+        {
+            std::cout << "Could not open file " << buckets[i].filename << std::endl;
+            return std::nullopt;
+        }
+    }
+
+    {
+        std::vector<std::jthread> threads;
+        threads.reserve(numThreads);
+        for (u32 i = 0; i < numThreads; i++)
+            threads.emplace_back(scatterRange, std::cref(inputs), totalRecords * i / numThreads,
+                totalRecords * (i + 1) / numThreads, std::ref(buckets), plan.bufferRecords, gen());
+    }
+
+    std::vector<InputFile> result;
+    u64 begin = 0;
+    for (auto& bucket : buckets)
+    {
+        bucket.file.close();
+        if (!bucket.file)
+        {
+            std::cout << "Could not write file " << bucket.filename << std::endl;
+            return std::nullopt;
+        }
+
+        u64 count = std::filesystem::file_size(bucket.filename) / sizeof(Record);
+        result.push_back({bucket.filename, begin, count});
+        begin += count;
+    }
+    return result;
+}
+
+// appends the buckets that fit in leafBytes to leaves, in order, and scatters
+// the others again in their place. Returns false if a bucket couldn't be written
+bool splitBuckets(const std::vector<InputFile>& buckets, u64 leafBytes, u64 memoryBytes,
+    u32 numThreads, std::mt19937_64& gen, TempFiles& tempFiles, std::vector<InputFile>& leaves)
+{
+    for (const auto& bucket : buckets)
+    {
+        if (bucket.count * sizeof(Record) <= leafBytes)
+        {
+            leaves.push_back(bucket);
+            continue;
+        }
+
+        auto plan = planScatter(bucket.count, leafBytes, memoryBytes, numThreads);
+        if (!plan)
+            return false;
+        std::vector<InputFile> input = {{bucket.filename, 0, bucket.count}};
+        auto split =
+            scatter(input, bucket.count, *plan, bucket.filename, numThreads, gen, tempFiles);
+        if (!split)
+            return false;
+        std::filesystem::remove(bucket.filename);
+
+        if (!splitBuckets(*split, leafBytes, memoryBytes, numThreads, gen, tempFiles, leaves))
+            return false;
+    }
+    return true;
+}
+
+}
+
+void shuffle(const ShuffleConfig& config)
+{
+    std::random_device rd;
+    auto seed = rd();
+    std::mt19937_64 gen(seed);
+    std::cout << "Using seed " << seed << std::endl;
+
+    std::vector<InputFile> inputs;
+    u64 totalRecords = 0;
+    for (const auto& filename : config.inputFilenames)
+    {
+        std::error_code ec;
+        u64 size = std::filesystem::file_size(filename, ec);
+        if (ec)
+        {
+            std::cout << "Could not open file " << filename << std::endl;
+            return;
+        }
+        if (size % sizeof(Record) != 0)
+            std::cout << filename << " has a partial record at the end, which will be ignored"
+                      << std::endl;
+
+        inputs.push_back({filename, totalRecords, size / sizeof(Record)});
+        totalRecords += size / sizeof(Record);
+    }
+
+    if (totalRecords == 0)
+    {
+        std::cout << "No positions to shuffle" << std::endl;
+        return;
+    }
+
+    u32 numThreads = config.numThreads;
+    u64 memoryBytes = config.memoryMB * 1024 * 1024;
+    // the second pass holds one bucket per thread in memory
+    u64 leafBytes = memoryBytes / numThreads;
+
+    auto plan = planScatter(totalRecords, leafBytes, memoryBytes, numThreads);
+    if (!plan)
+    {
+        u64 minBytes = numThreads
+            * (READ_BLOCK_RECORDS + 2 * MIN_BUCKET_BUFFER_RECORDS) * sizeof(Record);
+        std::cout << "Shuffling with " << numThreads << " threads needs at least "
+                  << (minBytes + 1024 * 1024 - 1) / (1024 * 1024) << " MB of memory" << std::endl;
+        return;
+    }
+
+    std::filesystem::path tempDir = config.tempDir.empty()
+        ? std::filesystem::absolute(config.outputFilename).parent_path()
+        : std::filesystem::path(config.tempDir);
+    std::string tempName = std::filesystem::path(config.outputFilename).filename().string();
+
+    std::cout << "Shuffling " << totalRecords << " positions (" << megabytes(totalRecords)
+              << " MB) from " << inputs.size() << " file(s)" << std::endl;
+
+    auto startTime = std::chrono::steady_clock::now();
+    TempFiles tempFiles;
+    auto buckets = scatter(inputs, totalRecords, *plan, (tempDir / (tempName + ".bucket")).string(),
+        numThreads, gen, tempFiles);
+    std::vector<InputFile> leaves;
+    if (!buckets
+        || !splitBuckets(*buckets, leafBytes, memoryBytes, numThreads, gen, tempFiles, leaves))
+        return;
+
+    auto scatterTime = std::chrono::steady_clock::now();
+    f64 scatterSeconds = std::chrono::duration<f64>(scatterTime - startTime).count();
+    std::cout << "Scattered positions to " << leaves.size() << " bucket(s) at "
+              << megabytes(totalRecords) / scatterSeconds << " MB/s" << std::endl;
+
+    DataWriter writer(config.outputFilename, config.shardSize);
+    std::mutex writerMutex;
+    std::atomic<usize> nextBucket = 0;
+    {
+        std::vector<std::jthread> threads;
+        threads.reserve(numThreads);
+        for (u32 i = 0; i < numThreads; i++)
+        {
+            threads.emplace_back(
+                [&, threadSeed = gen()]()
+                {
+                    std::mt19937_64 threadGen(threadSeed);
+                    std::vector<Record> records;
+                    usize bucketIdx;
+                    while ((bucketIdx = nextBucket.fetch_add(1)) < leaves.size())
+                    {
+                        const std::string& filename = leaves[bucketIdx].filename;
+                        records.resize(leaves[bucketIdx].count);
+                        {
+                            std::ifstream file(filename, std::ios::binary);
+                            file.read(reinterpret_cast<char*>(records.data()),
+                                static_cast<std::streamsize>(records.size() * sizeof(Record)));
+                        }
+                        std::filesystem::remove(filename);
+
+                        std::shuffle(records.begin(), records.end(), threadGen);
+
+                        std::lock_guard<std::mutex> lock(writerMutex);
+                        for (const auto& record : records)
+                            writer.write(&record, sizeof(record));
+                    }
+                });
+        }
+    }
+    writer.flush();
+
+    auto endTime = std::chrono::steady_clock::now();
+    f64 shuffleSeconds = std::chrono::duration<f64>(endTime - scatterTime).count();
+    f64 totalSeconds = std::chrono::duration<f64>(endTime - startTime).count();
+    std::cout << "Shuffled buckets at " << megabytes(totalRecords) / shuffleSeconds << " MB/s"
+              << std::endl;
+    std::cout << "Finished shuffling " << writer.recordCount() << " positions into "
+              << writer.shardCount() << " file(s) in " << totalSeconds << "s ("
+              << megabytes(totalRecords) / totalSeconds << " MB/s)" << std::endl;
+}
+
+}
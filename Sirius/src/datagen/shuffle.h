@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "../defs.h"
+
+namespace datagen
+{
+
+struct ShuffleConfig
+{
+    std::vector<std::string> inputFilenames;
+    std::string outputFilename;
+    // where the buckets are written, the directory of the output if empty
+    std::string tempDir;
+    u64 memoryMB;
+    u32 numThreads;
+    // positions per output file, or 0 to write everything to outputFilename
+    u64 shardSize;
+};
+
+// shuffles the 32 byte records of marlinformat or bulletformat files together
+// in two passes, so that the files don't have to fit in memory. The first pass
+// scatters the records to random buckets on disk, again for any bucket that is
+// too big, and the second shuffles each bucket in memory and appends it to the output
+void shuffle(const ShuffleConfig& config);
+
+}
@@ -1,74 +1,464 @@
 #include "stats.h"
+#include "../util/mapped_file.h"
+#include "../util/parallel_for.h"
+#include "../util/phase.h"
+#include "archive.h"
+#include "bulletformat.h"
+#include "datagen.h"
+
+#include <algorithm>
 #include <array>
-#include <fstream>
+#include <bit>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
-
-#include "../defs.h"
+#include <thread>
+#include <vector>
 
 namespace datagen
 {
 
-void computeStats(std::string fensFile)
+namespace
+{
+
+constexpr i32 SCORE_LIMIT = 1000;
+constexpr i32 SCORE_BUCKET_SIZE = 100;
+// one bucket for each side of the limits as well
+constexpr usize SCORE_BUCKETS = 2 * SCORE_LIMIT / SCORE_BUCKET_SIZE + 2;
+
+constexpr i32 LENGTH_BUCKET_SIZE = 20;
+// the last bucket is every game longer than the others
+constexpr usize LENGTH_BUCKETS = 21;
+
+// how a viriformat game ended, as far as can be told from its moves and scores
+enum class Ending
+{
+    CHECKMATE,
+    DRAW_BY_RULE,
+    // the search found a mate, which datagen stops at without playing it out
+    MATE_SCORE,
+    WIN_ADJUDICATION,
+    DRAW_ADJUDICATION,
+    OTHER,
+    COUNT
+};
+
+constexpr usize ENDING_COUNT = static_cast<usize>(Ending::COUNT);
+
+struct Stats
 {
-    std::ifstream file(fensFile);
-    std::string line;
+    u64 positions = 0;
+    u64 games = 0;
+    std::array<u64, PHASE_COUNT> phases = {};
+    std::array<u64, 33> pieces = {};
+    std::array<u64, 17> pawns = {};
+    std::array<u64, SCORE_BUCKETS> scores = {};
+    std::array<u64, 3> results = {};
+    std::array<u64, LENGTH_BUCKETS> gameLengths = {};
+    std::array<u64, 3> gameResults = {};
+    std::array<u64, ENDING_COUNT> endings = {};
+
+    void addPosition(i32 phase, i32 pieceCount, i32 pawnCount)
+    {
+        positions++;
+        phases[std::min(phase, PHASE_COUNT - 1)]++;
+        pieces[std::min(pieceCount, 32)]++;
+        pawns[std::min(pawnCount, 16)]++;
+    }
+
+    void addScore(i32 score)
+    {
+        usize bucket = score < -SCORE_LIMIT ? 0
+            : score >= SCORE_LIMIT          ? SCORE_BUCKETS - 1
+                                            : (score + SCORE_LIMIT) / SCORE_BUCKET_SIZE + 1;
+        scores[bucket]++;
+    }
 
-    std::array<u32, 33> pieceCounts = {};
-    std::array<u32, 25> phaseCounts = {};
-    std::array<u32, 17> pawnCounts = {};
-    std::array<std::array<u32, 17>, 25> pawnPhaseCounts = {};
+    void add(const Stats& other)
+    {
+        auto addArray = [](auto& a, const auto& b)
+        {
+            for (usize i = 0; i < a.size(); i++)
+                a[i] += b[i];
+        };
+        positions += other.positions;
+        games += other.games;
+        addArray(phases, other.phases);
+        addArray(pieces, other.pieces);
+        addArray(pawns, other.pawns);
+        addArray(scores, other.scores);
+        addArray(results, other.results);
+        addArray(gameLengths, other.gameLengths);
+        addArray(gameResults, other.gameResults);
+        addArray(endings, other.endings);
+    }
+};
 
-    while (std::getline(file, line))
+// marlinformat and bulletformat both store the pieces in the order of occ with
+// the piece type in the low 3 bits, and marlinformat's castling rooks as 6
+void addPackedPosition(Stats& stats, u64 occ, const std::array<u8, 16>& pieces)
+{
+    i32 pieceCount = std::popcount(occ);
+    i32 phase = 0;
+    i32 pawnCount = 0;
+    for (i32 i = 0; i < pieceCount; i++)
     {
-        i32 phase = 0;
-        i32 pawnCount = 0;
-        i32 pieceCount = 0;
-        for (char c : line)
+        switch ((pieces[i / 2] >> (4 * (i % 2))) & 0x7)
         {
-            if (c == ' ')
+            case 0:
+                pawnCount++;
+                break;
+            case 1:
+            case 2:
+                phase++;
+                break;
+            case 3:
+            case 6:
+                phase += 2;
                 break;
-            if (std::isalpha(c))
-                pieceCount++;
-            switch (c)
+            case 4:
+                phase += 4;
+                break;
+        }
+    }
+    stats.addPosition(phase, pieceCount, pawnCount);
+}
+
+void addLine(Stats& stats, const char* begin, const char* end)
+{
+    i32 phase = 0;
+    i32 pawnCount = 0;
+    i32 pieceCount = 0;
+    const char* c = begin;
+    for (; c != end && *c != ' '; c++)
+    {
+        if (std::isalpha(*c))
+            pieceCount++;
+        switch (*c)
+        {
+            case 'p':
+            case 'P':
+                pawnCount++;
+                break;
+            case 'n':
+            case 'N':
+            case 'b':
+            case 'B':
+                phase++;
+                break;
+            case 'r':
+            case 'R':
+                phase += 2;
+                break;
+            case 'q':
+            case 'Q':
+                phase += 4;
+                break;
+        }
+    }
+    if (c == begin)
+        return;
+    stats.addPosition(phase, pieceCount, pawnCount);
+
+    const char* scoreSep = std::find(c, end, '|');
+    if (scoreSep == end)
+        return;
+    const char* scoreBegin = scoreSep + 1;
+    while (scoreBegin != end && *scoreBegin == ' ')
+        scoreBegin++;
+    i32 score;
+    if (std::from_chars(scoreBegin, end, score).ec == std::errc())
+        stats.addScore(score);
+
+    const char* resultSep = std::find(scoreBegin, end, '|');
+    if (resultSep == end)
+        return;
+    f64 result = std::strtod(resultSep + 1, nullptr);
+    stats.results[result > 0.75 ? 2 : result > 0.25 ? 1 : 0]++;
+}
+
+void textStats(const MappedFile& file, std::vector<Stats>& threadStats)
+{
+    const char* data = reinterpret_cast<const char*>(file.data());
+    const char* fileEnd = data + file.size();
+    parallelFor(static_cast<u32>(threadStats.size()), file.size(),
+        [&](u32 threadIdx, usize begin, usize end)
+        {
+            // each thread takes the lines that start in its range
+            const char* lineBegin = data + begin;
+            if (begin != 0)
+            {
+                lineBegin = std::find(lineBegin - 1, fileEnd, '\n');
+                if (lineBegin != fileEnd)
+                    lineBegin++;
+            }
+            while (lineBegin < data + end)
+            {
+                const char* lineEnd = std::find(lineBegin, fileEnd, '\n');
+                addLine(threadStats[threadIdx], lineBegin, lineEnd);
+                lineBegin = lineEnd == fileEnd ? fileEnd : lineEnd + 1;
+            }
+        });
+}
+
+void marlinformatStats(const MappedFile& file, std::vector<Stats>& threadStats)
+{
+    const auto* records = reinterpret_cast<const marlinformat::PackedBoard*>(file.data());
+    parallelFor(static_cast<u32>(threadStats.size()),
+        file.size() / sizeof(marlinformat::PackedBoard),
+        [&](u32 threadIdx, usize begin, usize end)
+        {
+            auto& stats = threadStats[threadIdx];
+            for (usize i = begin; i < end; i++)
+            {
+                addPackedPosition(stats, records[i].occ, records[i].pieces.data);
+                stats.addScore(records[i].score);
+                stats.results[static_cast<i32>(records[i].wdl)]++;
+            }
+        });
+}
+
+void bulletformatStats(const MappedFile& file, std::vector<Stats>& threadStats)
+{
+    const auto* records = reinterpret_cast<const bulletformat::ChessBoard*>(file.data());
+    parallelFor(static_cast<u32>(threadStats.size()),
+        file.size() / sizeof(bulletformat::ChessBoard),
+        [&](u32 threadIdx, usize begin, usize end)
+        {
+            auto& stats = threadStats[threadIdx];
+            for (usize i = begin; i < end; i++)
             {
-                case 'p':
-                case 'P':
-                    pawnCount++;
-                    break;
-                case 'n':
-                case 'N':
-                case 'b':
-                case 'B':
-                    phase++;
-                    break;
-                case 'r':
-                case 'R':
-                    phase += 2;
-                    break;
-                case 'q':
-                case 'Q':
-                    phase += 4;
-                    break;
+                addPackedPosition(stats, records[i].occ, records[i].pieces);
+                stats.addScore(records[i].score);
+                stats.results[std::min<u8>(records[i].result, 2)]++;
             }
+        });
+}
+
+Ending gameEnding(const Board& board, const viriformat::GameView& game, marlinformat::WDL wdl)
+{
+    GameResult result = gameResult(board);
+    if (result == GameResult::MATED)
+        return Ending::CHECKMATE;
+    if (result == GameResult::DRAW)
+        return Ending::DRAW_BY_RULE;
+
+    // the adjudication rules in runGame, applied to the last scores of the game
+    auto lastScoresAll = [&](i32 plies, auto pred)
+    {
+        if (game.moveCount() < static_cast<usize>(plies))
+            return false;
+        for (usize i = game.moveCount() - plies; i < game.moveCount(); i++)
+            if (!pred(game.move(i).second))
+                return false;
+        return true;
+    };
+
+    if (wdl == marlinformat::WDL::WHITE_WIN
+        && lastScoresAll(WIN_ADJ_PLIES, [](i32 score) { return score >= WIN_ADJ_THRESHOLD; }))
+        return Ending::WIN_ADJUDICATION;
+    if (wdl == marlinformat::WDL::BLACK_WIN
+        && lastScoresAll(WIN_ADJ_PLIES, [](i32 score) { return score <= -WIN_ADJ_THRESHOLD; }))
+        return Ending::WIN_ADJUDICATION;
+    if (wdl == marlinformat::WDL::DRAW
+        && game.moveCount() >= static_cast<usize>(DRAW_ADJ_MOVE_NUM * 2 + DRAW_ADJ_PLIES - 1)
+        && lastScoresAll(
+            DRAW_ADJ_PLIES, [](i32 score) { return std::abs(score) < DRAW_ADJ_THRESHOLD; }))
+        return Ending::DRAW_ADJUDICATION;
+    if (wdl != marlinformat::WDL::DRAW)
+        return Ending::MATE_SCORE;
+    return Ending::OTHER;
+}
+
+void viriformatStats(const viriformat::Archive& archive, std::vector<Stats>& threadStats)
+{
+    archive.parallelForEach(static_cast<u32>(threadStats.size()), 0, archive.gameCount(),
+        [&](u32 threadIdx, usize, const viriformat::GameView& game)
+        {
+            auto& stats = threadStats[threadIdx];
+            auto [board, startScore, wdl] = marlinformat::unpackBoard(game.startpos());
+            for (usize i = 0; i < game.moveCount(); i++)
+            {
+                auto [viriMove, score] = game.move(i);
+                stats.addPosition(boardPhase(board), board.allPieces().popcount(),
+                    board.pieces(PieceType::PAWN).popcount());
+                stats.addScore(score);
+                stats.results[static_cast<i32>(wdl)]++;
+                board.makeMove(viriMove.toMove());
+            }
+
+            stats.games++;
+            stats.gameLengths[std::min<usize>(
+                game.moveCount() / LENGTH_BUCKET_SIZE, LENGTH_BUCKETS - 1)]++;
+            stats.gameResults[static_cast<i32>(wdl)]++;
+            stats.endings[static_cast<i32>(gameEnding(board, game, wdl))]++;
+        });
+}
+
+struct Distribution
+{
+    std::string name;
+    std::vector<std::string> labels;
+    std::vector<u64> counts;
+};
+
+template<usize N>
+Distribution makeDistribution(
+    const std::string& name, const std::array<u64, N>& counts, auto labelFunc)
+{
+    Distribution result = {name, {}, {counts.begin(), counts.end()}};
+    for (usize i = 0; i < N; i++)
+        result.labels.push_back(labelFunc(i));
+    return result;
+}
+
+std::vector<Distribution> distributions(const Stats& stats, StatsFormat format)
+{
+    auto indexLabel = [](usize i) { return std::to_string(i); };
+    auto scoreLabel = [](usize i)
+    {
+        if (i == 0)
+            return "< " + std::to_string(-SCORE_LIMIT);
+        if (i == SCORE_BUCKETS - 1)
+            return ">= " + std::to_string(SCORE_LIMIT);
+        i32 low = static_cast<i32>(i - 1) * SCORE_BUCKET_SIZE - SCORE_LIMIT;
+        return std::to_string(low) + ".." + std::to_string(low + SCORE_BUCKET_SIZE - 1);
+    };
+    // bulletformat scores and results are relative to the side to move
+    bool stmRelative = format == StatsFormat::BULLETFORMAT;
+    auto resultLabel = [&](usize i)
+    {
+        constexpr std::array<const char*, 3> WHITE_LABELS = {"black win", "draw", "white win"};
+        constexpr std::array<const char*, 3> STM_LABELS = {"loss", "draw", "win"};
+        return std::string(stmRelative ? STM_LABELS[i] : WHITE_LABELS[i]);
+    };
+
+    std::vector<Distribution> result = {
+        makeDistribution("phase", stats.phases, indexLabel),
+        makeDistribution("pieces", stats.pieces, indexLabel),
+        makeDistribution("pawns", stats.pawns, indexLabel),
+        makeDistribution(stmRelative ? "score (stm)" : "score (white)", stats.scores, scoreLabel),
+        makeDistribution(stmRelative ? "result (stm)" : "result", stats.results, resultLabel)};
+
+    if (format == StatsFormat::VIRIFORMAT)
+    {
+        auto lengthLabel = [](usize i)
+        {
+            if (i == LENGTH_BUCKETS - 1)
+                return std::to_string(i * LENGTH_BUCKET_SIZE) + "+";
+            return std::to_string(i * LENGTH_BUCKET_SIZE) + ".."
+                + std::to_string((i + 1) * LENGTH_BUCKET_SIZE - 1);
+        };
+        auto endingLabel = [](usize i)
+        {
+            constexpr std::array<const char*, ENDING_COUNT> LABELS = {"checkmate",
+                "draw by rule", "mate score", "win adjudication", "draw adjudication", "other"};
+            return std::string(LABELS[i]);
+        };
+        result.push_back(makeDistribution("game length (plies)", stats.gameLengths, lengthLabel));
+        result.push_back(makeDistribution("game result", stats.gameResults, resultLabel));
+        result.push_back(makeDistribution("game ending", stats.endings, endingLabel));
+    }
+    return result;
+}
+
+void printTables(const std::vector<Distribution>& dists)
+{
+    for (const auto& dist : dists)
+    {
+        u64 total = 0;
+        for (u64 count : dist.counts)
+            total += count;
+
+        char row[96];
+        std::snprintf(row, sizeof(row), "%-20s %12s %8s", dist.name.c_str(), "count", "percent");
+        std::cout << '\n' << row << std::endl;
+        for (usize i = 0; i < dist.counts.size(); i++)
+        {
+            f64 percent = total == 0
+                ? 0.0
+                : 100.0 * static_cast<f64>(dist.counts[i]) / static_cast<f64>(total);
+            std::snprintf(row, sizeof(row), "%-20s %12llu %7.2f%%", dist.labels[i].c_str(),
+                static_cast<unsigned long long>(dist.counts[i]), percent);
+            std::cout << row << std::endl;
         }
-        pieceCounts[pieceCount]++;
-        phaseCounts[phase]++;
-        pawnCounts[pawnCount]++;
-        pawnPhaseCounts[phase][pawnCount]++;
     }
+}
 
-    for (i32 i = 0; i <= 32; i++)
-        std::cout << pieceCounts[i] << std::endl;
+void printJson(const Stats& stats, const std::vector<Distribution>& dists, f64 seconds)
+{
+    std::cout << "{\n  \"positions\": " << stats.positions << ",\n  \"games\": " << stats.games
+              << ",\n  \"seconds\": " << seconds << ",\n  \"distributions\": {";
+    for (usize i = 0; i < dists.size(); i++)
+    {
+        std::cout << (i == 0 ? "\n" : ",\n") << "    \"" << dists[i].name << "\": {";
+        for (usize j = 0; j < dists[i].counts.size(); j++)
+            std::cout << (j == 0 ? "" : ", ") << '"' << dists[i].labels[j]
+                      << "\": " << dists[i].counts[j];
+        std::cout << "}";
+    }
+    std::cout << "\n  }\n}" << std::endl;
+}
 
-    for (i32 i = 0; i <= 24; i++)
-        std::cout << phaseCounts[i] << std::endl;
+}
 
-    for (i32 i = 0; i <= 16; i++)
-        std::cout << pawnCounts[i] << std::endl;
+void computeStats(const StatsConfig& config)
+{
+    std::vector<Stats> threadStats(config.numThreads);
+    auto startTime = std::chrono::steady_clock::now();
+    usize bytes = 0;
+
+    if (config.format == StatsFormat::VIRIFORMAT)
+    {
+        viriformat::Archive archive;
+        if (!archive.open(config.dataFilename))
+        {
+            std::cout << "Could not open file " << config.dataFilename << std::endl;
+            return;
+        }
+        viriformatStats(archive, threadStats);
+        bytes = archive.sizeBytes();
+    }
+    else
+    {
+        MappedFile file;
+        if (!file.open(config.dataFilename))
+        {
+            std::cout << "Could not open file " << config.dataFilename << std::endl;
+            return;
+        }
+        file.adviseSequential();
+        if (config.format == StatsFormat::MARLINFORMAT)
+            marlinformatStats(file, threadStats);
+        else if (config.format == StatsFormat::BULLETFORMAT)
+            bulletformatStats(file, threadStats);
+        else
+            textStats(file, threadStats);
+        bytes = file.size();
+    }
+
+    Stats stats;
+    for (const auto& s : threadStats)
+        stats.add(s);
+
+    auto endTime = std::chrono::steady_clock::now();
+    f64 seconds = std::chrono::duration<f64>(endTime - startTime).count();
+    auto dists = distributions(stats, config.format);
+    if (config.json)
+    {
+        printJson(stats, dists, seconds);
+        return;
+    }
 
-    for (i32 i = 0; i <= 24; i++)
-        for (i32 j = 0; j <= 16; j++)
-            std::cout << pawnPhaseCounts[i][j] << std::endl;
+    std::cout << "Read " << stats.positions << " positions";
+    if (config.format == StatsFormat::VIRIFORMAT)
+        std::cout << " in " << stats.games << " games";
+    std::cout << " from " << config.dataFilename << " in " << seconds << "s, "
+              << static_cast<f64>(bytes) / (1024.0 * 1024.0) / seconds << " MB/s" << std::endl;
+    printTables(dists);
 }
 
 }
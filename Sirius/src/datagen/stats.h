@@ -3,9 +3,31 @@
 #include <cstdint>
 #include <string>
 
+#include "../defs.h"
+
 namespace datagen
 {
 
-void computeStats(std::string fensFile);
+enum class StatsFormat
+{
+    // "<fen> | <score>cp | <result>" lines, or just fens
+    TEXT,
+    VIRIFORMAT,
+    MARLINFORMAT,
+    BULLETFORMAT
+};
+
+struct StatsConfig
+{
+    std::string dataFilename;
+    StatsFormat format;
+    u32 numThreads;
+    // print the distributions as json instead of tables
+    bool json;
+};
+
+// maps a dataset and counts its positions by phase, piece count, pawn count, score and result
+// on numThreads threads, and for viriformat also its games by length and how they ended
+void computeStats(const StatsConfig& config);
 
 }
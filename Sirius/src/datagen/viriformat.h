@@ -11,6 +11,8 @@ struct ViriMove
     explicit ViriMove(Move move);
     Move toMove() const;
 
+    bool operator==(const ViriMove& other) const = default;
+
 private:
     u16 m_Data;
 };
@@ -0,0 +1,72 @@
+#include "writer.h"
+
+namespace datagen
+{
+
+DataWriter::DataWriter(const std::string& filename, u64 shardSize)
+    : m_Filename(filename), m_ShardSize(shardSize), m_RecordCount(0), m_ShardRecords(0),
+      m_ShardCount(0)
+{
+    m_Buffer.reserve(BUFFER_SIZE);
+    if (m_ShardSize == 0)
+        m_File.open(m_Filename, std::ios::binary | std::ios::app);
+    else
+        openShard();
+}
+
+DataWriter::~DataWriter()
+{
+    flush();
+}
+
+bool DataWriter::isOpen() const
+{
+    return m_File.is_open();
+}
+
+void DataWriter::write(const void* record, usize size)
+{
+    if (m_ShardSize != 0 && m_ShardRecords == m_ShardSize)
+        openShard();
+
+    if (m_Buffer.size() + size > BUFFER_SIZE)
+    {
+        m_File.write(m_Buffer.data(), static_cast<std::streamsize>(m_Buffer.size()));
+        m_Buffer.clear();
+    }
+
+    const char* bytes = static_cast<const char*>(record);
+    m_Buffer.insert(m_Buffer.end(), bytes, bytes + size);
+    m_RecordCount++;
+    m_ShardRecords++;
+}
+
+void DataWriter::flush()
+{
+    m_File.write(m_Buffer.data(), static_cast<std::streamsize>(m_Buffer.size()));
+    m_Buffer.clear();
+    m_File.flush();
+}
+
+u64 DataWriter::recordCount() const
+{
+    return m_RecordCount;
+}
+
+u32 DataWriter::shardCount() const
+{
+    return m_ShardSize == 0 ? 1 : m_ShardCount;
+}
+
+void DataWriter::openShard()
+{
+    if (m_File.is_open())
+    {
+        flush();
+        m_File.close();
+    }
+    m_File.open(m_Filename + "." + std::to_string(m_ShardCount++), std::ios::binary);
+    m_ShardRecords = 0;
+}
+
+}
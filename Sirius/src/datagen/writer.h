@@ -0,0 +1,44 @@
+#pragma once
+
+#include "../defs.h"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace datagen
+{
+
+// writes records through a large buffer, and if shardSize is not 0, starts a new
+// file every shardSize records, named <filename>.0, <filename>.1 and so on
+class DataWriter
+{
+public:
+    DataWriter(const std::string& filename, u64 shardSize);
+    ~DataWriter();
+
+    DataWriter(const DataWriter&) = delete;
+    DataWriter& operator=(const DataWriter&) = delete;
+
+    bool isOpen() const;
+    void write(const void* record, usize size);
+    void flush();
+
+    u64 recordCount() const;
+    u32 shardCount() const;
+
+private:
+    static constexpr usize BUFFER_SIZE = 1 << 22;
+
+    void openShard();
+
+    std::string m_Filename;
+    u64 m_ShardSize;
+    std::ofstream m_File;
+    std::vector<char> m_Buffer;
+    u64 m_RecordCount;
+    u64 m_ShardRecords;
+    u32 m_ShardCount;
+};
+
+}
@@ -25,7 +25,12 @@ constexpr auto initPsqt()
     return combined;
 }
 
+#ifdef RUNTIME_EVAL_WEIGHTS
+// rebuilt by loadEvalWeights
+inline auto combinedPsqt = initPsqt();
+#else
 constexpr auto combinedPsqt = initPsqt();
+#endif
 
 inline ScorePair combinedPsqtScore(i32 bucket, Color color, PieceType piece, Square square)
 {
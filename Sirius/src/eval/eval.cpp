@@ -2,6 +2,8 @@
 #include "../attacks.h"
 #include "../util/enum_array.h"
 #include "endgame.h"
+#include "eval_trace.h"
+#include "nnue.h"
 #include "pawn_structure.h"
 
 namespace eval
@@ -30,7 +32,7 @@ using enum PieceType;
 using enum Color;
 
 template<Color us, PieceType piece>
-ScorePair evaluatePieces(const Board& board, EvalData& evalData)
+ScorePair evaluatePieces(const Board& board, EvalData& evalData, const EvalState& evalState)
 {
     constexpr Color them = ~us;
     constexpr Bitboard CENTER_SQUARES = (RANK_4_BB | RANK_5_BB) & (FILE_D_BB | FILE_E_BB);
@@ -38,101 +40,121 @@ ScorePair evaluatePieces(const Board& board, EvalData& evalData)
     ScorePair eval = ScorePair(0, 0);
     Bitboard pieces = board.pieces(us, piece);
     if (piece == BISHOP && pieces.multiple())
+    {
         eval += BISHOP_PAIR;
-
-    Bitboard occupancy = board.allPieces();
-    if (piece == BISHOP)
-        occupancy ^= board.pieces(us, BISHOP) | board.pieces(us, QUEEN);
-    else if (piece == ROOK)
-        occupancy ^= board.pieces(us, ROOK) | board.pieces(us, QUEEN);
-    else if (piece == QUEEN)
-        occupancy ^= board.pieces(us, BISHOP) | board.pieces(us, ROOK);
+        TRACE_ADD(BISHOP_PAIR, us, 1);
+    }
 
     while (pieces.any())
     {
         Square sq = pieces.poplsb();
-        Bitboard attacks = attacks::pieceAttacks<piece>(sq, occupancy);
+        Bitboard attacks = evalState.pieceAttacks(sq);
         if (board.checkBlockers(us).has(sq))
             attacks &= attacks::inBetweenSquares(sq, board.kingSq(us));
 
         evalData.addAttacks(us, piece, attacks);
 
-        eval += MOBILITY[static_cast<i32>(piece) - static_cast<i32>(KNIGHT)]
-                        [(attacks & evalData.mobilityArea[us]).popcount()];
+        i32 mobility = (attacks & evalData.mobilityArea[us]).popcount();
+        eval += MOBILITY[static_cast<i32>(piece) - static_cast<i32>(KNIGHT)][mobility];
+        TRACE_ADD(MOBILITY, us, 1, static_cast<i32>(piece) - static_cast<i32>(KNIGHT), mobility);
 
         if (Bitboard kingRingAtks = evalData.kingRing[them] & attacks; kingRingAtks.any())
         {
             evalData.attackWeight[us] +=
                 KING_ATTACKER_WEIGHT[static_cast<i32>(piece) - static_cast<i32>(KNIGHT)];
             evalData.attackCount[us] += kingRingAtks.popcount();
+            TRACE_ADD(
+                KING_ATTACKER_WEIGHT, us, 1, static_cast<i32>(piece) - static_cast<i32>(KNIGHT));
         }
 
         if (piece == BISHOP && (attacks & CENTER_SQUARES).multiple())
+        {
             eval += LONG_DIAG_BISHOP;
+            TRACE_ADD(LONG_DIAG_BISHOP, us, 1);
+        }
     }
 
     return eval;
 }
 
-template<Color us>
-ScorePair evaluateThreats(const Board& board, const EvalData& evalData)
+// squares where color's pieces are defended against the other color
+Bitboard defendedSquares(const EvalData& evalData, Color color)
 {
-    constexpr Color them = ~us;
+    return evalData.attackedBy2[color] | evalData.attackedBy[color][PAWN]
+        | (evalData.attacked[color] & ~evalData.attackedBy2[~color]);
+}
 
-    ScorePair eval = ScorePair(0, 0);
+// adds table[defended][threatened] for each victim attacked by attacks
+// tableIndex is the ParamIndex of table, for tracing
+template<Color us>
+inline ScorePair threatsBy(Bitboard attacks, Bitboard victims, Bitboard defended,
+    const ScorePair (&table)[2][6], u32 tableIndex, i32 threatened)
+{
+    Bitboard threats = attacks & victims;
+    if (threats.empty())
+        return ScorePair(0, 0);
+    u32 defendedCount = (threats & defended).popcount();
+    TRACE_ADD_INDEX(tableIndex + paramOffset(table, 0, threatened), us,
+        threats.popcount() - defendedCount);
+    TRACE_ADD_INDEX(tableIndex + paramOffset(table, 1, threatened), us, defendedCount);
+    return table[0][threatened] * (threats.popcount() - defendedCount)
+        + table[1][threatened] * defendedCount;
+}
 
-    Bitboard defendedBB = evalData.attackedBy2[them] | evalData.attackedBy[them][PAWN]
-        | (evalData.attacked[them] & ~evalData.attackedBy2[us]);
+template<Color us>
+ScorePair threatsOnPieceType(
+    const EvalData& evalData, PieceType threatened, Bitboard victims, Bitboard defended)
+{
+    const auto& attackedBy = evalData.attackedBy[us];
+    i32 idx = static_cast<i32>(threatened);
+
+    ScorePair eval = THREAT_BY_PAWN[idx] * (attackedBy[PAWN] & victims).popcount()
+        + THREAT_BY_KING[idx] * (attackedBy[KING] & victims & ~defended).popcount();
+    TRACE_ADD(THREAT_BY_PAWN, us, (attackedBy[PAWN] & victims).popcount(), idx);
+    TRACE_ADD(THREAT_BY_KING, us, (attackedBy[KING] & victims & ~defended).popcount(), idx);
+
+    eval += threatsBy<us>(
+        attackedBy[KNIGHT], victims, defended, THREAT_BY_KNIGHT, THREAT_BY_KNIGHT_INDEX, idx);
+    eval += threatsBy<us>(
+        attackedBy[BISHOP], victims, defended, THREAT_BY_BISHOP, THREAT_BY_BISHOP_INDEX, idx);
+    eval += threatsBy<us>(
+        attackedBy[ROOK], victims, defended, THREAT_BY_ROOK, THREAT_BY_ROOK_INDEX, idx);
+    if (threatened != KING)
+        eval += threatsBy<us>(
+            attackedBy[QUEEN], victims, defended, THREAT_BY_QUEEN, THREAT_BY_QUEEN_INDEX, idx);
 
-    Bitboard pawnThreats = evalData.attackedBy[us][PAWN] & board.pieces(them);
-    while (pawnThreats.any())
-    {
-        PieceType threatened = getPieceType(board.pieceAt(pawnThreats.poplsb()));
-        eval += THREAT_BY_PAWN[static_cast<i32>(threatened)];
-    }
+    return eval;
+}
 
-    Bitboard knightThreats = evalData.attackedBy[us][KNIGHT] & board.pieces(them);
-    while (knightThreats.any())
-    {
-        Square threat = knightThreats.poplsb();
-        PieceType threatened = getPieceType(board.pieceAt(threat));
-        bool defended = defendedBB.has(threat);
-        eval += THREAT_BY_KNIGHT[defended][static_cast<i32>(threatened)];
-    }
+// instead of looking up each threatened piece, the attacks of each piece type
+// are intersected with each enemy piece type and counted, for both colors at once
+ScorePair evaluatePieceThreats(const Board& board, const EvalData& evalData)
+{
+    ColorArray<Bitboard> defended = {
+        defendedSquares(evalData, WHITE), defendedSquares(evalData, BLACK)};
 
-    Bitboard bishopThreats = evalData.attackedBy[us][BISHOP] & board.pieces(them);
-    while (bishopThreats.any())
+    ScorePair eval = ScorePair(0, 0);
+    for (PieceType threatened : {PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING})
     {
-        Square threat = bishopThreats.poplsb();
-        PieceType threatened = getPieceType(board.pieceAt(threat));
-        bool defended = defendedBB.has(threat);
-        eval += THREAT_BY_BISHOP[defended][static_cast<i32>(threatened)];
+        // most piece types are not attacked at all, so skip the counting for them
+        Bitboard whiteVictims = board.pieces(BLACK, threatened) & evalData.attacked[WHITE];
+        Bitboard blackVictims = board.pieces(WHITE, threatened) & evalData.attacked[BLACK];
+        if (whiteVictims.any())
+            eval += threatsOnPieceType<WHITE>(evalData, threatened, whiteVictims, defended[BLACK]);
+        if (blackVictims.any())
+            eval -= threatsOnPieceType<BLACK>(evalData, threatened, blackVictims, defended[WHITE]);
     }
+    return eval;
+}
 
-    Bitboard rookThreats = evalData.attackedBy[us][ROOK] & board.pieces(them);
-    while (rookThreats.any())
-    {
-        Square threat = rookThreats.poplsb();
-        PieceType threatened = getPieceType(board.pieceAt(threat));
-        bool defended = defendedBB.has(threat);
-        eval += THREAT_BY_ROOK[defended][static_cast<i32>(threatened)];
-    }
+template<Color us>
+ScorePair evaluateThreats(const Board& board, const EvalData& evalData)
+{
+    constexpr Color them = ~us;
 
-    Bitboard queenThreats = evalData.attackedBy[us][QUEEN] & board.pieces(them) & ~board.pieces(KING);
-    while (queenThreats.any())
-    {
-        Square threat = queenThreats.poplsb();
-        PieceType threatened = getPieceType(board.pieceAt(threat));
-        bool defended = defendedBB.has(threat);
-        eval += THREAT_BY_QUEEN[defended][static_cast<i32>(threatened)];
-    }
+    ScorePair eval = ScorePair(0, 0);
 
-    Bitboard kingThreats = evalData.attackedBy[us][KING] & board.pieces(them) & ~defendedBB;
-    while (kingThreats.any())
-    {
-        PieceType threatened = getPieceType(board.pieceAt(kingThreats.poplsb()));
-        eval += THREAT_BY_KING[static_cast<i32>(threatened)];
-    }
+    Bitboard defendedBB = defendedSquares(evalData, them);
 
     Bitboard nonPawnEnemies = board.pieces(them) & ~board.pieces(PAWN);
 
@@ -143,10 +165,12 @@ ScorePair evaluateThreats(const Board& board, const EvalData& evalData)
 
     Bitboard pushThreats = attacks::pawnAttacks<us>(pushes & safe) & nonPawnEnemies;
     eval += PUSH_THREAT * pushThreats.popcount();
+    TRACE_ADD(PUSH_THREAT, us, pushThreats.popcount());
 
     Bitboard restriction =
         evalData.attackedBy2[us] & ~evalData.attackedBy2[them] & evalData.attacked[them];
     eval += RESTRICTED_SQUARES * restriction.popcount();
+    TRACE_ADD(RESTRICTED_SQUARES, us, restriction.popcount());
 
     Bitboard oppQueens = board.pieces(them, PieceType::QUEEN);
     if (oppQueens.one())
@@ -160,12 +184,18 @@ ScorePair evaluateThreats(const Board& board, const EvalData& evalData)
 
         eval += KNIGHT_HIT_QUEEN
             * (targets & knightHits & evalData.attackedBy[us][PieceType::KNIGHT]).popcount();
+        TRACE_ADD(KNIGHT_HIT_QUEEN, us,
+            (targets & knightHits & evalData.attackedBy[us][PieceType::KNIGHT]).popcount());
 
         targets &= evalData.attackedBy2[us];
         eval += BISHOP_HIT_QUEEN
             * (targets & bishopHits & evalData.attackedBy[us][PieceType::BISHOP]).popcount();
         eval += ROOK_HIT_QUEEN
             * (targets & rookHits & evalData.attackedBy[us][PieceType::ROOK]).popcount();
+        TRACE_ADD(BISHOP_HIT_QUEEN, us,
+            (targets & bishopHits & evalData.attackedBy[us][PieceType::BISHOP]).popcount());
+        TRACE_ADD(ROOK_HIT_QUEEN, us,
+            (targets & rookHits & evalData.attackedBy[us][PieceType::ROOK]).popcount());
     }
 
     return eval;
@@ -203,23 +233,34 @@ ScorePair evaluateKings(const Board& board, const EvalData& evalData, const Eval
     eval += SAFE_BISHOP_CHECK * (bishopChecks & safe).popcount();
     eval += SAFE_ROOK_CHECK * (rookChecks & safe).popcount();
     eval += SAFE_QUEEN_CHECK * (queenChecks & safe).popcount();
+    TRACE_ADD(SAFE_KNIGHT_CHECK, us, (knightChecks & safe).popcount());
+    TRACE_ADD(SAFE_BISHOP_CHECK, us, (bishopChecks & safe).popcount());
+    TRACE_ADD(SAFE_ROOK_CHECK, us, (rookChecks & safe).popcount());
+    TRACE_ADD(SAFE_QUEEN_CHECK, us, (queenChecks & safe).popcount());
 
     eval += UNSAFE_KNIGHT_CHECK * (knightChecks & ~safe).popcount();
     eval += UNSAFE_BISHOP_CHECK * (bishopChecks & ~safe).popcount();
     eval += UNSAFE_ROOK_CHECK * (rookChecks & ~safe).popcount();
     eval += UNSAFE_QUEEN_CHECK * (queenChecks & ~safe).popcount();
+    TRACE_ADD(UNSAFE_KNIGHT_CHECK, us, (knightChecks & ~safe).popcount());
+    TRACE_ADD(UNSAFE_BISHOP_CHECK, us, (bishopChecks & ~safe).popcount());
+    TRACE_ADD(UNSAFE_ROOK_CHECK, us, (rookChecks & ~safe).popcount());
+    TRACE_ADD(UNSAFE_QUEEN_CHECK, us, (queenChecks & ~safe).popcount());
 
     bool queenless = board.pieces(us, PieceType::QUEEN).empty();
     eval += QUEENLESS_ATTACK * queenless;
+    TRACE_ADD(QUEENLESS_ATTACK, us, queenless);
 
     eval += evalData.attackWeight[us];
 
     i32 attackCount = evalData.attackCount[us];
     eval += KING_ATTACKS * attackCount;
+    TRACE_ADD(KING_ATTACKS, us, attackCount);
 
     Bitboard weakKingRing = (evalData.kingRing[them] & weak);
     i32 weakSquares = weakKingRing.popcount();
     eval += WEAK_KING_RING * weakSquares;
+    TRACE_ADD(WEAK_KING_RING, us, weakSquares);
 
     Bitboard flankAttacks = evalData.kingFlank[them] & evalData.attacked[us];
     Bitboard flankAttacks2 = evalData.kingFlank[them] & evalData.attackedBy2[us];
@@ -230,6 +271,10 @@ ScorePair evaluateKings(const Board& board, const EvalData& evalData, const Eval
         + flankAttacks2.popcount() * KING_FLANK_ATTACKS[1];
     eval += flankDefenses.popcount() * KING_FLANK_DEFENSES[0]
         + flankDefenses2.popcount() * KING_FLANK_DEFENSES[1];
+    TRACE_ADD(KING_FLANK_ATTACKS, us, flankAttacks.popcount(), 0);
+    TRACE_ADD(KING_FLANK_ATTACKS, us, flankAttacks2.popcount(), 1);
+    TRACE_ADD(KING_FLANK_DEFENSES, us, flankDefenses.popcount(), 0);
+    TRACE_ADD(KING_FLANK_DEFENSES, us, flankDefenses2.popcount(), 1);
 
     Bitboard checkBlockers = board.checkBlockers(them);
     while (checkBlockers.any())
@@ -249,6 +294,8 @@ ScorePair evaluateKings(const Board& board, const EvalData& evalData, const Eval
 
             eval += SAFETY_PINNED[static_cast<i32>(pieceType)]
                                  [static_cast<i32>(pinnerPiece) - static_cast<i32>(BISHOP)];
+            TRACE_ADD(SAFETY_PINNED, us, 1, static_cast<i32>(pieceType),
+                static_cast<i32>(pinnerPiece) - static_cast<i32>(BISHOP));
         }
         // discovered
         else
@@ -258,10 +305,13 @@ ScorePair evaluateKings(const Board& board, const EvalData& evalData, const Eval
 
             eval += SAFETY_DISCOVERED[static_cast<i32>(pieceType)]
                                      [static_cast<i32>(discovererPiece) - static_cast<i32>(BISHOP)];
+            TRACE_ADD(SAFETY_DISCOVERED, us, 1, static_cast<i32>(pieceType),
+                static_cast<i32>(discovererPiece) - static_cast<i32>(BISHOP));
         }
     }
 
     eval += SAFETY_OFFSET;
+    TRACE_ADD(SAFETY_OFFSET, us, 1);
 
     ScorePair safety{safetyAdjustment(eval.mg()), safetyAdjustment(eval.eg())};
     return safety;
@@ -275,7 +325,18 @@ ScorePair evaluatePassedPawns(
     Square ourKing = board.kingSq(us);
     Square theirKing = board.kingSq(them);
 
-    Bitboard passers = pawnStructure.passedPawns & board.pieces(us);
+    Bitboard passers = pawnStructure.passedPawns & board.pieces(us)
+        & attacks::fillUp<us>(Bitboard::nthRank<us, RANK_4>());
+
+    // push squares of passers, and squares with an enemy rook or queen behind them on the file
+    Bitboard pushSquares = attacks::pawnPushes<us>(passers);
+    Bitboard verticalSliders =
+        board.pieces(them, PieceType::ROOK) | board.pieces(them, PieceType::QUEEN);
+    Bitboard slidersBehind = attacks::pawnPushes<us>(attacks::fillUp<us>(verticalSliders));
+
+    Bitboard blocked = pushSquares & board.allPieces();
+    Bitboard controlled = pushSquares & evalData.attacked[them];
+    Bitboard defendedPush = pushSquares & evalData.attacked[us];
 
     ScorePair eval = ScorePair(0, 0);
 
@@ -283,26 +344,26 @@ ScorePair evaluatePassedPawns(
     {
         Square passer = passers.poplsb();
         i32 rank = passer.relativeRank<us>();
-        if (rank >= RANK_4)
-        {
-            Square pushSq = passer + attacks::pawnPushOffset<us>();
+        Square pushSq = passer + attacks::pawnPushOffset<us>();
 
-            bool blocked = board.pieceAt(pushSq) != Piece::NONE;
-            bool controlled = evalData.attacked[them].has(pushSq);
-            eval += PASSED_PAWN[blocked][controlled][rank];
+        eval += PASSED_PAWN[blocked.has(pushSq)][controlled.has(pushSq)][rank];
+        TRACE_ADD(PASSED_PAWN, us, 1, blocked.has(pushSq), controlled.has(pushSq), rank);
 
-            eval += OUR_PASSER_PROXIMITY[Square::chebyshev(ourKing, pushSq)];
-            eval += THEIR_PASSER_PROXIMITY[Square::chebyshev(theirKing, pushSq)];
+        eval += OUR_PASSER_PROXIMITY[Square::chebyshev(ourKing, pushSq)];
+        eval += THEIR_PASSER_PROXIMITY[Square::chebyshev(theirKing, pushSq)];
+        TRACE_ADD(OUR_PASSER_PROXIMITY, us, 1, Square::chebyshev(ourKing, pushSq));
+        TRACE_ADD(THEIR_PASSER_PROXIMITY, us, 1, Square::chebyshev(theirKing, pushSq));
 
-            if (evalData.attacked[us].has(pushSq))
-                eval += PASSER_DEFENDED_PUSH[rank];
+        if (defendedPush.has(pushSq))
+        {
+            eval += PASSER_DEFENDED_PUSH[rank];
+            TRACE_ADD(PASSER_DEFENDED_PUSH, us, 1, rank);
+        }
 
-            Bitboard squaresBehind =
-                attacks::passedPawnMask(them, passer) & Bitboard::fileBB(passer.file());
-            Bitboard verticalSliders =
-                board.pieces(them, PieceType::ROOK) | board.pieces(them, PieceType::QUEEN);
-            if ((squaresBehind & verticalSliders).any())
-                eval += PASSER_SLIDER_BEHIND[rank];
+        if (slidersBehind.has(passer))
+        {
+            eval += PASSER_SLIDER_BEHIND[rank];
+            TRACE_ADD(PASSER_SLIDER_BEHIND, us, 1, rank);
         }
     }
 
@@ -320,6 +381,10 @@ ScorePair evaluateComplexity(const Board& board, const PawnStructure& pawnStruct
     ScorePair complexity = COMPLEXITY_PAWNS * pawns.popcount()
         + COMPLEXITY_PAWNS_BOTH_SIDES * pawnsBothSides + COMPLEXITY_PAWN_ENDGAME * pawnEndgame
         + COMPLEXITY_OFFSET;
+    TRACE_ADD(COMPLEXITY_PAWNS, WHITE, pawns.popcount());
+    TRACE_ADD(COMPLEXITY_PAWNS_BOTH_SIDES, WHITE, pawnsBothSides);
+    TRACE_ADD(COMPLEXITY_PAWN_ENDGAME, WHITE, pawnEndgame);
+    TRACE_ADD(COMPLEXITY_OFFSET, WHITE, 1);
 
     i32 egSign = (eval.eg() > 0) - (eval.eg() < 0);
 
@@ -382,25 +447,52 @@ void initEvalData(const Board& board, EvalData& evalData, const PawnStructure& p
 void nonIncrementalEval(const Board& board, const EvalState& evalState,
     const PawnStructure& pawnStructure, EvalData& evalData, ScorePair& eval)
 {
-    eval += evaluatePieces<WHITE, KNIGHT>(board, evalData) - evaluatePieces<BLACK, KNIGHT>(board, evalData);
-    eval += evaluatePieces<WHITE, BISHOP>(board, evalData) - evaluatePieces<BLACK, BISHOP>(board, evalData);
-    eval += evaluatePieces<WHITE, ROOK>(board, evalData) - evaluatePieces<BLACK, ROOK>(board, evalData);
-    eval += evaluatePieces<WHITE, QUEEN>(board, evalData) - evaluatePieces<BLACK, QUEEN>(board, evalData);
+    eval += evaluatePieces<WHITE, KNIGHT>(board, evalData, evalState) - evaluatePieces<BLACK, KNIGHT>(board, evalData, evalState);
+    eval += evaluatePieces<WHITE, BISHOP>(board, evalData, evalState) - evaluatePieces<BLACK, BISHOP>(board, evalData, evalState);
+    eval += evaluatePieces<WHITE, ROOK>(board, evalData, evalState) - evaluatePieces<BLACK, ROOK>(board, evalData, evalState);
+    eval += evaluatePieces<WHITE, QUEEN>(board, evalData, evalState) - evaluatePieces<BLACK, QUEEN>(board, evalData, evalState);
 
     eval += evaluateKings<WHITE>(board, evalData, evalState) - evaluateKings<BLACK>(board, evalData, evalState);
     eval += evaluatePassedPawns<WHITE>(board, pawnStructure, evalData) - evaluatePassedPawns<BLACK>(board, pawnStructure, evalData);
+    eval += evaluatePieceThreats(board, evalData);
     eval += evaluateThreats<WHITE>(board, evalData) - evaluateThreats<BLACK>(board, evalData);
     eval += evaluateComplexity(board, pawnStructure, eval);
 }
 // clang-format on
 
+i32 evalPhase(const Board& board)
+{
+    i32 phase = 4 * board.pieces(PieceType::QUEEN).popcount()
+        + 2 * board.pieces(PieceType::ROOK).popcount()
+        + (board.pieces(PieceType::BISHOP) | board.pieces(PieceType::KNIGHT)).popcount();
+    return std::clamp(phase, 0, 24);
+}
+
+// adds tempo and interpolates between middlegame and endgame, from the side to move's perspective
+i32 taperedScore(const Board& board, ScorePair eval, i32 scale)
+{
+    Color color = board.sideToMove();
+    eval += (color == WHITE ? TEMPO : -TEMPO);
+    TRACE_ADD(TEMPO, color, 1);
+
+    i32 mg = eval.mg();
+    i32 eg = eval.eg() * scale / SCALE_FACTOR_NORMAL;
+    i32 phase = evalPhase(board);
+
+    return (color == WHITE ? 1 : -1) * ((mg * phase + eg * (24 - phase)) / 24);
+}
+
 i32 evaluate(const Board& board, search::SearchThread* thread)
 {
+    thread->evalState.materialize(board);
+
+    if (const nnue::Network* network = thread->evalState.network())
+        return nnue::evaluate(*network, thread->evalState.accumulator(), board.sideToMove());
+
     auto endgameEval = endgames::probeEvalFunc(board);
     if (endgameEval != nullptr)
         return (*endgameEval)(board, thread->evalState);
 
-    Color color = board.sideToMove();
     ScorePair eval = thread->evalState.score(board);
 
     const PawnStructure& pawnStructure = thread->evalState.pawnStructure();
@@ -413,16 +505,7 @@ i32 evaluate(const Board& board, search::SearchThread* thread)
 
     i32 scale = evaluateScale(board, eval, thread->evalState, pawnStructure);
 
-    eval += (color == WHITE ? TEMPO : -TEMPO);
-
-    i32 mg = eval.mg();
-    i32 eg = eval.eg() * scale / SCALE_FACTOR_NORMAL;
-    i32 phase = 4 * board.pieces(PieceType::QUEEN).popcount()
-        + 2 * board.pieces(PieceType::ROOK).popcount()
-        + (board.pieces(PieceType::BISHOP) | board.pieces(PieceType::KNIGHT)).popcount();
-    phase = std::clamp(phase, 0, 24);
-
-    return (color == WHITE ? 1 : -1) * ((mg * phase + eg * (24 - phase)) / 24);
+    return taperedScore(board, eval, scale);
 }
 
 i32 evaluateSingle(const Board& board)
@@ -434,7 +517,6 @@ i32 evaluateSingle(const Board& board)
     if (endgame != nullptr)
         return (*endgame)(board, evalState);
 
-    Color color = board.sideToMove();
     ScorePair eval = evalState.score(board);
 
     const PawnStructure& pawnStructure = evalState.pawnStructure();
@@ -447,16 +529,84 @@ i32 evaluateSingle(const Board& board)
 
     i32 scale = evaluateScale(board, eval, evalState, pawnStructure);
 
-    eval += (color == WHITE ? TEMPO : -TEMPO);
+    return taperedScore(board, eval, scale);
+}
 
-    i32 mg = eval.mg();
-    i32 eg = eval.eg() * scale / SCALE_FACTOR_NORMAL;
-    i32 phase = 4 * board.pieces(PieceType::QUEEN).popcount()
-        + 2 * board.pieces(PieceType::ROOK).popcount()
-        + (board.pieces(PieceType::BISHOP) | board.pieces(PieceType::KNIGHT)).popcount();
-    phase = std::clamp(phase, 0, 24);
+i32 evaluateLazy(const Board& board, search::SearchThread* thread, i32 alpha, i32 beta,
+    i32 margin, bool& exact)
+{
+    thread->evalState.materialize(board);
 
-    return (color == WHITE ? 1 : -1) * ((mg * phase + eg * (24 - phase)) / 24);
+    exact = true;
+    if (margin == 0 || thread->evalState.network() || endgames::probeEvalFunc(board) != nullptr)
+        return evaluate(board, thread);
+
+    // the incremental terms are already computed, so if they are far enough outside
+    // the window, skip the mobility, king safety, threat, etc. terms and return them
+    i32 lazyEval = taperedScore(board, thread->evalState.score(board), SCALE_FACTOR_NORMAL);
+    if (lazyEval - margin >= beta || lazyEval + margin <= alpha)
+    {
+        exact = false;
+        return lazyEval;
+    }
+
+    return evaluate(board, thread);
+}
+
+#ifdef EVAL_TUNE
+
+// the incremental material and psqt come from combinedPsqt, so they are traced from the board
+void traceMaterialPsqt(const Board& board)
+{
+    for (Color color : {WHITE, BLACK})
+    {
+        i32 mirror = getKingBucket(board.kingSq(color)) * 0b111;
+        i32 flip = color == WHITE ? 0b111000 : 0;
+        Bitboard pieces = board.pieces(color);
+        while (pieces.any())
+        {
+            Square sq = pieces.poplsb();
+            i32 piece = static_cast<i32>(getPieceType(board.pieceAt(sq)));
+            TRACE_ADD(MATERIAL, color, 1, piece);
+            TRACE_ADD(PSQT, color, 1, piece, sq.value() ^ flip ^ mirror);
+        }
+    }
+}
+
+bool traceEvaluate(const Board& board, EvalTrace& trace)
+{
+    if (endgames::probeEvalFunc(board) != nullptr)
+        return false;
+
+    trace = {};
+    currTrace = &trace;
+
+    thread_local EvalState evalState;
+    evalState.initSingle(board);
+    traceMaterialPsqt(board);
+
+    ScorePair eval = evalState.score(board);
+
+    const PawnStructure& pawnStructure = evalState.pawnStructure();
+
+    EvalData evalData = {};
+    initEvalData<WHITE>(board, evalData, pawnStructure);
+    initEvalData<BLACK>(board, evalData, pawnStructure);
+
+    nonIncrementalEval(board, evalState, pawnStructure, evalData, eval);
+
+    i32 scale = evaluateScale(board, eval, evalState, pawnStructure);
+
+    trace.phase = evalPhase(board);
+    trace.scale = scale;
+    trace.eval = taperedScore(board, eval, scale);
+    if (board.sideToMove() == BLACK)
+        trace.eval = -trace.eval;
+
+    currTrace = nullptr;
+    return true;
 }
 
+#endif
+
 }
@@ -7,7 +7,18 @@ namespace eval
 {
 
 i32 evaluate(const Board& board, search::SearchThread* thread = nullptr);
+// only computes the full eval if the incremental eval is within margin of [alpha, beta],
+// or always if margin is 0. exact is set to false if the incremental eval was returned
+i32 evaluateLazy(const Board& board, search::SearchThread* thread, i32 alpha, i32 beta,
+    i32 margin, bool& exact);
 
 i32 evaluateSingle(const Board& board);
 
+#ifdef EVAL_TUNE
+struct EvalTrace;
+// records how many times each parameter is used into trace, returns false for
+// positions that are evaluated by an endgame function and can't be traced
+bool traceEvaluate(const Board& board, EvalTrace& trace);
+#endif
+
 }
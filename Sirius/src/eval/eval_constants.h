@@ -5,12 +5,19 @@
 namespace eval
 {
 
+#ifdef RUNTIME_EVAL_WEIGHTS
+// can be replaced by loadEvalWeights
+#define EVAL_PARAM inline
+#else
+#define EVAL_PARAM constexpr
+#endif
+
 // clang-format off
 #define S(mg, eg) ScorePair(mg, eg)
 
-constexpr ScorePair MATERIAL[6] = {S(  65,  138), S( 305,  450), S( 320,  475), S( 411,  816), S( 844, 1957), S(0, 0)};
+EVAL_PARAM ScorePair MATERIAL[6] = {S(  65,  138), S( 305,  450), S( 320,  475), S( 411,  816), S( 844, 1957), S(0, 0)};
 
-constexpr ScorePair PSQT[6][64] = {
+EVAL_PARAM ScorePair PSQT[6][64] = {
     {
         S(   0,    0), S(   0,    0), S(   0,    0), S(   0,    0), S(   0,    0), S(   0,    0), S(   0,    0), S(   0,    0),
         S(  63,   90), S(   6,  103), S(  21,  108), S(  31,   91), S(  56,   69), S(  39,   68), S(  28,  103), S(  76,   90),
@@ -73,50 +80,50 @@ constexpr ScorePair PSQT[6][64] = {
     },
 };
 
-constexpr ScorePair MOBILITY[4][28] = {
+EVAL_PARAM ScorePair MOBILITY[4][28] = {
     {S( -20, -101), S( -34,  -46), S( -19,   -9), S(  -8,    8), S(   2,   18), S(   8,   28), S(  17,   33), S(  24,   36), S(  34,   27), S(   0,    0), S(   0,    0), S(   0,    0), S(   0,    0), S(   0,    0), S(   0,    0), S(   0,    0), S(   0,    0), S(   0,    0), S(   0,    0), S(   0,    0), S(   0,    0), S(   0,    0), S(   0,    0), S(   0,    0), S(   0,    0), S(   0,    0), S(   0,    0), S(   0,    0)},
     {S( -25, -111), S( -41,  -59), S( -21,  -27), S( -10,   -6), S(  -4,    5), S(   0,   15), S(   2,   22), S(   5,   26), S(   5,   28), S(   9,   29), S(   7,   30), S(  13,   23), S(  18,   23), S(  48,   -8), S(   0,    0), S(   0,    0), S(   0,    0), S(   0,    0), S(   0,    0), S(   0,    0), S(   0,    0), S(   0,    0), S(   0,    0), S(   0,    0), S(   0,    0), S(   0,    0), S(   0,    0), S(   0,    0)},
     {S( -58,  -89), S( -48,  -66), S( -16,  -40), S(  -8,  -23), S(   0,  -12), S(   4,   -2), S(   4,    9), S(   6,   14), S(   7,   17), S(   9,   23), S(  12,   29), S(  13,   35), S(  14,   39), S(  17,   41), S(  44,   21), S(   0,    0), S(   0,    0), S(   0,    0), S(   0,    0), S(   0,    0), S(   0,    0), S(   0,    0), S(   0,    0), S(   0,    0), S(   0,    0), S(   0,    0), S(   0,    0), S(   0,    0)},
     {S( -29,  -65), S( -48,  -72), S( -59,  -67), S( -36, -132), S( -24,  -94), S( -11,  -55), S(  -3,  -39), S(   1,  -20), S(   1,   -2), S(   2,   11), S(   5,   18), S(   5,   28), S(   7,   33), S(   7,   41), S(   9,   45), S(  10,   44), S(   9,   49), S(  10,   49), S(  12,   49), S(  14,   44), S(  17,   41), S(  22,   28), S(  21,   28), S(  31,   12), S(  20,   23), S(  25,    0), S(  21,  -27), S( -23,    4)}
 };
 
-constexpr ScorePair THREAT_BY_PAWN[6] = {S(  -7,  -19), S(  73,   41), S(  65,   72), S(  72,   50), S(  56,   24), S(   0,    0)};
-constexpr ScorePair THREAT_BY_KNIGHT[2][6] = {
+EVAL_PARAM ScorePair THREAT_BY_PAWN[6] = {S(  -7,  -19), S(  73,   41), S(  65,   72), S(  72,   50), S(  56,   24), S(   0,    0)};
+EVAL_PARAM ScorePair THREAT_BY_KNIGHT[2][6] = {
     {S(   5,   37), S(  12,   85), S(  50,   33), S(  86,   13), S(  41,    8), S(   0,    0)},
     {S(  -8,   11), S(   9,   79), S(  38,   29), S(  71,   45), S(  50,   46), S(   0,    0)}
 };
-constexpr ScorePair THREAT_BY_BISHOP[2][6] = {
+EVAL_PARAM ScorePair THREAT_BY_BISHOP[2][6] = {
     {S(   3,   34), S(  36,   44), S(  12,  102), S(  58,   35), S(  61,   53), S(   0,    0)},
     {S(  -5,    4), S(  20,   21), S(   4,   76), S(  56,   60), S(  63,   74), S(   0,    0)}
 };
-constexpr ScorePair THREAT_BY_ROOK[2][6] = {
+EVAL_PARAM ScorePair THREAT_BY_ROOK[2][6] = {
     {S(  -3,   50), S(  35,   52), S(  45,   49), S( -12,   50), S(  67,  -10), S(   0,    0)},
     {S( -10,   10), S(   8,   15), S(  19,    4), S(   1,   22), S(  54,   85), S(   0,    0)}
 };
-constexpr ScorePair THREAT_BY_QUEEN[2][6] = {
+EVAL_PARAM ScorePair THREAT_BY_QUEEN[2][6] = {
     {S(   8,   21), S(  25,   30), S(  18,   65), S(  16,   12), S(  -2,  -17), S(   0,    0)},
     {S(  -5,   16), S(   2,    8), S(  -9,   37), S(  -7,    7), S( -19,    1), S(   0,    0)}
 };
-constexpr ScorePair THREAT_BY_KING[6] = {S(  39,   18), S(  33,   38), S(  99,   33), S(  83,    8), S(   0,    0), S(   0,    0)};
-constexpr ScorePair KNIGHT_HIT_QUEEN = S(   7,    2);
-constexpr ScorePair BISHOP_HIT_QUEEN = S(  16,   15);
-constexpr ScorePair ROOK_HIT_QUEEN = S(  18,    0);
-constexpr ScorePair PUSH_THREAT = S(  13,   17);
-constexpr ScorePair RESTRICTED_SQUARES = S(   2,    3);
-
-constexpr ScorePair ISOLATED_PAWN[4] = {S(  -6,    6), S(  -3,  -10), S(  -8,   -6), S( -10,  -11)};
-constexpr ScorePair ISOLATED_EXPOSED = S(  -6,   -6);
-constexpr ScorePair DOUBLED_PAWN[4] = {S(   1,  -52), S(   5,  -42), S(  -5,  -25), S( -12,   -7)};
-constexpr ScorePair BACKWARDS_PAWN[8] = {S(   0,    0), S(  -3,   -8), S(   4,  -11), S(  -3,  -11), S(  11,  -17), S(   4,   25), S(   0,    0), S(   0,    0)};
-constexpr ScorePair BACKWARDS_EXPOSED = S( -14,   -5);
-constexpr ScorePair PAWN_PHALANX[8] = {S(   0,    0), S(   4,   -5), S(  11,    0), S(  18,   10), S(  40,   34), S(  70,  135), S( 104,  178), S(   0,    0)};
-constexpr ScorePair DEFENDED_PAWN[8] = {S(   0,    0), S(   0,    0), S(  16,    7), S(  10,   10), S(  18,   24), S(  38,   57), S(  71,  119), S(   0,    0)};
-constexpr ScorePair CANDIDATE_PASSER[2][8] = {
+EVAL_PARAM ScorePair THREAT_BY_KING[6] = {S(  39,   18), S(  33,   38), S(  99,   33), S(  83,    8), S(   0,    0), S(   0,    0)};
+EVAL_PARAM ScorePair KNIGHT_HIT_QUEEN = S(   7,    2);
+EVAL_PARAM ScorePair BISHOP_HIT_QUEEN = S(  16,   15);
+EVAL_PARAM ScorePair ROOK_HIT_QUEEN = S(  18,    0);
+EVAL_PARAM ScorePair PUSH_THREAT = S(  13,   17);
+EVAL_PARAM ScorePair RESTRICTED_SQUARES = S(   2,    3);
+
+EVAL_PARAM ScorePair ISOLATED_PAWN[4] = {S(  -6,    6), S(  -3,  -10), S(  -8,   -6), S( -10,  -11)};
+EVAL_PARAM ScorePair ISOLATED_EXPOSED = S(  -6,   -6);
+EVAL_PARAM ScorePair DOUBLED_PAWN[4] = {S(   1,  -52), S(   5,  -42), S(  -5,  -25), S( -12,   -7)};
+EVAL_PARAM ScorePair BACKWARDS_PAWN[8] = {S(   0,    0), S(  -3,   -8), S(   4,  -11), S(  -3,  -11), S(  11,  -17), S(   4,   25), S(   0,    0), S(   0,    0)};
+EVAL_PARAM ScorePair BACKWARDS_EXPOSED = S( -14,   -5);
+EVAL_PARAM ScorePair PAWN_PHALANX[8] = {S(   0,    0), S(   4,   -5), S(  11,    0), S(  18,   10), S(  40,   34), S(  70,  135), S( 104,  178), S(   0,    0)};
+EVAL_PARAM ScorePair DEFENDED_PAWN[8] = {S(   0,    0), S(   0,    0), S(  16,    7), S(  10,   10), S(  18,   24), S(  38,   57), S(  71,  119), S(   0,    0)};
+EVAL_PARAM ScorePair CANDIDATE_PASSER[2][8] = {
     {S(   0,    0), S( -23,  -12), S(  -8,  -14), S(  -3,    1), S(  15,   22), S(  34,   86), S(   0,    0), S(   0,    0)},
     {S(   0,    0), S( -16,  -11), S( -11,    8), S(  -6,   25), S(   7,   37), S(  38,  102), S(   0,    0), S(   0,    0)}
 };
 
-constexpr ScorePair PASSED_PAWN[2][2][8] = {
+EVAL_PARAM ScorePair PASSED_PAWN[2][2][8] = {
     {
         {S(   0,    0), S(   0,    0), S(   0,    0), S( -31,  -30), S( -11,   26), S(  22,  140), S( 115,  229), S(   0,    0)},
         {S(   0,    0), S(   0,    0), S(   0,    0), S( -23,  -43), S(  -3,  -12), S(  23,   61), S(  59,   82), S(   0,    0)}
@@ -126,12 +133,12 @@ constexpr ScorePair PASSED_PAWN[2][2][8] = {
         {S(   0,    0), S(   0,    0), S(   0,    0), S( -26,  -54), S(  -6,  -25), S(   8,   36), S(   3,    7), S(   0,    0)}
     }
 };
-constexpr ScorePair OUR_PASSER_PROXIMITY[8] = {S(  66,  114), S(  86,   82), S(  32,   75), S(  -7,   61), S(  -2,   34), S(   3,   21), S(  18,    9), S(   3,   18)};
-constexpr ScorePair THEIR_PASSER_PROXIMITY[8] = {S( -65,   18), S(   1,    1), S(  26,    1), S(  21,   26), S(  11,   61), S(  14,   77), S(  19,   81), S(  18,   67)};
-constexpr ScorePair PASSER_DEFENDED_PUSH[8] = {S(   0,    0), S(   0,    0), S(   0,    0), S(   9,    5), S(  10,   18), S(  35,   32), S(  60,  100), S(   0,    0)};
-constexpr ScorePair PASSER_SLIDER_BEHIND[8] = {S(   0,    0), S(   0,    0), S(   0,    0), S( -27,  -13), S( -25,  -28), S( -26,  -44), S(   8,  -95), S(   0,    0)};
+EVAL_PARAM ScorePair OUR_PASSER_PROXIMITY[8] = {S(  66,  114), S(  86,   82), S(  32,   75), S(  -7,   61), S(  -2,   34), S(   3,   21), S(  18,    9), S(   3,   18)};
+EVAL_PARAM ScorePair THEIR_PASSER_PROXIMITY[8] = {S( -65,   18), S(   1,    1), S(  26,    1), S(  21,   26), S(  11,   61), S(  14,   77), S(  19,   81), S(  18,   67)};
+EVAL_PARAM ScorePair PASSER_DEFENDED_PUSH[8] = {S(   0,    0), S(   0,    0), S(   0,    0), S(   9,    5), S(  10,   18), S(  35,   32), S(  60,  100), S(   0,    0)};
+EVAL_PARAM ScorePair PASSER_SLIDER_BEHIND[8] = {S(   0,    0), S(   0,    0), S(   0,    0), S( -27,  -13), S( -25,  -28), S( -26,  -44), S(   8,  -95), S(   0,    0)};
 
-constexpr ScorePair PAWN_STORM[2][4][8] = {
+EVAL_PARAM ScorePair PAWN_STORM[2][4][8] = {
     {
         {S(  29,   32), S( -69,  -58), S(   9,  -22), S(  42,   15), S(  20,   26), S(   3,   29), S(  -4,   31), S(   0,    0)},
         {S(  22,   22), S(  72,  -81), S(  80,  -41), S(  33,    5), S(   8,   20), S( -25,   24), S(   1,   23), S(   0,    0)},
@@ -145,34 +152,34 @@ constexpr ScorePair PAWN_STORM[2][4][8] = {
         {S(   0,    0), S(   0,    0), S( 128,    8), S(  13,   17), S( -20,   18), S( -10,   16), S( -13,   -4), S(   0,    0)}
     }
 };
-constexpr ScorePair PAWN_SHIELD[4][8] = {
+EVAL_PARAM ScorePair PAWN_SHIELD[4][8] = {
     {S(  56,   34), S(  -1,   45), S( -13,   37), S(  31,   32), S(  41,   25), S(   7,   21), S( -29,   31), S(   0,    0)},
     {S(  44,   25), S( -28,   29), S(   8,   25), S(  43,   19), S(  43,   10), S(  -1,    7), S( -33,   -7), S(   0,    0)},
     {S(  26,   19), S(   5,   60), S(   5,   15), S(  35,    0), S(  34,    1), S(   5,    3), S( -65,   11), S(   0,    0)},
     {S(  15,   14), S( -25,    6), S(   6,    2), S(  30,   -2), S(  24,   -1), S(  28,    6), S( -32,    9), S(   0,    0)}
 };
-constexpr ScorePair SAFE_KNIGHT_CHECK = S(  98,    1);
-constexpr ScorePair SAFE_BISHOP_CHECK = S(  66,   15);
-constexpr ScorePair SAFE_ROOK_CHECK = S( 104,    8);
-constexpr ScorePair SAFE_QUEEN_CHECK = S(  61,   16);
-constexpr ScorePair UNSAFE_KNIGHT_CHECK = S(  17,    0);
-constexpr ScorePair UNSAFE_BISHOP_CHECK = S(  29,    5);
-constexpr ScorePair UNSAFE_ROOK_CHECK = S(  36,    2);
-constexpr ScorePair UNSAFE_QUEEN_CHECK = S(  18,    3);
-constexpr ScorePair QUEENLESS_ATTACK = S(-119,  331);
-constexpr ScorePair KING_ATTACKER_WEIGHT[4] = {S(  54,   -2), S(  22,   -2), S(  22,   -7), S(   4,   -9)};
-constexpr ScorePair KING_ATTACKS = S(   7,    0);
-constexpr ScorePair WEAK_KING_RING = S(   5,    0);
-constexpr ScorePair KING_FLANK_ATTACKS[2] = {S(  14,   -3), S(   4,    0)};
-constexpr ScorePair KING_FLANK_DEFENSES[2] = {S(  -9,    0), S(  -7,    2)};
-constexpr ScorePair SAFETY_PINNED[5][3] = {
+EVAL_PARAM ScorePair SAFE_KNIGHT_CHECK = S(  98,    1);
+EVAL_PARAM ScorePair SAFE_BISHOP_CHECK = S(  66,   15);
+EVAL_PARAM ScorePair SAFE_ROOK_CHECK = S( 104,    8);
+EVAL_PARAM ScorePair SAFE_QUEEN_CHECK = S(  61,   16);
+EVAL_PARAM ScorePair UNSAFE_KNIGHT_CHECK = S(  17,    0);
+EVAL_PARAM ScorePair UNSAFE_BISHOP_CHECK = S(  29,    5);
+EVAL_PARAM ScorePair UNSAFE_ROOK_CHECK = S(  36,    2);
+EVAL_PARAM ScorePair UNSAFE_QUEEN_CHECK = S(  18,    3);
+EVAL_PARAM ScorePair QUEENLESS_ATTACK = S(-119,  331);
+EVAL_PARAM ScorePair KING_ATTACKER_WEIGHT[4] = {S(  54,   -2), S(  22,   -2), S(  22,   -7), S(   4,   -9)};
+EVAL_PARAM ScorePair KING_ATTACKS = S(   7,    0);
+EVAL_PARAM ScorePair WEAK_KING_RING = S(   5,    0);
+EVAL_PARAM ScorePair KING_FLANK_ATTACKS[2] = {S(  14,   -3), S(   4,    0)};
+EVAL_PARAM ScorePair KING_FLANK_DEFENSES[2] = {S(  -9,    0), S(  -7,    2)};
+EVAL_PARAM ScorePair SAFETY_PINNED[5][3] = {
     {S(  28,    8), S(  13,   -4), S(  18,   -4)},
     {S( -21,  -58), S( -41,  -70), S( -63, -135)},
     {S(-100, -141), S( -38,  -65), S( -45, -185)},
     {S(  40,   92), S( -65, -109), S( -55, -201)},
     {S(  15,  444), S(  78,  324), S( -98, -197)}
 };
-constexpr ScorePair SAFETY_DISCOVERED[6][3] = {
+EVAL_PARAM ScorePair SAFETY_DISCOVERED[6][3] = {
     {S(  38,    3), S(   7,   -3), S(  19,    9)},
     {S( 224,   31), S( 231,   19), S( 170,  126)},
     {S(   0,    0), S( 244,   13), S( 129,   81)},
@@ -180,23 +187,24 @@ constexpr ScorePair SAFETY_DISCOVERED[6][3] = {
     {S(   0,    0), S(   0,    0), S(   0,    0)},
     {S( 206,   20), S( 170,   -8), S(  75,   24)}
 };
-constexpr ScorePair SAFETY_OFFSET = S(  85,  274);
+EVAL_PARAM ScorePair SAFETY_OFFSET = S(  85,  274);
 
-constexpr ScorePair MINOR_BEHIND_PAWN = S(   2,    9);
-constexpr ScorePair KNIGHT_OUTPOST = S(  18,   18);
-constexpr ScorePair BISHOP_PAWNS[7] = {S(  13,    0), S(   6,   11), S(   3,    8), S(   0,    3), S(  -4,   -2), S(  -7,   -9), S( -11,  -17)};
-constexpr ScorePair BISHOP_PAIR = S(  22,   65);
-constexpr ScorePair LONG_DIAG_BISHOP = S(  12,   12);
-constexpr ScorePair ROOK_OPEN[2] = {S(  29,    2), S(  19,   -1)};
+EVAL_PARAM ScorePair MINOR_BEHIND_PAWN = S(   2,    9);
+EVAL_PARAM ScorePair KNIGHT_OUTPOST = S(  18,   18);
+EVAL_PARAM ScorePair BISHOP_PAWNS[7] = {S(  13,    0), S(   6,   11), S(   3,    8), S(   0,    3), S(  -4,   -2), S(  -7,   -9), S( -11,  -17)};
+EVAL_PARAM ScorePair BISHOP_PAIR = S(  22,   65);
+EVAL_PARAM ScorePair LONG_DIAG_BISHOP = S(  12,   12);
+EVAL_PARAM ScorePair ROOK_OPEN[2] = {S(  29,    2), S(  19,   -1)};
 
-constexpr ScorePair TEMPO = S(  28,   20);
+EVAL_PARAM ScorePair TEMPO = S(  28,   20);
 
-constexpr ScorePair COMPLEXITY_PAWNS = S(   0,   10);
-constexpr ScorePair COMPLEXITY_PAWNS_BOTH_SIDES = S(   0,  127);
-constexpr ScorePair COMPLEXITY_PAWN_ENDGAME = S(   0,  123);
-constexpr ScorePair COMPLEXITY_OFFSET = S(   0, -208);
+EVAL_PARAM ScorePair COMPLEXITY_PAWNS = S(   0,   10);
+EVAL_PARAM ScorePair COMPLEXITY_PAWNS_BOTH_SIDES = S(   0,  127);
+EVAL_PARAM ScorePair COMPLEXITY_PAWN_ENDGAME = S(   0,  123);
+EVAL_PARAM ScorePair COMPLEXITY_OFFSET = S(   0, -208);
 
 #undef S
+#undef EVAL_PARAM
 // clang-format on
 
 }
@@ -0,0 +1,133 @@
+#include "eval_params.h"
+#include "../util/murmur.h"
+#include "combined_psqt.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+
+namespace eval
+{
+
+namespace
+{
+
+template<typename T>
+void addDims(std::vector<u32>& dims)
+{
+    if constexpr (std::is_array_v<T>)
+    {
+        dims.push_back(static_cast<u32>(std::extent_v<T>));
+        addDims<std::remove_extent_t<T>>(dims);
+    }
+}
+
+template<typename T>
+ParamInfo makeParamInfo(const char* name, u32 index, const T&)
+{
+    ParamInfo info = {name, index, static_cast<u32>(sizeof(T) / sizeof(ScorePair)), {}};
+    addDims<T>(info.dims);
+    return info;
+}
+
+constexpr u32 WEIGHTS_MAGIC = 0x57524953; // "SIRW"
+
+// changes if any parameter is added, removed, renamed or resized
+u64 layoutHash()
+{
+    u64 hash = PARAM_COUNT;
+    for (const ParamInfo& info : paramInfos())
+    {
+        if (info.name == nullptr)
+            continue;
+        for (const char* c = info.name; *c; c++)
+            hash = murmurHash3(hash ^ static_cast<u8>(*c));
+        hash = murmurHash3(hash ^ info.size);
+    }
+    return hash;
+}
+
+struct WeightsHeader
+{
+    u32 magic;
+    u32 paramCount;
+    u64 layoutHash;
+};
+
+}
+
+const std::vector<ParamInfo>& paramInfos()
+{
+#define EVAL_PARAM_INFO(name) makeParamInfo(#name, name##_INDEX, name),
+#define EVAL_PARAM_SEP() ParamInfo{nullptr, 0, 0, {}},
+    static const std::vector<ParamInfo> infos = {EVAL_PARAMS(EVAL_PARAM_INFO, EVAL_PARAM_SEP)};
+#undef EVAL_PARAM_INFO
+#undef EVAL_PARAM_SEP
+    return infos;
+}
+
+std::array<ScorePair, PARAM_COUNT> currentParams()
+{
+    std::array<ScorePair, PARAM_COUNT> params = {};
+#define EVAL_PARAM_COPY(name) \
+    std::copy_n(reinterpret_cast<const ScorePair*>(&name), sizeof(name) / sizeof(ScorePair), \
+        params.begin() + name##_INDEX);
+    EVAL_PARAMS(EVAL_PARAM_COPY, EVAL_PARAMS_NO_SEP)
+#undef EVAL_PARAM_COPY
+    return params;
+}
+
+// stored as mg and eg i16 pairs after the header
+void saveEvalWeights(const std::string& filename, const std::array<ScorePair, PARAM_COUNT>& params)
+{
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open())
+        throw std::runtime_error("Could not open weights file " + filename);
+
+    WeightsHeader header = {WEIGHTS_MAGIC, PARAM_COUNT, layoutHash()};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (ScorePair param : params)
+    {
+        std::array<i16, 2> values = {static_cast<i16>(param.mg()), static_cast<i16>(param.eg())};
+        file.write(reinterpret_cast<const char*>(values.data()), sizeof(values));
+    }
+}
+
+#ifdef RUNTIME_EVAL_WEIGHTS
+
+void loadEvalWeights(const std::string& filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open())
+        throw std::runtime_error("Could not open weights file " + filename);
+
+    WeightsHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || header.magic != WEIGHTS_MAGIC)
+        throw std::runtime_error(filename + " is not a weights file");
+    if (header.paramCount != PARAM_COUNT || header.layoutHash != layoutHash())
+        throw std::runtime_error(filename + " was written for different eval parameters");
+
+    std::array<ScorePair, PARAM_COUNT> params;
+    for (ScorePair& param : params)
+    {
+        std::array<i16, 2> values;
+        file.read(reinterpret_cast<char*>(values.data()), sizeof(values));
+        param = ScorePair(values[0], values[1]);
+    }
+    if (!file)
+        throw std::runtime_error("Weights file " + filename + " is too small");
+
+#define EVAL_PARAM_LOAD(name) \
+    std::copy_n(params.begin() + name##_INDEX, sizeof(name) / sizeof(ScorePair), \
+        reinterpret_cast<ScorePair*>(&name));
+    EVAL_PARAMS(EVAL_PARAM_LOAD, EVAL_PARAMS_NO_SEP)
+#undef EVAL_PARAM_LOAD
+
+    combinedPsqt = initPsqt();
+}
+
+#endif
+
+}
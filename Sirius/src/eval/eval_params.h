@@ -0,0 +1,98 @@
+#pragma once
+
+#include "../defs.h"
+#include "eval_constants.h"
+
+#include <array>
+#include <string>
+#include <vector>
+
+namespace eval
+{
+
+// every parameter in eval_constants.h in the order they are declared,
+// with SEP() wherever the file has a blank line between two groups
+// clang-format off
+#define EVAL_PARAMS(X, SEP) \
+    X(MATERIAL) SEP() \
+    X(PSQT) SEP() \
+    X(MOBILITY) SEP() \
+    X(THREAT_BY_PAWN) X(THREAT_BY_KNIGHT) X(THREAT_BY_BISHOP) X(THREAT_BY_ROOK) X(THREAT_BY_QUEEN) \
+    X(THREAT_BY_KING) X(KNIGHT_HIT_QUEEN) X(BISHOP_HIT_QUEEN) X(ROOK_HIT_QUEEN) X(PUSH_THREAT) \
+    X(RESTRICTED_SQUARES) SEP() \
+    X(ISOLATED_PAWN) X(ISOLATED_EXPOSED) X(DOUBLED_PAWN) X(BACKWARDS_PAWN) X(BACKWARDS_EXPOSED) \
+    X(PAWN_PHALANX) X(DEFENDED_PAWN) X(CANDIDATE_PASSER) SEP() \
+    X(PASSED_PAWN) X(OUR_PASSER_PROXIMITY) X(THEIR_PASSER_PROXIMITY) X(PASSER_DEFENDED_PUSH) \
+    X(PASSER_SLIDER_BEHIND) SEP() \
+    X(PAWN_STORM) X(PAWN_SHIELD) X(SAFE_KNIGHT_CHECK) X(SAFE_BISHOP_CHECK) X(SAFE_ROOK_CHECK) \
+    X(SAFE_QUEEN_CHECK) X(UNSAFE_KNIGHT_CHECK) X(UNSAFE_BISHOP_CHECK) X(UNSAFE_ROOK_CHECK) \
+    X(UNSAFE_QUEEN_CHECK) X(QUEENLESS_ATTACK) X(KING_ATTACKER_WEIGHT) X(KING_ATTACKS) \
+    X(WEAK_KING_RING) X(KING_FLANK_ATTACKS) X(KING_FLANK_DEFENSES) X(SAFETY_PINNED) \
+    X(SAFETY_DISCOVERED) X(SAFETY_OFFSET) SEP() \
+    X(MINOR_BEHIND_PAWN) X(KNIGHT_OUTPOST) X(BISHOP_PAWNS) X(BISHOP_PAIR) X(LONG_DIAG_BISHOP) \
+    X(ROOK_OPEN) SEP() \
+    X(TEMPO) SEP() \
+    X(COMPLEXITY_PAWNS) X(COMPLEXITY_PAWNS_BOTH_SIDES) X(COMPLEXITY_PAWN_ENDGAME) \
+    X(COMPLEXITY_OFFSET)
+// clang-format on
+
+#define EVAL_PARAMS_NO_SEP()
+
+// index of the first element of each parameter when they are all flattened into one array
+enum ParamIndex : u32
+{
+#define EVAL_PARAM_INDEX(name) \
+    name##_INDEX, name##_LAST = name##_INDEX + sizeof(name) / sizeof(ScorePair) - 1,
+    EVAL_PARAMS(EVAL_PARAM_INDEX, EVAL_PARAMS_NO_SEP)
+#undef EVAL_PARAM_INDEX
+    PARAM_COUNT
+};
+
+// the king safety terms are summed for each side and then adjusted nonlinearly,
+// and the complexity terms only apply to the endgame score after everything else
+constexpr u32 SAFETY_BEGIN = PAWN_STORM_INDEX;
+constexpr u32 SAFETY_END = SAFETY_OFFSET_INDEX + 1;
+constexpr u32 COMPLEXITY_BEGIN = COMPLEXITY_PAWNS_INDEX;
+constexpr u32 COMPLEXITY_END = PARAM_COUNT;
+
+// offset of an element of a parameter from its first element
+inline u32 paramOffset(const ScorePair&)
+{
+    return 0;
+}
+
+template<typename T, usize N, typename... Indices>
+inline u32 paramOffset(const T (&param)[N], i32 idx, Indices... rest)
+{
+    return idx * static_cast<u32>(sizeof(T) / sizeof(ScorePair)) + paramOffset(param[0], rest...);
+}
+
+struct ParamInfo
+{
+    // nullptr for the separators between groups
+    const char* name;
+    u32 index;
+    u32 size;
+    // extent of each dimension, empty for scalars
+    std::vector<u32> dims;
+};
+
+// one entry for every parameter and separator in EVAL_PARAMS
+const std::vector<ParamInfo>& paramInfos();
+
+// the current values of the parameters, flattened, which are
+// the ones in eval_constants.h unless weights have been loaded
+std::array<ScorePair, PARAM_COUNT> currentParams();
+
+// writes params to a binary weights file, which records the layout of the
+// parameters so that it can't be loaded by a build with different ones
+void saveEvalWeights(
+    const std::string& filename, const std::array<ScorePair, PARAM_COUNT>& params);
+
+#ifdef RUNTIME_EVAL_WEIGHTS
+// replaces the parameters with the ones in a weights file and rebuilds the tables
+// computed from them, throws std::runtime_error if the file can't be loaded
+void loadEvalWeights(const std::string& filename);
+#endif
+
+}
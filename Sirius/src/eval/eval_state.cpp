@@ -7,6 +7,7 @@ namespace eval
 {
 
 EvalState::EvalState()
+    : m_PawnTable(nullptr), m_Network(nullptr)
 {
     std::fill(m_Stack.begin(), m_Stack.end(), StackEntry{});
     m_CurrEntry = &m_Stack[0];
@@ -14,15 +15,15 @@ EvalState::EvalState()
 
 void EvalState::initSingle(const Board& board)
 {
-    init(board, nullptr);
+    init(board, nullptr, nullptr);
 }
 
-void EvalState::init(const Board& board, PawnTable& pawnTable)
+void EvalState::init(const Board& board, PawnTable& pawnTable, const nnue::Network* network)
 {
-    init(board, &pawnTable);
+    init(board, &pawnTable, network);
 }
 
-void EvalState::init(const Board& board, PawnTable* pawnTable)
+void EvalState::init(const Board& board, PawnTable* pawnTable, const nnue::Network* network)
 {
     using enum PieceType;
     using enum Color;
@@ -30,6 +31,13 @@ void EvalState::init(const Board& board, PawnTable* pawnTable)
     std::fill(m_Stack.begin(), m_Stack.end(), StackEntry{});
     m_CurrEntry = &m_Stack[0];
     m_PawnTable = pawnTable;
+    m_Network = network;
+
+    if (m_Network)
+    {
+        m_Accumulators.resize(m_Stack.size());
+        m_Accumulators[0].init(*m_Network, board);
+    }
 
     currEntry().psqtState.init();
     for (Color c : {WHITE, BLACK})
@@ -43,72 +51,140 @@ void EvalState::init(const Board& board, PawnTable* pawnTable)
     }
 
     evaluatePawns(board, currEntry().pawnStructure, m_PawnTable);
-    currEntry().pawnShieldStorm[WHITE] = evaluateStormShield<WHITE>(board);
-    currEntry().pawnShieldStorm[BLACK] = evaluateStormShield<BLACK>(board);
+    evaluateShieldStorm(board, currEntry().pawnShieldStorm, m_PawnTable);
     currEntry().knightOutposts = evaluateKnightOutposts<WHITE>(board, currEntry().pawnStructure)
         - evaluateKnightOutposts<BLACK>(board, currEntry().pawnStructure);
     currEntry().bishopPawns = evaluateBishopPawns<WHITE>(board) - evaluateBishopPawns<BLACK>(board);
     currEntry().rookOpen = evaluateRookOpen<WHITE>(board) - evaluateRookOpen<BLACK>(board);
     currEntry().minorBehindPawn =
         evaluateMinorBehindPawn<WHITE>(board) - evaluateMinorBehindPawn<BLACK>(board);
+
+    currEntry().pieceAttacks.fill(EMPTY_BB);
+    updatePieceAttacks(board, board.allPieces());
+
+    currEntry().materialized = true;
 }
 
-void EvalState::push(const Board& board, const EvalUpdates& updates)
+void EvalState::push(const EvalUpdates& updates)
 {
-    using enum Color;
-
-    const auto& oldEntry = currEntry();
     m_CurrEntry++;
 
     assert(m_CurrEntry < m_Stack.data() + m_Stack.size());
 
     currEntry().updates = updates;
+    currEntry().materialized = false;
+}
+
+// replays the updates since the nearest materialized ancestor, so positions that are
+// never evaluated(tt cutoffs, pruning, draws, etc.) never pay for the eval updates
+void EvalState::materialize(const Board& board)
+{
+    using enum Color;
 
-    currEntry().psqtState = oldEntry.psqtState;
-    for (const auto& add : currEntry().updates.adds)
+    if (currEntry().materialized)
+        return;
+
+    const StackEntry* base = m_CurrEntry - 1;
+    while (!base->materialized)
+        base--;
+
+    if (m_Network)
     {
-        currEntry().psqtState.addPiece(getPieceColor(add.piece), getPieceType(add.piece), add.square);
+        usize baseIdx = base - m_Stack.data();
+        usize currIdx = m_CurrEntry - m_Stack.data();
+        m_Accumulators[currIdx] = m_Accumulators[baseIdx];
+        for (usize i = baseIdx + 1; i <= currIdx; i++)
+            m_Accumulators[currIdx].update(*m_Network, m_Stack[i].updates);
+
+        currEntry().materialized = true;
+        return;
     }
 
-    for (const auto& add : currEntry().updates.removes)
+    PieceSet changedPieces;
+    Bitboard changedSquares = EMPTY_BB;
+
+    currEntry().psqtState = base->psqtState;
+    for (const StackEntry* entry = base + 1; entry <= m_CurrEntry; entry++)
     {
-        currEntry().psqtState.removePiece(getPieceColor(add.piece), getPieceType(add.piece), add.square);
+        for (const auto& add : entry->updates.adds)
+        {
+            currEntry().psqtState.addPiece(
+                getPieceColor(add.piece), getPieceType(add.piece), add.square);
+            changedPieces.add(getPieceType(add.piece));
+        }
+
+        for (const auto& remove : entry->updates.removes)
+        {
+            currEntry().psqtState.removePiece(
+                getPieceColor(remove.piece), getPieceType(remove.piece), remove.square);
+            changedPieces.add(getPieceType(remove.piece));
+        }
+
+        changedSquares |= entry->updates.changedSquares();
     }
 
-    if (updates.changedPieces.hasAny(eval_terms::pawnStructure.deps))
+    if (changedPieces.hasAny(eval_terms::pawnStructure.deps))
         evaluatePawns(board, currEntry().pawnStructure, m_PawnTable);
     else
-        currEntry().pawnStructure = oldEntry.pawnStructure;
+        currEntry().pawnStructure = base->pawnStructure;
 
-    if (updates.changedPieces.hasAny(eval_terms::pawnShieldStorm.deps))
-    {
-        currEntry().pawnShieldStorm[WHITE] = evaluateStormShield<WHITE>(board);
-        currEntry().pawnShieldStorm[BLACK] = evaluateStormShield<BLACK>(board);
-    }
+    if (changedPieces.hasAny(eval_terms::pawnShieldStorm.deps))
+        evaluateShieldStorm(board, currEntry().pawnShieldStorm, m_PawnTable);
     else
-        currEntry().pawnShieldStorm = oldEntry.pawnShieldStorm;
+        currEntry().pawnShieldStorm = base->pawnShieldStorm;
 
-    if (updates.changedPieces.hasAny(eval_terms::knightOutposts.deps))
+    if (changedPieces.hasAny(eval_terms::knightOutposts.deps))
         currEntry().knightOutposts = evaluateKnightOutposts<WHITE>(board, currEntry().pawnStructure)
             - evaluateKnightOutposts<BLACK>(board, currEntry().pawnStructure);
     else
-        currEntry().knightOutposts = oldEntry.knightOutposts;
+        currEntry().knightOutposts = base->knightOutposts;
 
-    if (updates.changedPieces.hasAny(eval_terms::bishopPawns.deps))
+    if (changedPieces.hasAny(eval_terms::bishopPawns.deps))
         currEntry().bishopPawns = evaluateBishopPawns<WHITE>(board) - evaluateBishopPawns<BLACK>(board);
     else
-        currEntry().bishopPawns = oldEntry.bishopPawns;
+        currEntry().bishopPawns = base->bishopPawns;
 
-    if (updates.changedPieces.hasAny(eval_terms::rookOpen.deps))
+    if (changedPieces.hasAny(eval_terms::rookOpen.deps))
         currEntry().rookOpen = evaluateRookOpen<WHITE>(board) - evaluateRookOpen<BLACK>(board);
     else
-        currEntry().rookOpen = oldEntry.rookOpen;
+        currEntry().rookOpen = base->rookOpen;
 
-    if (updates.changedPieces.hasAny(eval_terms::minorBehindPawn.deps))
+    if (changedPieces.hasAny(eval_terms::minorBehindPawn.deps))
         currEntry().minorBehindPawn =
             evaluateMinorBehindPawn<WHITE>(board) - evaluateMinorBehindPawn<BLACK>(board);
     else
-        currEntry().minorBehindPawn = oldEntry.minorBehindPawn;
+        currEntry().minorBehindPawn = base->minorBehindPawn;
+
+    currEntry().pieceAttacks = base->pieceAttacks;
+    updatePieceAttacks(board, changedSquares);
+
+    currEntry().materialized = true;
+}
+
+// a slider's attacks only depend on the contents of the squares it attacks,
+// so they only need to be refreshed if one of those squares has changed
+void EvalState::updatePieceAttacks(const Board& board, Bitboard changed)
+{
+    using enum PieceType;
+
+    Bitboard pieces = board.allPieces() & ~board.pieces(PAWN) & ~board.pieces(KING);
+    Bitboard sliders = pieces & ~board.pieces(KNIGHT);
+
+    Bitboard refresh = changed;
+    Bitboard unchangedSliders = sliders & ~changed;
+    while (unchangedSliders.any())
+    {
+        Square sq = unchangedSliders.poplsb();
+        if ((currEntry().pieceAttacks[sq.value()] & changed).any())
+            refresh |= Bitboard::fromSquare(sq);
+    }
+
+    while (refresh.any())
+    {
+        Square sq = refresh.poplsb();
+        currEntry().pieceAttacks[sq.value()] =
+            pieces.has(sq) ? pieceAttacksXray(board, sq) : EMPTY_BB;
+    }
 }
 
 void EvalState::pop()
@@ -141,4 +217,19 @@ const PawnStructure& EvalState::pawnStructure() const
     return currEntry().pawnStructure;
 }
 
+Bitboard EvalState::pieceAttacks(Square sq) const
+{
+    return currEntry().pieceAttacks[sq.value()];
+}
+
+const nnue::Network* EvalState::network() const
+{
+    return m_Network;
+}
+
+const nnue::Accumulator& EvalState::accumulator() const
+{
+    return m_Accumulators[m_CurrEntry - m_Stack.data()];
+}
+
 }
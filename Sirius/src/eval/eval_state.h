@@ -2,10 +2,12 @@
 
 #include "../util/piece_set.h"
 #include "../util/static_vector.h"
+#include "nnue.h"
 #include "pawn_structure.h"
 #include "pawn_table.h"
 #include "psqt_state.h"
 #include <optional>
+#include <vector>
 
 namespace eval
 {
@@ -32,6 +34,16 @@ struct EvalUpdates
         removes.push_back(update);
         changedPieces.add(getPieceType(update.piece));
     }
+
+    Bitboard changedSquares() const
+    {
+        Bitboard changed = EMPTY_BB;
+        for (const auto& add : adds)
+            changed |= Bitboard::fromSquare(add.square);
+        for (const auto& remove : removes)
+            changed |= Bitboard::fromSquare(remove.square);
+        return changed;
+    }
 };
 
 struct EvalState
@@ -40,21 +52,31 @@ public:
     EvalState();
 
     void initSingle(const Board& board);
-    void init(const Board& board, PawnTable& pawnTable);
+    void init(const Board& board, PawnTable& pawnTable, const nnue::Network* network = nullptr);
 
-    void push(const Board& board, const EvalUpdates& updates);
+    void push(const EvalUpdates& updates);
     void pop();
+    void materialize(const Board& board);
 
     ScorePair score(const Board& board) const;
     ScorePair psqtScore(const Board& board, Color c) const;
     ScorePair pawnShieldStormScore(Color c) const;
     const PawnStructure& pawnStructure() const;
+    Bitboard pieceAttacks(Square sq) const;
+
+    // nullptr if the hand crafted eval is used
+    const nnue::Network* network() const;
+    const nnue::Accumulator& accumulator() const;
 
 private:
-    void init(const Board& board, PawnTable* pawnTable);
+    void init(const Board& board, PawnTable* pawnTable, const nnue::Network* network);
+    void updatePieceAttacks(const Board& board, Bitboard changed);
     struct StackEntry
     {
         EvalUpdates updates;
+        // false if only the updates have been recorded and the
+        // rest of the entry has not been computed from them yet
+        bool materialized;
 
         PsqtState psqtState;
         PawnStructure pawnStructure;
@@ -63,6 +85,9 @@ private:
         ScorePair bishopPawns;
         ScorePair rookOpen;
         ScorePair minorBehindPawn;
+        // attacks of the non pawn, non king piece on each square, with xrays
+        // through friendly sliders, but without pin masking
+        std::array<Bitboard, 64> pieceAttacks;
     };
 
     StackEntry& currEntry()
@@ -78,6 +103,11 @@ private:
     std::array<StackEntry, 256> m_Stack;
     StackEntry* m_CurrEntry;
     PawnTable* m_PawnTable;
+
+    // parallel to m_Stack, only allocated once a network is used, and only
+    // materialized instead of the hand crafted terms when a network is used
+    std::vector<nnue::Accumulator> m_Accumulators;
+    const nnue::Network* m_Network;
 };
 
 }
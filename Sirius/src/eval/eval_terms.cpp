@@ -4,6 +4,7 @@
 #include "../board.h"
 
 #include "eval_constants.h"
+#include "eval_trace.h"
 #include "pawn_structure.h"
 #include "pawn_table.h"
 
@@ -14,23 +15,62 @@ namespace eval
 
 void evaluatePawns(const Board& board, PawnStructure& pawnStructure, PawnTable* pawnTable)
 {
+    if (pawnTable && pawnTable->probe(board.pawnKey(), pawnStructure))
+        return;
+
+    pawnStructure = PawnStructure(board);
+    pawnStructure.evaluate(board);
+
     if (pawnTable)
+        pawnTable->store(board.pawnKey(), pawnStructure);
+}
+
+void evaluateShieldStorm(
+    const Board& board, ColorArray<ScorePair>& shieldStorm, PawnTable* pawnTable)
+{
+    using enum Color;
+
+    // shield and storm only depend on the pawns and the files around each king
+    u32 whiteFile = std::clamp(board.kingSq(WHITE).file(), FILE_B, FILE_G);
+    u32 blackFile = std::clamp(board.kingSq(BLACK).file(), FILE_B, FILE_G);
+    u64 key = board.pawnKey().value ^ murmurHash3(1 + whiteFile + 8 * blackFile);
+
+    KingPawnEntry entry;
+    if (pawnTable && pawnTable->probeKingPawns(key, entry))
     {
-        const auto& entry = pawnTable->probe(board.pawnKey());
-        if (entry.pawnKey == board.pawnKey())
-        {
-            pawnStructure = entry.pawnStructure;
-            return;
-        }
+        shieldStorm = entry.pawnShieldStorm;
+        return;
     }
 
-    pawnStructure = PawnStructure(board);
-    pawnStructure.evaluate(board);
+    shieldStorm[WHITE] = evaluateStormShield<WHITE>(board);
+    shieldStorm[BLACK] = evaluateStormShield<BLACK>(board);
 
     if (pawnTable)
+        pawnTable->storeKingPawns(key, {shieldStorm});
+}
+
+Bitboard pieceAttacksXray(const Board& board, Square sq)
+{
+    using enum PieceType;
+
+    Piece piece = board.pieceAt(sq);
+    Color color = getPieceColor(piece);
+    Bitboard occupancy = board.allPieces();
+    switch (getPieceType(piece))
     {
-        PawnEntry replace = {board.pawnKey(), pawnStructure};
-        pawnTable->store(replace);
+        case KNIGHT:
+            return attacks::knightAttacks(sq);
+        case BISHOP:
+            occupancy ^= board.pieces(color, BISHOP) | board.pieces(color, QUEEN);
+            return attacks::bishopAttacks(sq, occupancy);
+        case ROOK:
+            occupancy ^= board.pieces(color, ROOK) | board.pieces(color, QUEEN);
+            return attacks::rookAttacks(sq, occupancy);
+        case QUEEN:
+            occupancy ^= board.pieces(color, BISHOP) | board.pieces(color, ROOK);
+            return attacks::queenAttacks(sq, occupancy);
+        default:
+            return EMPTY_BB;
     }
 }
 
@@ -52,6 +92,7 @@ ScorePair evalKingPawnFile(u32 file, Bitboard ourPawns, Bitboard theirPawns)
             blocked = theirPawns.has(filePawn + attacks::pawnPushOffset<us>());
         }
         eval += PAWN_STORM[blocked][edgeDist][rank];
+        TRACE_ADD(PAWN_STORM, us, 1, blocked, edgeDist, rank);
     }
     {
         Bitboard filePawns = theirPawns & Bitboard::fileBB(file);
@@ -59,6 +100,7 @@ ScorePair evalKingPawnFile(u32 file, Bitboard ourPawns, Bitboard theirPawns)
             ? (us == Color::WHITE ? filePawns.msb() : filePawns.lsb()).relativeRank<them>()
             : 0;
         eval += PAWN_SHIELD[edgeDist][rank];
+        TRACE_ADD(PAWN_SHIELD, us, 1, edgeDist, rank);
     }
     return eval;
 }
@@ -86,6 +128,7 @@ ScorePair evaluateKnightOutposts(const Board& board, const PawnStructure& pawnSt
     Bitboard outpostRanks = RANK_4_BB | RANK_5_BB | (us == Color::WHITE ? RANK_6_BB : RANK_3_BB);
     Bitboard outposts =
         outpostRanks & ~pawnStructure.pawnAttackSpans[them] & pawnStructure.pawnAttacks[us];
+    TRACE_ADD(KNIGHT_OUTPOST, us, (board.pieces(us, PieceType::KNIGHT) & outposts).popcount());
     return KNIGHT_OUTPOST * (board.pieces(us, PieceType::KNIGHT) & outposts).popcount();
 }
 
@@ -102,6 +145,7 @@ ScorePair evaluateBishopPawns(const Board& board)
         Bitboard sameColorPawns =
             board.pieces(us, PieceType::PAWN) & (lightSquare ? LIGHT_SQUARES_BB : DARK_SQUARES_BB);
         eval += BISHOP_PAWNS[std::min(sameColorPawns.popcount(), 6u)];
+        TRACE_ADD(BISHOP_PAWNS, us, 1, std::min(sameColorPawns.popcount(), 6u));
     }
     return eval;
 }
@@ -119,7 +163,10 @@ ScorePair evaluateRookOpen(const Board& board)
     {
         Bitboard fileBB = Bitboard::fileBB(rooks.poplsb().file());
         if ((ourPawns & fileBB).empty())
+        {
             eval += (theirPawns & fileBB).any() ? ROOK_OPEN[1] : ROOK_OPEN[0];
+            TRACE_ADD(ROOK_OPEN, us, 1, (theirPawns & fileBB).any());
+        }
     }
     return eval;
 }
@@ -133,6 +180,7 @@ ScorePair evaluateMinorBehindPawn(const Board& board)
     Bitboard minors = board.pieces(us, PieceType::KNIGHT) | board.pieces(us, PieceType::BISHOP);
 
     Bitboard shielded = minors & attacks::pawnPushes<them>(pawns);
+    TRACE_ADD(MINOR_BEHIND_PAWN, us, shielded.popcount());
     return MINOR_BEHIND_PAWN * shielded.popcount();
 }
 
@@ -2,6 +2,7 @@
 
 #include "../bitboard.h"
 #include "../defs.h"
+#include "../util/enum_array.h"
 #include "../util/piece_set.h"
 #include <bitset>
 #include <type_traits>
@@ -33,6 +34,10 @@ constexpr EvalTerm minorBehindPawn = {PieceSet(PAWN, KNIGHT, BISHOP)};
 } // namespace eval_terms
 
 void evaluatePawns(const Board& board, PawnStructure& pawnStructure, PawnTable* pawnTable);
+void evaluateShieldStorm(
+    const Board& board, ColorArray<ScorePair>& shieldStorm, PawnTable* pawnTable);
+
+Bitboard pieceAttacksXray(const Board& board, Square sq);
 
 template<Color us>
 ScorePair evalKingPawnFile(u32 file, Bitboard ourPawns, Bitboard theirPawns);
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "../defs.h"
+#include "../util/enum_array.h"
+#include "eval_params.h"
+
+#include <array>
+
+namespace eval
+{
+
+#ifdef EVAL_TUNE
+
+// how many times each parameter was added to each side's eval in a position,
+// which is enough for the tuner to recompute the eval for any parameter values
+struct EvalTrace
+{
+    std::array<ColorArray<i16>, PARAM_COUNT> coeffs;
+    i32 phase;
+    i32 scale;
+    // from white's perspective, to check the tuner's eval against
+    i32 eval;
+};
+
+// the trace being recorded by this thread, nullptr if not tracing
+inline thread_local EvalTrace* currTrace = nullptr;
+
+inline void traceAdd(u32 index, Color color, i32 count)
+{
+    if (currTrace)
+        currTrace->coeffs[index][color] = static_cast<i16>(currTrace->coeffs[index][color] + count);
+}
+
+// TRACE_ADD(MOBILITY, us, 1, pieceIdx, mobility) records MOBILITY[pieceIdx][mobility] being added
+#define TRACE_ADD(param, color, count, ...) \
+    ::eval::traceAdd( \
+        param##_INDEX + ::eval::paramOffset(param __VA_OPT__(, ) __VA_ARGS__), color, count)
+#define TRACE_ADD_INDEX(index, color, count) ::eval::traceAdd(index, color, count)
+
+#else
+
+#define TRACE_ADD(param, color, count, ...)
+#define TRACE_ADD_INDEX(index, color, count)
+
+#endif
+
+}
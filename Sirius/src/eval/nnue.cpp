@@ -0,0 +1,242 @@
+#include "nnue.h"
+#include "../board.h"
+#include "eval_state.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SIRIUS_NNUE_X86
+#include <immintrin.h>
+#endif
+
+namespace eval::nnue
+{
+
+namespace
+{
+
+// the generic kernels are written so that they autovectorize, and are
+// compiled once for each target below
+inline void addFeatureImpl(i16* values, const i16* weights)
+{
+    for (i32 i = 0; i < HIDDEN_SIZE; i++)
+        values[i] = static_cast<i16>(values[i] + weights[i]);
+}
+
+inline void subFeatureImpl(i16* values, const i16* weights)
+{
+    for (i32 i = 0; i < HIDDEN_SIZE; i++)
+        values[i] = static_cast<i16>(values[i] - weights[i]);
+}
+
+i32 forwardScalar(const i16* us, const i16* them, const i16* weights)
+{
+    i32 sum = 0;
+    for (i32 i = 0; i < HIDDEN_SIZE; i++)
+    {
+        i32 v = std::clamp<i32>(us[i], 0, QA);
+        sum += v * v * weights[i];
+    }
+    for (i32 i = 0; i < HIDDEN_SIZE; i++)
+    {
+        i32 v = std::clamp<i32>(them[i], 0, QA);
+        sum += v * v * weights[HIDDEN_SIZE + i];
+    }
+    return sum;
+}
+
+#ifdef SIRIUS_NNUE_X86
+
+__attribute__((target("avx2"))) void addFeatureAvx2(i16* values, const i16* weights)
+{
+    addFeatureImpl(values, weights);
+}
+
+__attribute__((target("avx2"))) void subFeatureAvx2(i16* values, const i16* weights)
+{
+    subFeatureImpl(values, weights);
+}
+
+__attribute__((target("avx2"))) i32 forwardAvx2(
+    const i16* us, const i16* them, const i16* weights)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i qa = _mm256_set1_epi16(QA);
+    __m256i sum = zero;
+
+    for (i32 i = 0; i < 2 * HIDDEN_SIZE; i += 16)
+    {
+        const i16* values = i < HIDDEN_SIZE ? us + i : them + i - HIDDEN_SIZE;
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values));
+        v = _mm256_min_epi16(_mm256_max_epi16(v, zero), qa);
+        __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(weights + i));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(v, _mm256_mullo_epi16(v, w)));
+    }
+
+    __m128i sum128 =
+        _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, 0x4E));
+    sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, 0xB1));
+    return _mm_cvtsi128_si32(sum128);
+}
+
+__attribute__((target("avx512f,avx512bw"))) void addFeatureAvx512(
+    i16* values, const i16* weights)
+{
+    addFeatureImpl(values, weights);
+}
+
+__attribute__((target("avx512f,avx512bw"))) void subFeatureAvx512(
+    i16* values, const i16* weights)
+{
+    subFeatureImpl(values, weights);
+}
+
+__attribute__((target("avx512f,avx512bw"))) i32 forwardAvx512(
+    const i16* us, const i16* them, const i16* weights)
+{
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i qa = _mm512_set1_epi16(QA);
+    __m512i sum = zero;
+
+    for (i32 i = 0; i < 2 * HIDDEN_SIZE; i += 32)
+    {
+        const i16* values = i < HIDDEN_SIZE ? us + i : them + i - HIDDEN_SIZE;
+        __m512i v = _mm512_loadu_si512(values);
+        v = _mm512_min_epi16(_mm512_max_epi16(v, zero), qa);
+        __m512i w = _mm512_loadu_si512(weights + i);
+        sum = _mm512_add_epi32(sum, _mm512_madd_epi16(v, _mm512_mullo_epi16(v, w)));
+    }
+
+    return _mm512_reduce_add_epi32(sum);
+}
+
+#endif
+
+struct Kernels
+{
+    const char* name;
+    void (*addFeature)(i16* values, const i16* weights);
+    void (*subFeature)(i16* values, const i16* weights);
+    i32 (*forward)(const i16* us, const i16* them, const i16* weights);
+};
+
+Kernels kernels = {"scalar", addFeatureImpl, subFeatureImpl, forwardScalar};
+
+}
+
+std::shared_ptr<const Network> loadNetwork(const std::string& filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open())
+        throw std::runtime_error("Could not open network file " + filename);
+
+    // bullet writes each layer as little endian i16s, in the order they are in Network
+    auto network = std::make_shared<Network>();
+    file.read(reinterpret_cast<char*>(network->featureWeights.data()),
+        sizeof(network->featureWeights));
+    file.read(
+        reinterpret_cast<char*>(network->featureBias.data()), sizeof(network->featureBias));
+    file.read(
+        reinterpret_cast<char*>(network->outputWeights.data()), sizeof(network->outputWeights));
+    file.read(reinterpret_cast<char*>(&network->outputBias), sizeof(network->outputBias));
+
+    if (!file)
+        throw std::runtime_error("Network file " + filename + " is too small");
+
+    for (i16 weight : network->outputWeights)
+        if (std::abs(weight) > MAX_OUTPUT_WEIGHT)
+            throw std::runtime_error(
+                "Network file " + filename + " has output weights out of range");
+
+    return network;
+}
+
+void saveNetwork(const Network& network, const std::string& filename)
+{
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open())
+        throw std::runtime_error("Could not open network file " + filename);
+
+    file.write(reinterpret_cast<const char*>(network.featureWeights.data()),
+        sizeof(network.featureWeights));
+    file.write(
+        reinterpret_cast<const char*>(network.featureBias.data()), sizeof(network.featureBias));
+    file.write(reinterpret_cast<const char*>(network.outputWeights.data()),
+        sizeof(network.outputWeights));
+    file.write(reinterpret_cast<const char*>(&network.outputBias), sizeof(network.outputBias));
+
+    usize size = sizeof(network.featureWeights) + sizeof(network.featureBias)
+        + sizeof(network.outputWeights) + sizeof(network.outputBias);
+    std::array<char, 64> padding = {};
+    file.write(padding.data(), (64 - size % 64) % 64);
+}
+
+void Accumulator::init(const Network& network, const Board& board)
+{
+    values.fill(network.featureBias);
+
+    Bitboard pieces = board.allPieces();
+    while (pieces.any())
+    {
+        Square sq = pieces.poplsb();
+        Piece piece = board.pieceAt(sq);
+        for (Color perspective : {Color::WHITE, Color::BLACK})
+        {
+            i32 feature =
+                featureIndex(perspective, getPieceColor(piece), getPieceType(piece), sq);
+            kernels.addFeature(
+                values[perspective].data(), network.featureWeights[feature].data());
+        }
+    }
+}
+
+void Accumulator::update(const Network& network, const EvalUpdates& updates)
+{
+    for (Color perspective : {Color::WHITE, Color::BLACK})
+    {
+        for (const auto& add : updates.adds)
+        {
+            i32 feature = featureIndex(
+                perspective, getPieceColor(add.piece), getPieceType(add.piece), add.square);
+            kernels.addFeature(
+                values[perspective].data(), network.featureWeights[feature].data());
+        }
+
+        for (const auto& remove : updates.removes)
+        {
+            i32 feature = featureIndex(perspective, getPieceColor(remove.piece),
+                getPieceType(remove.piece), remove.square);
+            kernels.subFeature(
+                values[perspective].data(), network.featureWeights[feature].data());
+        }
+    }
+}
+
+i32 evaluate(const Network& network, const Accumulator& accumulator, Color stm)
+{
+    i32 sum = kernels.forward(accumulator.values[stm].data(), accumulator.values[~stm].data(),
+        network.outputWeights.data());
+    i32 eval = (sum / QA + network.outputBias) * EVAL_SCALE / (QA * QB);
+    return std::clamp(eval, -SCORE_WIN + 1, SCORE_WIN - 1);
+}
+
+void init()
+{
+#ifdef SIRIUS_NNUE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512bw"))
+        kernels = {"avx512", addFeatureAvx512, subFeatureAvx512, forwardAvx512};
+    else if (__builtin_cpu_supports("avx2"))
+        kernels = {"avx2", addFeatureAvx2, subFeatureAvx2, forwardAvx2};
+#endif
+}
+
+const char* kernelName()
+{
+    return kernels.name;
+}
+
+}
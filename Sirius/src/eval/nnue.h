@@ -0,0 +1,71 @@
+#pragma once
+
+#include "../defs.h"
+#include "../util/enum_array.h"
+
+#include <array>
+#include <memory>
+#include <string>
+
+class Board;
+
+namespace eval
+{
+
+struct EvalUpdates;
+
+namespace nnue
+{
+
+// (768 -> 256)x2 -> 1, SCReLU
+constexpr i32 INPUT_SIZE = 768;
+constexpr i32 HIDDEN_SIZE = 256;
+
+constexpr i32 QA = 255;
+constexpr i32 QB = 64;
+constexpr i32 EVAL_SCALE = 400;
+
+// the simd kernels compute v * (v * w) with v * w in 16 bits,
+// so output weights must be small enough that it can't overflow
+constexpr i32 MAX_OUTPUT_WEIGHT = 32767 / QA;
+
+// the perspective's own pieces come first, and squares are flipped for black
+inline i32 featureIndex(Color perspective, Color color, PieceType piece, Square square)
+{
+    i32 relSquare = perspective == Color::WHITE ? square.value() : square.value() ^ 56;
+    return (color != perspective) * 384 + static_cast<i32>(piece) * 64 + relSquare;
+}
+
+struct Network
+{
+    alignas(64) std::array<std::array<i16, HIDDEN_SIZE>, INPUT_SIZE> featureWeights;
+    alignas(64) std::array<i16, HIDDEN_SIZE> featureBias;
+    // first half for the side to move's accumulator, second half for the other side's
+    alignas(64) std::array<i16, 2 * HIDDEN_SIZE> outputWeights;
+    i16 outputBias;
+};
+
+// loads a network in bullet's quantised format, throws std::runtime_error on failure
+std::shared_ptr<const Network> loadNetwork(const std::string& filename);
+// writes a network in the same format, padded to a multiple of 64 bytes like bullet does
+void saveNetwork(const Network& network, const std::string& filename);
+
+struct alignas(64) Accumulator
+{
+    // indexed by perspective
+    ColorArray<std::array<i16, HIDDEN_SIZE>> values;
+
+    void init(const Network& network, const Board& board);
+    void update(const Network& network, const EvalUpdates& updates);
+};
+
+i32 evaluate(const Network& network, const Accumulator& accumulator, Color stm);
+
+// selects the simd kernels for the current cpu
+void init();
+// name of the selected kernels
+const char* kernelName();
+
+}
+
+}
@@ -1,6 +1,7 @@
 #include "pawn_structure.h"
 #include "../attacks.h"
 #include "eval_constants.h"
+#include "eval_trace.h"
 
 namespace eval
 {
@@ -59,24 +60,44 @@ ScorePair PawnStructure::evaluate(const Board& board)
         {
             bool defended = defenders.popcount() >= threats.popcount();
             eval += CANDIDATE_PASSER[defended][sq.relativeRank<us>()];
+            TRACE_ADD(CANDIDATE_PASSER, us, 1, defended, sq.relativeRank<us>());
         }
 
         if (doubled && threats.empty())
+        {
             eval += DOUBLED_PAWN[std::min(sq.file(), sq.file() ^ 7)];
+            TRACE_ADD(DOUBLED_PAWN, us, 1, std::min(sq.file(), sq.file() ^ 7));
+        }
 
         if (threats.empty() && isolated)
+        {
             eval += ISOLATED_PAWN[std::min(sq.file(), sq.file() ^ 7)] + ISOLATED_EXPOSED * exposed;
+            TRACE_ADD(ISOLATED_PAWN, us, 1, std::min(sq.file(), sq.file() ^ 7));
+            TRACE_ADD(ISOLATED_EXPOSED, us, exposed);
+        }
         else if (backwards)
+        {
             eval += BACKWARDS_PAWN[sq.relativeRank<us>()] + BACKWARDS_EXPOSED * exposed;
+            TRACE_ADD(BACKWARDS_PAWN, us, 1, sq.relativeRank<us>());
+            TRACE_ADD(BACKWARDS_EXPOSED, us, exposed);
+        }
     }
 
     Bitboard phalanx = ourPawns & ourPawns.west();
     while (phalanx.any())
-        eval += PAWN_PHALANX[phalanx.poplsb().relativeRank<us>()];
+    {
+        i32 rank = phalanx.poplsb().relativeRank<us>();
+        eval += PAWN_PHALANX[rank];
+        TRACE_ADD(PAWN_PHALANX, us, 1, rank);
+    }
 
     Bitboard defended = ourPawns & pawnAttacks[us];
     while (defended.any())
-        eval += DEFENDED_PAWN[defended.poplsb().relativeRank<us>()];
+    {
+        i32 rank = defended.poplsb().relativeRank<us>();
+        eval += DEFENDED_PAWN[rank];
+        TRACE_ADD(DEFENDED_PAWN, us, 1, rank);
+    }
 
     return eval;
 }
@@ -1,48 +1,177 @@
 #pragma once
 
 #include "../defs.h"
+#include "../util/enum_array.h"
+#include "../util/murmur.h"
 #include "../zobrist.h"
 #include "pawn_structure.h"
-#include <vector>
 
-struct PawnEntry
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <memory>
+
+// hash table shared between search threads without locks
+// each entry stores its key xored with a hash of its data, so an entry
+// that was torn by concurrent writes fails the key check on probe
+template<typename T>
+class LocklessTable
+{
+public:
+    static_assert(std::is_trivially_copyable_v<T>, "LocklessTable data must be trivially copyable");
+
+    void resize(usize bytes);
+    void clear();
+
+    bool probe(u64 key, T& value) const;
+    void store(u64 key, const T& value);
+
+private:
+    static constexpr usize DATA_WORDS = (sizeof(T) + 7) / 8;
+    using Words = std::array<u64, DATA_WORDS>;
+
+    struct Entry
+    {
+        std::atomic<u64> check;
+        std::array<std::atomic<u64>, DATA_WORDS> data;
+    };
+
+    static u64 hashWords(const Words& words);
+    usize index(u64 key) const;
+
+    std::unique_ptr<Entry[]> m_Entries;
+    usize m_Size = 0;
+};
+
+template<typename T>
+inline void LocklessTable<T>::resize(usize bytes)
+{
+    // round down to a power of 2 so that indexing is a mask
+    usize size = 1;
+    while (size * 2 * sizeof(Entry) <= bytes)
+        size *= 2;
+
+    m_Entries = std::make_unique<Entry[]>(size);
+    m_Size = size;
+    clear();
+}
+
+template<typename T>
+inline void LocklessTable<T>::clear()
+{
+    for (usize i = 0; i < m_Size; i++)
+    {
+        // a zero check with zeroed data never matches a nonzero key
+        m_Entries[i].check.store(0, std::memory_order_relaxed);
+        for (auto& word : m_Entries[i].data)
+            word.store(0, std::memory_order_relaxed);
+    }
+}
+
+template<typename T>
+inline bool LocklessTable<T>::probe(u64 key, T& value) const
+{
+    const Entry& entry = m_Entries[index(key)];
+    u64 check = entry.check.load(std::memory_order_relaxed);
+    Words words;
+    for (usize i = 0; i < DATA_WORDS; i++)
+        words[i] = entry.data[i].load(std::memory_order_relaxed);
+
+    if ((check ^ hashWords(words)) != key)
+        return false;
+
+    std::memcpy(&value, words.data(), sizeof(T));
+    return true;
+}
+
+template<typename T>
+inline void LocklessTable<T>::store(u64 key, const T& value)
+{
+    Entry& entry = m_Entries[index(key)];
+    Words words = {};
+    std::memcpy(words.data(), &value, sizeof(T));
+
+    entry.check.store(key ^ hashWords(words), std::memory_order_relaxed);
+    for (usize i = 0; i < DATA_WORDS; i++)
+        entry.data[i].store(words[i], std::memory_order_relaxed);
+}
+
+template<typename T>
+inline u64 LocklessTable<T>::hashWords(const Words& words)
+{
+    u64 hash = 0;
+    for (u64 word : words)
+        hash = murmurHash3(hash ^ word);
+    return hash;
+}
+
+template<typename T>
+inline usize LocklessTable<T>::index(u64 key) const
+{
+    return key & (m_Size - 1);
+}
+
+struct KingPawnEntry
 {
-    ZKey pawnKey;
-    eval::PawnStructure pawnStructure;
+    ColorArray<ScorePair> pawnShieldStorm;
 };
 
 class PawnTable
 {
 public:
-    static constexpr usize SIZE = 32768;
-    static_assert((SIZE & (SIZE - 1)) == 0, "PawnCache::SIZE must be a power of 2");
-    PawnTable();
+    static constexpr i32 DEFAULT_SIZE_MB = 2;
 
-    PawnEntry probe(ZKey pawnKey) const;
-    void store(PawnEntry entry);
+    PawnTable(i32 mb = DEFAULT_SIZE_MB);
 
+    void resize(i32 mb);
     void clear();
 
+    bool probe(ZKey pawnKey, eval::PawnStructure& pawnStructure) const;
+    void store(ZKey pawnKey, const eval::PawnStructure& pawnStructure);
+
+    bool probeKingPawns(u64 key, KingPawnEntry& entry) const;
+    void storeKingPawns(u64 key, const KingPawnEntry& entry);
+
 private:
-    std::vector<PawnEntry> m_Entries;
+    LocklessTable<eval::PawnStructure> m_PawnEntries;
+    LocklessTable<KingPawnEntry> m_KingPawnEntries;
 };
 
-inline PawnTable::PawnTable()
-    : m_Entries(SIZE)
+inline PawnTable::PawnTable(i32 mb)
 {
+    resize(mb);
 }
 
-inline PawnEntry PawnTable::probe(ZKey pawnKey) const
+inline void PawnTable::resize(i32 mb)
 {
-    return m_Entries[pawnKey.value % SIZE];
+    usize bytes = static_cast<usize>(mb) * 1024 * 1024;
+    // king pawn entries are a lot smaller, and hit more often
+    m_PawnEntries.resize(bytes * 3 / 4);
+    m_KingPawnEntries.resize(bytes / 4);
 }
 
-inline void PawnTable::store(PawnEntry entry)
+inline void PawnTable::clear()
 {
-    m_Entries[entry.pawnKey.value % SIZE] = entry;
+    m_PawnEntries.clear();
+    m_KingPawnEntries.clear();
 }
 
-inline void PawnTable::clear()
+inline bool PawnTable::probe(ZKey pawnKey, eval::PawnStructure& pawnStructure) const
+{
+    return m_PawnEntries.probe(pawnKey.value, pawnStructure);
+}
+
+inline void PawnTable::store(ZKey pawnKey, const eval::PawnStructure& pawnStructure)
+{
+    m_PawnEntries.store(pawnKey.value, pawnStructure);
+}
+
+inline bool PawnTable::probeKingPawns(u64 key, KingPawnEntry& entry) const
+{
+    return m_KingPawnEntries.probe(key, entry);
+}
+
+inline void PawnTable::storeKingPawns(u64 key, const KingPawnEntry& entry)
 {
-    std::fill(m_Entries.begin(), m_Entries.end(), PawnEntry{});
+    m_KingPawnEntries.store(key, entry);
 }
@@ -1,4 +1,7 @@
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
+#include <stdexcept>
 #include <string>
 
 #include "attacks.h"
@@ -7,6 +10,8 @@
 #include "datagen/stats.h"
 #include "eval/endgame.h"
 #include "eval/eval.h"
+#include "eval/eval_params.h"
+#include "eval/nnue.h"
 #include "search_params.h"
 #include "sirius.h"
 #include "uci/uci.h"
@@ -17,6 +22,22 @@ int main(int argc, char** argv)
     cuckoo::init();
     search::init();
     eval::endgames::init();
+    eval::nnue::init();
+
+#ifdef RUNTIME_EVAL_WEIGHTS
+    if (const char* weightsFile = std::getenv("SIRIUS_EVAL_WEIGHTS"))
+    {
+        try
+        {
+            eval::loadEvalWeights(weightsFile);
+        }
+        catch (const std::runtime_error& e)
+        {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+    }
+#endif
 
     if (argc > 1 && std::string(argv[1]) == "bench")
     {
@@ -25,9 +46,44 @@ int main(int argc, char** argv)
         return 0;
     }
 
+    if (argc > 1 && std::string(argv[1]) == "evalbench")
+    {
+        runEvalBench(EVAL_BENCH_ITERATIONS);
+        return 0;
+    }
+
     if (argc > 2 && std::string(argv[1]) == "datastats")
     {
-        datagen::computeStats(std::string(argv[2]));
+        datagen::StatsConfig config = {};
+        config.dataFilename = argv[2];
+        config.format = datagen::StatsFormat::TEXT;
+        config.numThreads = 1;
+        config.json = false;
+        for (i32 i = 3; i < argc; i++)
+        {
+            std::string tok = argv[i];
+            if (tok == "format" && i + 1 < argc)
+            {
+                std::string format = argv[++i];
+                if (format == "viri")
+                    config.format = datagen::StatsFormat::VIRIFORMAT;
+                else if (format == "marlin")
+                    config.format = datagen::StatsFormat::MARLINFORMAT;
+                else if (format == "bullet")
+                    config.format = datagen::StatsFormat::BULLETFORMAT;
+                else
+                    config.format = datagen::StatsFormat::TEXT;
+            }
+            else if (tok == "threads" && i + 1 < argc)
+            {
+                config.numThreads = static_cast<u32>(std::max(std::atoi(argv[++i]), 1));
+            }
+            else if (tok == "json")
+            {
+                config.json = true;
+            }
+        }
+        datagen::computeStats(config);
         return 0;
     }
 
@@ -47,7 +103,6 @@ int main(int argc, char** argv)
 #endif
     {
         uci::UCI uci;
-        uci::uci = &uci;
         uci.run(mode);
     }
     return 0;
@@ -0,0 +1,465 @@
+#include "match.h"
+#include "datagen/datagen.h"
+#include "eval/nnue.h"
+#include "uci/fen.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+
+constexpr auto REPORT_INTERVAL = std::chrono::seconds(5);
+constexpr Duration MOVE_OVERHEAD = Duration(10);
+
+// results of a match from the point of view of the first engine
+struct MatchStats
+{
+    u32 wins = 0;
+    u32 draws = 0;
+    u32 losses = 0;
+    // the number of game pairs that the first engine scored 0, 1/2, 1, 3/2 and 2 points in
+    std::array<u32, 5> pentanomial = {};
+
+    u32 pairs() const
+    {
+        u32 total = 0;
+        for (u32 count : pentanomial)
+            total += count;
+        return total;
+    }
+
+    // mean and variance of the score of a pair, from 0 to 1
+    std::pair<f64, f64> pairScore() const
+    {
+        f64 n = static_cast<f64>(pairs());
+        f64 mean = 0;
+        for (usize i = 0; i < pentanomial.size(); i++)
+            mean += static_cast<f64>(pentanomial[i]) * static_cast<f64>(i) / 4.0;
+        mean /= n;
+
+        f64 variance = 0;
+        for (usize i = 0; i < pentanomial.size(); i++)
+        {
+            f64 diff = static_cast<f64>(i) / 4.0 - mean;
+            variance += static_cast<f64>(pentanomial[i]) * diff * diff;
+        }
+        variance /= n;
+        return {mean, variance};
+    }
+};
+
+f64 eloToScore(f64 elo)
+{
+    return 1.0 / (1.0 + std::pow(10.0, -elo / 400.0));
+}
+
+f64 scoreToElo(f64 score)
+{
+    // adding 0 turns -0 into 0
+    return -400.0 * std::log10(1.0 / score - 1.0) + 0.0;
+}
+
+// the normal approximation of the log likelihood ratio of the pentanomial results,
+// which is 0 until both the results and their variance are nonzero
+f64 sprtLLR(const MatchStats& stats, f64 elo0, f64 elo1)
+{
+    if (stats.pairs() == 0)
+        return 0;
+    auto [mean, variance] = stats.pairScore();
+    if (variance <= 0)
+        return 0;
+
+    f64 score0 = eloToScore(elo0);
+    f64 score1 = eloToScore(elo1);
+    return static_cast<f64>(stats.pairs()) * (score1 - score0) * (2 * mean - score0 - score1)
+        / (2 * variance);
+}
+
+// the elo and the half width of its 95% confidence interval, if the score isn't 0 or 1
+std::optional<std::pair<f64, f64>> eloEstimate(const MatchStats& stats)
+{
+    if (stats.pairs() == 0)
+        return std::nullopt;
+    auto [mean, variance] = stats.pairScore();
+    f64 margin = 1.96 * std::sqrt(variance / static_cast<f64>(stats.pairs()));
+    if (mean - margin <= 0 || mean + margin >= 1)
+        return std::nullopt;
+
+    f64 lower = scoreToElo(mean - margin);
+    f64 upper = scoreToElo(mean + margin);
+    return std::make_pair(scoreToElo(mean), (upper - lower) / 2);
+}
+
+struct ThreadStats
+{
+    std::atomic<u64> nodes = 0;
+    std::atomic<i64> searchNanos = 0;
+};
+
+// the searches of one side of the match, which all share the network and search params
+struct EngineSetup
+{
+    std::shared_ptr<const eval::nnue::Network> network;
+#ifdef EXTERNAL_TUNE
+    search::SearchParamValues params;
+#endif
+
+    void apply(search::Search& search) const
+    {
+        search.setNetwork(network);
+        search.setUseNNUE(network != nullptr);
+#ifdef EXTERNAL_TUNE
+        search.setSearchParams(params);
+#endif
+    }
+};
+
+std::optional<EngineSetup> setupEngine(const MatchEngine& engine)
+{
+    EngineSetup setup;
+    if (!engine.evalFile.empty())
+    {
+        try
+        {
+            setup.network = eval::nnue::loadNetwork(engine.evalFile);
+        }
+        catch (const std::runtime_error& e)
+        {
+            std::cout << e.what() << std::endl;
+            return std::nullopt;
+        }
+    }
+
+#ifdef EXTERNAL_TUNE
+    setup.params = search::searchParamValues();
+    for (const auto& [name, value] : engine.params)
+    {
+        auto& params = search::searchParams();
+        auto it = std::find_if(params.begin(), params.end(),
+            [&name](const search::SearchParam& param)
+            {
+                return param.name == name;
+            });
+        if (it == params.end())
+        {
+            std::cout << "Unknown search param " << name << std::endl;
+            return std::nullopt;
+        }
+        setup.params[static_cast<usize>(it - params.begin())] = value;
+    }
+#else
+    if (!engine.params.empty())
+    {
+        std::cout << "Search params can only be changed in builds with EXTERNAL_TUNE"
+                  << std::endl;
+        return std::nullopt;
+    }
+#endif
+    return setup;
+}
+
+void printEngine(const MatchEngine& engine, i32 idx)
+{
+    std::cout << "Engine " << idx << ": "
+              << (engine.evalFile.empty() ? "hand crafted eval" : engine.evalFile);
+    for (const auto& [name, value] : engine.params)
+        std::cout << ", " << name << '=' << value;
+    std::cout << std::endl;
+}
+
+}
+
+std::optional<Board> nextOpening(datagen::OpeningBook& book)
+{
+    for (;;)
+    {
+        usize idx = book.next();
+        if (idx == book.size())
+            return std::nullopt;
+
+        std::string fen = book.fen(idx);
+        if (book.verdict(idx) == datagen::OpeningBook::Verdict::UNKNOWN)
+        {
+            bool valid = uci::isValidFen(fen.c_str());
+            if (valid)
+            {
+                Board board;
+                board.setToFen(fen);
+                valid = datagen::gameResult(board) == datagen::GameResult::NON_TERMINAL;
+            }
+            book.setVerdict(idx,
+                valid ? datagen::OpeningBook::Verdict::ACCEPTED
+                      : datagen::OpeningBook::Verdict::REJECTED);
+            if (!valid)
+                continue;
+        }
+
+        Board board;
+        board.setToFen(fen);
+        return board;
+    }
+}
+
+PlayedGame playGame(
+    ColorArray<search::Search*> engines, const Board& opening, const GameLimits& limits)
+{
+    using namespace datagen;
+
+    SearchLimits searchLimits = {};
+    searchLimits.maxDepth = MAX_PLY;
+    searchLimits.maxNodes = limits.nodes;
+    searchLimits.clock.enabled = limits.nodes == 0;
+    searchLimits.clock.timeLeft = {limits.time, limits.time};
+    searchLimits.clock.increments = {limits.increment, limits.increment};
+    searchLimits.overhead = MOVE_OVERHEAD;
+
+    Board board = opening;
+    PlayedGame game = {};
+    game.result = marlinformat::WDL::DRAW;
+
+    i32 winPlies = 0;
+    i32 drawPlies = 0;
+    i32 lossPlies = 0;
+
+    for (;;)
+    {
+        GameResult result = gameResult(board);
+        if (result != GameResult::NON_TERMINAL)
+        {
+            if (result == GameResult::MATED)
+            {
+                game.result = board.sideToMove() == Color::WHITE ? marlinformat::WDL::BLACK_WIN
+                                                                 : marlinformat::WDL::WHITE_WIN;
+            }
+            break;
+        }
+
+        Color stm = board.sideToMove();
+        auto startTime = std::chrono::steady_clock::now();
+        SearchInfo info = engines[stm]->analysisSearch(searchLimits, board);
+        auto searchTime = std::chrono::steady_clock::now() - startTime;
+        game.searchTime += searchTime;
+        game.nodes += info.nodes;
+
+        if (searchLimits.clock.enabled)
+        {
+            Duration& timeLeft = searchLimits.clock.timeLeft[static_cast<i32>(stm)];
+            timeLeft -= std::chrono::duration_cast<Duration>(searchTime);
+            if (timeLeft < Duration(0))
+            {
+                game.result = stm == Color::WHITE ? marlinformat::WDL::BLACK_WIN
+                                                  : marlinformat::WDL::WHITE_WIN;
+                break;
+            }
+            timeLeft += limits.increment;
+        }
+
+        i32 score = stm == Color::WHITE ? info.score : -info.score;
+        if (isMateScore(score))
+        {
+            game.result = score > 0 ? marlinformat::WDL::WHITE_WIN : marlinformat::WDL::BLACK_WIN;
+            break;
+        }
+
+        board.makeMove(info.pv[0]);
+        game.plies++;
+
+        winPlies = score >= WIN_ADJ_THRESHOLD ? winPlies + 1 : 0;
+        lossPlies = score <= -WIN_ADJ_THRESHOLD ? lossPlies + 1 : 0;
+        if (std::abs(score) < DRAW_ADJ_THRESHOLD && game.plies >= DRAW_ADJ_MOVE_NUM * 2)
+            drawPlies++;
+        else
+            drawPlies = 0;
+
+        if (winPlies >= WIN_ADJ_PLIES)
+        {
+            game.result = marlinformat::WDL::WHITE_WIN;
+            break;
+        }
+        else if (lossPlies >= WIN_ADJ_PLIES)
+        {
+            game.result = marlinformat::WDL::BLACK_WIN;
+            break;
+        }
+        else if (drawPlies >= DRAW_ADJ_PLIES)
+        {
+            game.result = marlinformat::WDL::DRAW;
+            break;
+        }
+    }
+
+    return game;
+}
+
+void runMatch(const MatchConfig& config)
+{
+    datagen::OpeningBook book;
+    if (!book.open(config.openingsFilename, std::random_device()()))
+    {
+        std::cout << "Could not open book " << config.openingsFilename << std::endl;
+        return;
+    }
+
+    std::array<EngineSetup, 2> setups;
+    for (usize i = 0; i < setups.size(); i++)
+    {
+        auto setup = setupEngine(config.engines[i]);
+        if (!setup)
+            return;
+        setups[i] = std::move(*setup);
+    }
+
+    GameLimits limits = {};
+    limits.nodes = config.nodes;
+    limits.time = Duration(config.baseTime);
+    limits.increment = Duration(config.increment);
+
+    u32 numPairs = (config.numGames + 1) / 2;
+    printEngine(config.engines[0], 1);
+    printEngine(config.engines[1], 2);
+    std::cout << "Playing " << numPairs * 2 << " games from " << book.size() << " openings with "
+              << config.numThreads << " threads, ";
+    if (config.nodes > 0)
+        std::cout << config.nodes << " nodes per move" << std::endl;
+    else
+        std::cout << config.baseTime << "+" << config.increment << "ms" << std::endl;
+    std::cout << "SPRT of elo0 " << config.elo0 << " against elo1 " << config.elo1 << " with alpha "
+              << config.alpha << " and beta " << config.beta << std::endl;
+
+    f64 lowerBound = std::log(config.beta / (1 - config.alpha));
+    f64 upperBound = std::log((1 - config.beta) / config.alpha);
+
+    MatchStats stats;
+    std::vector<ThreadStats> threadStats(config.numThreads);
+    std::mutex mutex;
+    std::atomic<u32> nextPair = 0;
+    std::atomic_bool stop = false;
+    auto startTime = std::chrono::steady_clock::now();
+    auto lastReport = startTime;
+
+    auto printReport = [&]()
+    {
+        auto now = std::chrono::steady_clock::now();
+        f64 seconds = std::chrono::duration<f64>(now - startTime).count();
+        u32 games = stats.wins + stats.draws + stats.losses;
+
+        std::cout << "Games: " << games << ", +" << stats.wins << " =" << stats.draws << " -"
+                  << stats.losses << ", pentanomial [";
+        for (usize i = 0; i < stats.pentanomial.size(); i++)
+            std::cout << (i > 0 ? ", " : "") << stats.pentanomial[i];
+        std::cout << "]" << std::endl;
+
+        std::cout << std::fixed << std::setprecision(2);
+        if (auto elo = eloEstimate(stats))
+            std::cout << "Elo: " << elo->first << " +/- " << elo->second;
+        else
+            std::cout << "Elo: -";
+        std::cout << ", LLR: " << sprtLLR(stats, config.elo0, config.elo1) << " (" << lowerBound
+                  << ", " << upperBound << ")" << std::endl;
+
+        std::cout << static_cast<f64>(games) / std::max(seconds, 1e-3)
+                  << " games/s, thread utilization:" << std::setprecision(1);
+        u64 nodes = 0;
+        f64 searchSeconds = 0;
+        for (const auto& thread : threadStats)
+        {
+            f64 threadSeconds = static_cast<f64>(thread.searchNanos.load()) / 1e9;
+            nodes += thread.nodes.load();
+            searchSeconds += threadSeconds;
+            std::cout << ' ' << 100.0 * threadSeconds / std::max(seconds, 1e-3) << '%';
+        }
+        u64 nps = static_cast<u64>(static_cast<f64>(nodes) / std::max(searchSeconds, 1e-3));
+        std::cout << ", " << nps << " nps per thread" << std::endl;
+        std::cout << std::defaultfloat << std::setprecision(6);
+        lastReport = now;
+    };
+
+    {
+        std::vector<std::jthread> threads;
+        threads.reserve(config.numThreads);
+        for (u32 i = 0; i < config.numThreads; i++)
+        {
+            threads.emplace_back(
+                [&, i]()
+                {
+                    std::array<search::Search, 2> searches = {
+                        search::Search(config.hashMB), search::Search(config.hashMB)};
+                    for (usize j = 0; j < searches.size(); j++)
+                        setups[j].apply(searches[j]);
+
+                    while (!stop && nextPair.fetch_add(1) < numPairs)
+                    {
+                        std::optional<Board> opening = nextOpening(book);
+                        if (!opening)
+                        {
+                            std::unique_lock<std::mutex> lock(mutex);
+                            if (!stop.exchange(true))
+                                std::cout << "No valid openings in " << config.openingsFilename
+                                          << std::endl;
+                            return;
+                        }
+
+                        // the first engine's points in half points
+                        i32 pairPoints = 0;
+                        for (Color firstColor : {Color::WHITE, Color::BLACK})
+                        {
+                            for (auto& search : searches)
+                                search.newGame();
+                            ColorArray<search::Search*> engines;
+                            engines[firstColor] = &searches[0];
+                            engines[~firstColor] = &searches[1];
+
+                            PlayedGame game = playGame(engines, *opening, limits);
+                            threadStats[i].nodes += game.nodes;
+                            threadStats[i].searchNanos +=
+                                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                    game.searchTime)
+                                    .count();
+
+                            i32 whitePoints = static_cast<i32>(game.result);
+                            i32 points =
+                                firstColor == Color::WHITE ? whitePoints : 2 - whitePoints;
+                            pairPoints += points;
+
+                            std::unique_lock<std::mutex> lock(mutex);
+                            if (points == 2)
+                                stats.wins++;
+                            else if (points == 1)
+                                stats.draws++;
+                            else
+                                stats.losses++;
+                        }
+
+                        std::unique_lock<std::mutex> lock(mutex);
+                        stats.pentanomial[pairPoints]++;
+                        f64 llr = sprtLLR(stats, config.elo0, config.elo1);
+                        if (stop)
+                            return;
+                        if (llr <= lowerBound || llr >= upperBound)
+                            stop = true;
+                        if (std::chrono::steady_clock::now() - lastReport >= REPORT_INTERVAL)
+                            printReport();
+                    }
+                });
+        }
+    }
+
+    printReport();
+    f64 llr = sprtLLR(stats, config.elo0, config.elo1);
+    if (llr >= upperBound)
+        std::cout << "H1 was accepted" << std::endl;
+    else if (llr <= lowerBound)
+        std::cout << "H0 was accepted" << std::endl;
+    else
+        std::cout << "SPRT did not finish" << std::endl;
+}
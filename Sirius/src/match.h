@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "board.h"
+#include "datagen/opening_book.h"
+#include "datagen/marlinformat.h"
+#include "defs.h"
+#include "search.h"
+#include "util/enum_array.h"
+
+// one of the two sides of a match
+struct MatchEngine
+{
+    // the network to use, or empty for the hand crafted eval
+    std::string evalFile;
+    // overrides of the search params by name, which need EXTERNAL_TUNE
+    std::vector<std::pair<std::string, i32>> params;
+};
+
+struct MatchConfig
+{
+    // EPD or FEN file with the openings, which are played in a random order
+    std::string openingsFilename;
+    std::array<MatchEngine, 2> engines;
+    // nodes per move, or 0 to play with a clock of baseTime plus increment per move
+    u64 nodes;
+    i64 baseTime;
+    i64 increment;
+    // rounded up to a whole number of game pairs
+    u32 numGames;
+    u32 numThreads;
+    // for each engine of each thread
+    i32 hashMB;
+    // bounds in logistic elo and error rates of the SPRT, which ends the match early
+    f64 elo0;
+    f64 elo1;
+    f64 alpha;
+    f64 beta;
+};
+
+// the limits of the moves of a game, either a node limit, or a clock for each
+// side that starts at time and gains increment after each move
+struct GameLimits
+{
+    u64 nodes;
+    Duration time;
+    Duration increment;
+};
+
+struct PlayedGame
+{
+    marlinformat::WDL result;
+    u32 plies;
+    u64 nodes;
+    // time spent searching, which excludes adjudication and move generation
+    std::chrono::steady_clock::duration searchTime;
+};
+
+// the next opening of the book that is a valid position with a legal move, or
+// nothing once every opening has been rejected
+std::optional<Board> nextOpening(datagen::OpeningBook& book);
+
+// plays a game from the opening with engines[Color::WHITE] as white. Games are adjudicated
+// like datagen games, and a side that runs out of time on its clock loses
+PlayedGame playGame(
+    ColorArray<search::Search*> engines, const Board& opening, const GameLimits& limits);
+
+// plays game pairs with the colours reversed between the two engines, each game on one
+// thread, and reports the score, elo and SPRT of the first engine as they are played
+void runMatch(const MatchConfig& config);
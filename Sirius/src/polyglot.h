@@ -0,0 +1,58 @@
+#pragma once
+
+#include "board.h"
+#include "defs.h"
+#include "movegen.h"
+#include "util/mapped_file.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+namespace polyglot
+{
+
+// an entry of a polyglot book, which are stored big endian and sorted by key
+struct Entry
+{
+    u64 key;
+    u16 move;
+    u16 weight;
+    u32 learn;
+};
+
+// the polyglot zobrist key of the position, which only includes the en passant
+// square if a pawn of the side to move could capture on it
+u64 hashKey(const Board& board);
+
+// castling is stored as the king capturing its own rook, the same as Sirius' moves
+u16 encodeMove(Move move);
+// the legal move that the polyglot move refers to, or a nullmove if there isn't one
+Move decodeMove(u16 move, const MoveList& legalMoves);
+
+// sorts the entries by key and then by decreasing weight and writes them
+void writeBook(const std::string& filename, std::vector<Entry>& entries);
+
+// a polyglot book, which is mapped and searched in place
+class Book
+{
+public:
+    // false if the file can't be mapped or isn't a whole number of entries
+    bool open(const std::string& filename);
+    void close();
+    bool isOpen() const;
+
+    // the entries for the position, which are next to each other in the file
+    std::vector<Entry> probe(const Board& board) const;
+    // a legal book move for the position, chosen either with a probability proportional
+    // to its weight or as the highest weighted move, or a nullmove if there isn't one
+    Move pickMove(const Board& board, const MoveList& legalMoves, bool bestMove);
+
+private:
+    Entry entry(usize idx) const;
+
+    MappedFile m_File;
+    std::mt19937_64 m_Rng{std::random_device{}()};
+};
+
+}
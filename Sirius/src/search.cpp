@@ -3,7 +3,6 @@
 #include "move_ordering.h"
 #include "movegen.h"
 #include "search_params.h"
-#include "uci/uci.h"
 
 #include <algorithm>
 #include <climits>
@@ -29,7 +28,12 @@ MultiArray<i32, 64, 64> genLMRTable()
     return lmrTable;
 }
 
+#ifdef EXTERNAL_TUNE
+// generated from the params of each thread
+thread_local MultiArray<i32, 64, 64> lmrTable = genLMRTable();
+#else
 MultiArray<i32, 64, 64> lmrTable = {};
+#endif
 
 void init()
 {
@@ -135,9 +139,9 @@ void Search::newGame()
     {
         thread->reset();
         thread->history.clear();
-        thread->pawnTable.clear();
     }
     m_TT.reset(m_Threads.size());
+    m_PawnTable.clear();
 }
 
 void Search::run(const SearchLimits& limits, const Board& board)
@@ -152,6 +156,7 @@ void Search::run(const SearchLimits& limits, const Board& board)
 
     m_ShouldStop.store(false, std::memory_order_relaxed);
 
+    loadSearchParams();
     m_TimeMan.setLimits(limits, board.sideToMove());
     m_TimeMan.startSearch();
 
@@ -175,6 +180,14 @@ void Search::stop()
     }
 }
 
+void Search::wait()
+{
+    for (auto& thread : m_Threads)
+    {
+        thread->wait();
+    }
+}
+
 void Search::setThreads(i32 count)
 {
     if (static_cast<i32>(m_Threads.size()) != count)
@@ -215,6 +228,13 @@ void Search::joinThreads()
     }
 }
 
+void Search::loadSearchParams() const
+{
+#ifdef EXTERNAL_TUNE
+    useSearchParams(m_SearchParams.empty() ? searchParamValues() : m_SearchParams);
+#endif
+}
+
 void Search::threadLoop(SearchThread& thread)
 {
     while (true)
@@ -238,7 +258,8 @@ void Search::threadLoop(SearchThread& thread)
             case WakeFlag::QUIT:
                 return;
             case WakeFlag::SEARCH:
-                iterDeep(thread, thread.isMainThread());
+                loadSearchParams();
+                iterDeep(thread, thread.isMainThread() && m_Reporter);
                 break;
             case WakeFlag::NONE:
                 // unreachable;
@@ -286,7 +307,7 @@ void Search::unmakeNullMove(SearchThread& thread, SearchStack* stack)
     stack->contCorrEntry = nullptr;
 }
 
-void Search::reportUCIInfo(const SearchThread& thread, i32 multiPVIdx, i32 depth) const
+SearchInfo Search::searchInfo(const SearchThread& thread, i32 multiPVIdx, i32 depth) const
 {
     SearchInfo info;
     info.nodes = 0;
@@ -300,7 +321,12 @@ void Search::reportUCIInfo(const SearchThread& thread, i32 multiPVIdx, i32 depth
     info.score = thread.rootMoves[multiPVIdx].displayScore;
     info.lowerbound = thread.rootMoves[multiPVIdx].lowerbound;
     info.upperbound = thread.rootMoves[multiPVIdx].upperbound;
-    uci::uci->reportSearchInfo(info);
+    return info;
+}
+
+void Search::reportInfo(const SearchThread& thread, i32 multiPVIdx, i32 depth) const
+{
+    m_Reporter->reportSearchInfo(searchInfo(thread, multiPVIdx, depth));
 }
 
 std::pair<i32, Move> Search::iterDeep(SearchThread& thread, bool report)
@@ -309,9 +335,20 @@ std::pair<i32, Move> Search::iterDeep(SearchThread& thread, bool report)
     i32 score = 0;
 
     thread.reset();
-    thread.evalState.init(thread.board, thread.pawnTable);
+    thread.evalState.init(thread.board, m_PawnTable, m_UseNNUE ? m_Network.get() : nullptr);
     thread.initRootMoves();
 
+    // checkmate or stalemate, which is reported as a null move from this
+    // thread like any other search
+    if (thread.rootMoves.empty())
+    {
+        if (thread.isMainThread())
+            m_ShouldStop.store(true, std::memory_order_relaxed);
+        if (report)
+            m_Reporter->reportBestMove(Move::nullmove());
+        return {thread.board.checkers().any() ? -SCORE_MATE : SCORE_DRAW, Move::nullmove()};
+    }
+
     for (i32 depth = 1; depth <= maxDepth; depth++)
     {
         thread.rootDepth = depth;
@@ -319,7 +356,7 @@ std::pair<i32, Move> Search::iterDeep(SearchThread& thread, bool report)
         i32 searchScore = aspWindows(thread, depth, score, report);
         thread.sortRootMoves();
         if (report)
-            reportUCIInfo(thread, 0, depth);
+            reportInfo(thread, 0, depth);
         if (m_ShouldStop)
             break;
         score = searchScore;
@@ -334,7 +371,7 @@ std::pair<i32, Move> Search::iterDeep(SearchThread& thread, bool report)
         m_ShouldStop.store(true, std::memory_order_relaxed);
 
     if (report)
-        uci::uci->reportBestMove(thread.rootMoves[0].move);
+        m_Reporter->reportBestMove(thread.rootMoves[0].move);
 
     return {score, thread.rootMoves[0].move};
 }
@@ -367,7 +404,7 @@ i32 Search::aspWindows(SearchThread& thread, i32 depth, i32 prevScore, bool repo
 
         if (report && (searchScore <= alpha || searchScore >= beta)
             && m_TimeMan.elapsed() > ASP_WIDEN_REPORT_DELAY)
-            reportUCIInfo(thread, 0, depth);
+            reportInfo(thread, 0, depth);
 
         if (searchScore <= alpha)
         {
@@ -398,6 +435,7 @@ BenchData Search::benchSearch(i32 depth, const Board& board)
     thread->limits = limits;
     thread->board = board;
 
+    loadSearchParams();
     m_TimeMan.setLimits(limits, board.sideToMove());
     m_TimeMan.startSearch();
 
@@ -416,6 +454,7 @@ std::pair<i32, Move> Search::datagenSearch(const SearchLimits& limits, const Boa
     std::unique_ptr<SearchThread> thread = std::make_unique<SearchThread>(0, std::thread());
     thread->limits = limits;
     thread->board = board;
+    loadSearchParams();
     m_TimeMan.setLimits(limits, board.sideToMove());
     m_TimeMan.startSearch();
 
@@ -424,6 +463,27 @@ std::pair<i32, Move> Search::datagenSearch(const SearchLimits& limits, const Boa
     return iterDeep(*thread, false);
 }
 
+SearchInfo Search::analysisSearch(const SearchLimits& limits, const Board& board)
+{
+    std::unique_ptr<SearchThread> thread = std::make_unique<SearchThread>(0, std::thread());
+    thread->limits = limits;
+    thread->board = board;
+    loadSearchParams();
+    m_TimeMan.setLimits(limits, board.sideToMove());
+    m_TimeMan.startSearch();
+
+    m_ShouldStop.store(false, std::memory_order_relaxed);
+
+    iterDeep(*thread, false);
+
+    // the thread isn't one of m_Threads, so its nodes aren't counted by searchInfo
+    SearchInfo info = searchInfo(*thread, 0, thread->rootDepth);
+    info.nodes = thread->nodes;
+    if (info.pv.empty())
+        info.pv.push_back(thread->rootMoves[0].move);
+    return info;
+}
+
 i32 Search::search(SearchThread& thread, i32 depth, SearchStack* stack, i32 alpha, i32 beta,
     bool pvNode, bool cutnode)
 {
@@ -494,7 +554,8 @@ i32 Search::search(SearchThread& thread, i32 depth, SearchStack* stack, i32 alph
         }
         else
         {
-            rawStaticEval = ttHit ? ttData.staticEval : eval::evaluate(board, &thread);
+            rawStaticEval = ttHit && ttData.evalExact ? ttData.staticEval
+                                                      : eval::evaluate(board, &thread);
             // Correction history(~104 elo)
             stack->staticEval = history.correctStaticEval(board, rawStaticEval, stack, rootPly);
             stack->eval = stack->staticEval;
@@ -606,8 +667,8 @@ i32 Search::search(SearchThread& thread, i32 depth, SearchStack* stack, i32 alph
 
                 if (score >= probcutBeta)
                 {
-                    m_TT.store(board.zkey(), rootPly, probcutDepth + 1, score, rawStaticEval, move,
-                        ttPV, TTEntry::Bound::LOWER_BOUND);
+                    m_TT.store(board.zkey(), rootPly, probcutDepth + 1, score, rawStaticEval, true,
+                        move, ttPV, TTEntry::Bound::LOWER_BOUND);
                     return score;
                 }
             }
@@ -903,7 +964,8 @@ i32 Search::search(SearchThread& thread, i32 depth, SearchStack* stack, i32 alph
             && !(bound == TTEntry::Bound::UPPER_BOUND && stack->staticEval <= bestScore))
             history.updateCorrHist(board, bestScore - stack->staticEval, depth, stack, rootPly);
 
-        m_TT.store(board.zkey(), rootPly, depth, bestScore, rawStaticEval, bestMove, ttPV, bound);
+        m_TT.store(
+            board.zkey(), rootPly, depth, bestScore, rawStaticEval, true, bestMove, ttPV, bound);
     }
 
     return bestScore;
@@ -936,6 +998,7 @@ i32 Search::qsearch(SearchThread& thread, SearchStack* stack, i32 alpha, i32 bet
 
     bool inCheck = board.checkers().any();
     i32 rawStaticEval = SCORE_NONE;
+    bool evalExact = true;
 
     if (inCheck)
     {
@@ -944,7 +1007,14 @@ i32 Search::qsearch(SearchThread& thread, SearchStack* stack, i32 alpha, i32 bet
     }
     else
     {
-        rawStaticEval = ttHit ? ttData.staticEval : eval::evaluate(board, &thread);
+        // lazy eval in non pv nodes, since only the stand pat cares about the exact value
+        if (ttHit && ttData.evalExact)
+            rawStaticEval = ttData.staticEval;
+        else if (!pvNode)
+            rawStaticEval =
+                eval::evaluateLazy(board, &thread, alpha, beta, lazyEvalMargin, evalExact);
+        else
+            rawStaticEval = eval::evaluate(board, &thread);
         // Correction history(~104 elo)
         stack->staticEval = inCheck
             ? SCORE_NONE
@@ -962,8 +1032,8 @@ i32 Search::qsearch(SearchThread& thread, SearchStack* stack, i32 alpha, i32 bet
     if (stack->eval >= beta)
     {
         if (!ttHit)
-            m_TT.store(board.zkey(), rootPly, 0, stack->eval, rawStaticEval, Move::nullmove(), ttPV,
-                TTEntry::Bound::LOWER_BOUND);
+            m_TT.store(board.zkey(), rootPly, 0, stack->eval, rawStaticEval, evalExact,
+                Move::nullmove(), ttPV, TTEntry::Bound::LOWER_BOUND);
         return stack->eval;
     }
     if (stack->eval > alpha)
@@ -1042,7 +1112,8 @@ i32 Search::qsearch(SearchThread& thread, SearchStack* stack, i32 alpha, i32 bet
     if (inCheck && movesPlayed == 0)
         return -SCORE_MATE + rootPly;
 
-    m_TT.store(board.zkey(), rootPly, 0, bestScore, rawStaticEval, bestMove, ttPV, bound);
+    m_TT.store(
+        board.zkey(), rootPly, 0, bestScore, rawStaticEval, evalExact, bestMove, ttPV, bound);
 
     return bestScore;
 }
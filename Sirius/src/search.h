@@ -5,6 +5,7 @@
 #include "eval/eval_state.h"
 #include "eval/pawn_table.h"
 #include "history.h"
+#include "search_params.h"
 #include "time_man.h"
 #include "tt.h"
 
@@ -12,6 +13,7 @@
 #include <atomic>
 #include <condition_variable>
 #include <deque>
+#include <memory>
 #include <mutex>
 #include <thread>
 #include <vector>
@@ -87,6 +89,17 @@ inline RootMove::RootMove(Move move)
 {
 }
 
+// receives the info and best move of searches started by Search::run, which are called from
+// the main search thread, so implementations have to synchronize with their own threads
+class SearchReporter
+{
+public:
+    virtual ~SearchReporter() = default;
+
+    virtual void reportSearchInfo(const SearchInfo& info) const = 0;
+    virtual void reportBestMove(Move bestMove) const = 0;
+};
+
 struct SearchThread
 {
     SearchThread(u32 id, std::thread&& thread);
@@ -127,7 +140,6 @@ struct SearchThread
     std::vector<RootMove> rootMoves;
     std::array<SearchStack, MAX_PLY + 1> stack;
     History history;
-    PawnTable pawnTable;
     eval::EvalState evalState;
 };
 
@@ -141,21 +153,63 @@ public:
 
     void run(const SearchLimits& limits, const Board& board);
     void stop();
+    // blocks until the search in progress finishes by itself
+    void wait();
     void setThreads(i32 count);
     bool searching() const;
     BenchData benchSearch(i32 depth, const Board& board);
     std::pair<i32, Move> datagenSearch(const SearchLimits& limits, const Board& board);
+    // searches on the calling thread like datagenSearch, and returns the info of the last
+    // depth, with the best move first in the pv. The position must have a legal move
+    SearchInfo analysisSearch(const SearchLimits& limits, const Board& board);
 
     void setTTSize(i32 mb)
     {
         m_TT.resize(mb, m_Threads.size());
     }
 
+    void setPawnTableSize(i32 mb)
+    {
+        m_PawnTable.resize(mb);
+    }
+
+    void setNetwork(std::shared_ptr<const eval::nnue::Network> network)
+    {
+        m_Network = std::move(network);
+    }
+
+    const eval::nnue::Network* network() const
+    {
+        return m_Network.get();
+    }
+
+    void setUseNNUE(bool useNNUE)
+    {
+        m_UseNNUE = useNNUE;
+    }
+
+    // searches started by run only report anything if there is a reporter
+    void setReporter(const SearchReporter* reporter)
+    {
+        m_Reporter = reporter;
+    }
+
+#ifdef EXTERNAL_TUNE
+    // the search params of this search, or empty for the values set with setoption
+    void setSearchParams(SearchParamValues values)
+    {
+        m_SearchParams = std::move(values);
+    }
+#endif
+
 private:
     void joinThreads();
     void threadLoop(SearchThread& thread);
+    // makes the calling thread use the search params of this search
+    void loadSearchParams() const;
 
-    void reportUCIInfo(const SearchThread& thread, i32 multiPVIdx, i32 depth) const;
+    SearchInfo searchInfo(const SearchThread& thread, i32 multiPVIdx, i32 depth) const;
+    void reportInfo(const SearchThread& thread, i32 multiPVIdx, i32 depth) const;
 
     std::pair<i32, Move> iterDeep(SearchThread& thread, bool report);
     i32 aspWindows(SearchThread& thread, i32 depth, i32 prevScore, bool report);
@@ -171,10 +225,17 @@ private:
 
     std::atomic_bool m_ShouldStop;
     TT m_TT;
+    PawnTable m_PawnTable;
+    std::shared_ptr<const eval::nnue::Network> m_Network;
+    bool m_UseNNUE = false;
+    const SearchReporter* m_Reporter = nullptr;
     TimeManager m_TimeMan;
     std::deque<BoardState> m_States;
 
     std::vector<std::unique_ptr<SearchThread>> m_Threads;
+#ifdef EXTERNAL_TUNE
+    SearchParamValues m_SearchParams;
+#endif
 };
 
 }
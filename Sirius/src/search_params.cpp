@@ -21,14 +21,41 @@ std::deque<SearchParam>& searchParams()
     return params;
 }
 
-SearchParam& addSearchParam(
-    std::string name, i32 value, i32 min, i32 max, i32 step, std::function<void()> callback)
+SearchParam& addSearchParam(std::string name, i32 value, i32 min, i32 max, i32 step,
+    i32& (*threadValue)(), std::function<void()> callback)
 {
-    searchParams().push_back({name, value, value, min, max, step, callback});
+    searchParams().push_back({name, value, value, min, max, step, threadValue, callback});
     SearchParam& param = searchParams().back();
     return param;
 }
 
+SearchParamValues searchParamValues()
+{
+    SearchParamValues values;
+    for (const auto& param : searchParams())
+        values.push_back(param.value);
+    return values;
+}
+
+void useSearchParams(const SearchParamValues& values)
+{
+    std::vector<const std::function<void()>*> callbacks;
+    for (usize i = 0; i < values.size(); i++)
+    {
+        const SearchParam& param = searchParams()[i];
+        i32& value = param.threadValue();
+        if (value == values[i])
+            continue;
+        value = values[i];
+        if (param.callback)
+            callbacks.push_back(&param.callback);
+    }
+
+    // callbacks can depend on several params, so they only run once every param is set
+    for (const auto* callback : callbacks)
+        (*callback)();
+}
+
 void printWeatherFactoryConfig()
 {
     std::cout << "{\n";
@@ -60,7 +87,11 @@ void printOpenBenchConfig()
 
 #endif
 
+#ifdef EXTERNAL_TUNE
+extern thread_local MultiArray<i32, 64, 64> lmrTable;
+#else
 extern MultiArray<i32, 64, 64> lmrTable;
+#endif
 
 void updateLmrTable()
 {
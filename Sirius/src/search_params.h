@@ -4,6 +4,7 @@
 #include <deque>
 #include <functional>
 #include <string>
+#include <vector>
 
 #include "defs.h"
 
@@ -15,27 +16,39 @@ namespace search
 struct SearchParam
 {
     std::string name;
+    // the value set with setoption, which searches without values of their own use
     i32 value;
     i32 defaultValue;
     i32 min;
     i32 max;
     i32 step;
+    // the copy of the param that searches on the calling thread read
+    i32& (*threadValue)();
+    // run on a thread after its copy changes
     std::function<void()> callback;
 };
 
+// the values of every param, in the order of searchParams()
+using SearchParamValues = std::vector<i32>;
+
 std::deque<SearchParam>& searchParams();
 SearchParam& addSearchParam(std::string name, i32 value, i32 min, i32 max, i32 step,
-    std::function<void()> callback = std::function<void()>());
+    i32& (*threadValue)(), std::function<void()> callback = std::function<void()>());
+// the values set with setoption
+SearchParamValues searchParamValues();
+// sets the params of the calling thread, so that searches can run with different
+// values at the same time, and runs the callbacks of the params that changed
+void useSearchParams(const SearchParamValues& values);
 void printWeatherFactoryConfig();
 void printOpenBenchConfig();
 void updateLmrTable();
 
 #define SEARCH_PARAM(name, val, min, max, step) \
-    inline SearchParam& name##Param = addSearchParam(#name, val, min, max, step); \
-    inline const i32& name = name##Param.value
+    SEARCH_PARAM_CALLBACK(name, val, min, max, step, std::function<void()>())
 #define SEARCH_PARAM_CALLBACK(name, val, min, max, step, callback) \
-    inline SearchParam& name##Param = addSearchParam(#name, val, min, max, step, callback); \
-    inline const i32& name = name##Param.value
+    inline thread_local i32 name = val; \
+    inline SearchParam& name##Param = addSearchParam( \
+        #name, val, min, max, step, []() -> i32& { return name; }, callback)
 #else
 #define SEARCH_PARAM(name, val, min, max, step) constexpr i32 name = val;
 #define SEARCH_PARAM_CALLBACK(name, val, min, max, step, callback) \
@@ -178,4 +191,7 @@ SEARCH_PARAM(doShallowerMargin, 8, 2, 15, 1);
 
 SEARCH_PARAM(qsFpMargin, 78, 0, 250, 16);
 
+// 0 turns the lazy eval off, so that qsearch always uses the full eval
+SEARCH_PARAM(lazyEvalMargin, 500, 0, 1000, 50);
+
 }
@@ -11,3 +11,4 @@
 #include "defs.h"
 
 static constexpr i32 BENCH_DEPTH = 14;
+static constexpr i32 EVAL_BENCH_ITERATIONS = 2000;
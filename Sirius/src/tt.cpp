@@ -126,6 +126,7 @@ bool TT::probe(ZKey key, i32 ply, ProbedTTData& ttData)
 
     ttData.score = retrieveScore(entry.score, ply);
     ttData.staticEval = entry.staticEval;
+    ttData.evalExact = entry.evalExact();
     ttData.move = entry.bestMove;
     ttData.depth = entry.depth;
     ttData.bound = entry.bound();
@@ -134,8 +135,8 @@ bool TT::probe(ZKey key, i32 ply, ProbedTTData& ttData)
     return true;
 }
 
-void TT::store(ZKey key, i32 ply, i32 depth, i32 score, i32 staticEval, Move move, bool pv,
-    TTEntry::Bound bound)
+void TT::store(ZKey key, i32 ply, i32 depth, i32 score, i32 staticEval, bool evalExact,
+    Move move, bool pv, TTEntry::Bound bound)
 {
     // 16 bit keys to save space
     // idea from JW
@@ -173,7 +174,7 @@ void TT::store(ZKey key, i32 ply, i32 depth, i32 score, i32 staticEval, Move mov
         replace.staticEval = staticEval;
         replace.depth = static_cast<u8>(depth);
         replace.score = static_cast<i16>(storeScore(score, ply));
-        replace.setGenBoundPV(pv, static_cast<u8>(m_CurrAge), bound);
+        replace.setGenBoundPV(pv, evalExact, static_cast<u8>(m_CurrAge), bound);
     }
 }
 
@@ -16,7 +16,7 @@ struct TTEntry
     i16 staticEval;
     Move bestMove;
     u8 depth;
-    // 2 bits bound, 1 bit pv, 5 bits gen
+    // 2 bits bound, 1 bit pv, 1 bit exact eval, 4 bits gen
     u8 genBoundPV;
 
     enum class Bound : u8
@@ -32,9 +32,15 @@ struct TTEntry
         return (genBoundPV >> 2) & 1;
     }
 
+    // false if staticEval is a lazy eval, which search and qsearch both recompute
+    bool evalExact() const
+    {
+        return (genBoundPV >> 3) & 1;
+    }
+
     u8 gen() const
     {
-        return genBoundPV >> 3;
+        return genBoundPV >> 4;
     }
 
     Bound bound() const
@@ -42,9 +48,9 @@ struct TTEntry
         return static_cast<Bound>(genBoundPV & 3);
     }
 
-    void setGenBoundPV(bool pv, u8 gen, Bound bound)
+    void setGenBoundPV(bool pv, bool evalExact, u8 gen, Bound bound)
     {
-        genBoundPV = static_cast<i32>(bound) | (pv << 2) | (gen << 3);
+        genBoundPV = static_cast<i32>(bound) | (pv << 2) | (evalExact << 3) | (gen << 4);
     }
 };
 
@@ -64,6 +70,7 @@ struct ProbedTTData
 {
     i32 score;
     i32 staticEval;
+    bool evalExact;
     Move move;
     i32 depth;
     bool pv;
@@ -73,7 +80,7 @@ struct ProbedTTData
 class TT
 {
 public:
-    static constexpr i32 GEN_CYCLE_LENGTH = 1 << 5;
+    static constexpr i32 GEN_CYCLE_LENGTH = 1 << 4;
 
     TT(usize size);
     ~TT();
@@ -84,8 +91,8 @@ public:
     TT& operator=(const TT&) = delete;
 
     bool probe(ZKey key, i32 ply, ProbedTTData& ttData);
-    void store(ZKey key, i32 ply, i32 depth, i32 score, i32 staticEval, Move move, bool pv,
-        TTEntry::Bound type);
+    void store(ZKey key, i32 ply, i32 depth, i32 score, i32 staticEval, bool evalExact, Move move,
+        bool pv, TTEntry::Bound type);
     i32 quality(i32 age, i32 depth) const;
     void prefetch(ZKey key) const;
 
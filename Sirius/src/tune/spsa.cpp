@@ -0,0 +1,278 @@
+#include "spsa.h"
+
+#include <iostream>
+
+#ifdef EXTERNAL_TUNE
+
+#include "../match.h"
+#include "../search.h"
+#include "../search_params.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#endif
+
+namespace tune
+{
+
+#ifndef EXTERNAL_TUNE
+
+void runSpsa(const SpsaConfig& config)
+{
+    std::cout << "SPSA requires a build with EXTERNAL_TUNE defined" << std::endl;
+}
+
+#else
+
+constexpr u32 SAVE_INTERVAL = 100;
+
+// the usual SPSA gain sequence exponents, and the stability constant as a
+// fraction of the iterations
+constexpr f64 SPSA_ALPHA = 0.602;
+constexpr f64 SPSA_GAMMA = 0.101;
+constexpr f64 SPSA_A_RATIO = 0.1;
+
+struct SpsaParam
+{
+    // index in search::searchParams()
+    usize idx;
+    f64 value;
+    // the perturbation at the first iteration and the numerator of the learning rate,
+    // which both decay with the iterations
+    f64 c;
+    f64 a;
+};
+
+struct SpsaState
+{
+    std::vector<SpsaParam> params;
+    u32 iterations = 0;
+};
+
+void saveState(const SpsaConfig& config, const SpsaState& state)
+{
+    // written next to the output and then renamed, so an interrupted save keeps the last one
+    std::string tmpFilename = config.outputFilename + ".tmp";
+    {
+        std::ofstream file(tmpFilename);
+        file << "iterations " << state.iterations << '\n';
+        file.precision(10);
+        for (const auto& param : state.params)
+            file << search::searchParams()[param.idx].name << ' ' << param.value << '\n';
+    }
+    std::error_code error;
+    std::filesystem::rename(tmpFilename, config.outputFilename, error);
+    if (error)
+        std::cout << "Could not write " << config.outputFilename << std::endl;
+}
+
+// loads the iteration count and the values of the params that are tuned
+bool loadState(const SpsaConfig& config, SpsaState& state)
+{
+    std::ifstream file(config.outputFilename);
+    if (!file.is_open())
+        return false;
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::istringstream stream(line);
+        std::string name;
+        stream >> name;
+        if (name == "iterations")
+        {
+            stream >> state.iterations;
+            continue;
+        }
+
+        f64 value;
+        if (!(stream >> value))
+            continue;
+        for (auto& param : state.params)
+        {
+            if (search::searchParams()[param.idx].name == name)
+                param.value = value;
+        }
+    }
+    return true;
+}
+
+void printParams(const SpsaState& state)
+{
+    for (const auto& param : state.params)
+    {
+        std::cout << search::searchParams()[param.idx].name << ", "
+                  << static_cast<i32>(std::round(param.value)) << std::endl;
+    }
+}
+
+void runSpsa(const SpsaConfig& config)
+{
+    datagen::OpeningBook book;
+    if (!book.open(config.openingsFilename, std::random_device()()))
+    {
+        std::cout << "Could not open book " << config.openingsFilename << std::endl;
+        return;
+    }
+
+    auto& searchParams = search::searchParams();
+    SpsaState state;
+    f64 iterations = static_cast<f64>(config.iterations);
+    for (usize i = 0; i < searchParams.size(); i++)
+    {
+        const auto& param = searchParams[i];
+        if (!config.paramNames.empty()
+            && std::find(config.paramNames.begin(), config.paramNames.end(), param.name)
+                == config.paramNames.end())
+            continue;
+
+        SpsaParam spsaParam = {};
+        spsaParam.idx = i;
+        spsaParam.value = param.value;
+        spsaParam.c = param.step * std::pow(iterations, SPSA_GAMMA);
+        spsaParam.a = config.learningRate * param.step * param.step
+            * std::pow(SPSA_A_RATIO * iterations + iterations, SPSA_ALPHA);
+        state.params.push_back(spsaParam);
+    }
+
+    for (const auto& name : config.paramNames)
+    {
+        auto it = std::find_if(searchParams.begin(), searchParams.end(),
+            [&name](const search::SearchParam& param)
+            {
+                return param.name == name;
+            });
+        if (it == searchParams.end())
+        {
+            std::cout << "Unknown search param " << name << std::endl;
+            return;
+        }
+    }
+
+    if (loadState(config, state))
+        std::cout << "Resuming after " << state.iterations << " iterations from "
+                  << config.outputFilename << std::endl;
+
+    std::cout << "Tuning " << state.params.size() << " params for " << config.iterations
+              << " game pairs with " << config.numThreads << " threads and " << config.nodes
+              << " nodes per move, from " << book.size() << " openings" << std::endl;
+
+    GameLimits limits = {};
+    limits.nodes = config.nodes;
+
+    std::mutex mutex;
+    std::atomic<u32> nextIteration = state.iterations;
+    u32 startIterations = state.iterations;
+    auto startTime = std::chrono::steady_clock::now();
+
+    {
+        std::vector<std::jthread> threads;
+        threads.reserve(config.numThreads);
+        for (u32 i = 0; i < config.numThreads; i++)
+        {
+            threads.emplace_back(
+                [&]()
+                {
+                    std::array<search::Search, 2> searches = {
+                        search::Search(config.hashMB), search::Search(config.hashMB)};
+                    std::mt19937_64 gen(std::random_device{}());
+                    std::uniform_int_distribution<i32> flipDist(0, 1);
+
+                    u32 iteration;
+                    while ((iteration = nextIteration.fetch_add(1)) < config.iterations)
+                    {
+                        std::optional<Board> opening = nextOpening(book);
+                        if (!opening)
+                            return;
+
+                        // the values of the params that aren't tuned come from setoption
+                        search::SearchParamValues plus = search::searchParamValues();
+                        search::SearchParamValues minus = plus;
+                        std::vector<f64> steps(state.params.size());
+                        {
+                            std::unique_lock<std::mutex> lock(mutex);
+                            for (usize j = 0; j < state.params.size(); j++)
+                            {
+                                const SpsaParam& param = state.params[j];
+                                const auto& searchParam = searchParams[param.idx];
+                                f64 c = param.c / std::pow(iteration + 1.0, SPSA_GAMMA);
+                                steps[j] = flipDist(gen) ? c : -c;
+
+                                auto round = [&searchParam](f64 value)
+                                {
+                                    return std::clamp(static_cast<i32>(std::round(value)),
+                                        searchParam.min, searchParam.max);
+                                };
+                                plus[param.idx] = round(param.value + steps[j]);
+                                minus[param.idx] = round(param.value - steps[j]);
+                            }
+                        }
+
+                        // callbacks such as updateLmrTable run on this thread as the
+                        // searches switch between the two sets of values
+                        searches[0].setSearchParams(std::move(plus));
+                        searches[1].setSearchParams(std::move(minus));
+
+                        // the wins minus the losses of the plus values
+                        i32 result = 0;
+                        for (Color firstColor : {Color::WHITE, Color::BLACK})
+                        {
+                            for (auto& search : searches)
+                                search.newGame();
+                            ColorArray<search::Search*> engines;
+                            engines[firstColor] = &searches[0];
+                            engines[~firstColor] = &searches[1];
+
+                            PlayedGame game = playGame(engines, *opening, limits);
+                            i32 whiteResult = static_cast<i32>(game.result) - 1;
+                            result += firstColor == Color::WHITE ? whiteResult : -whiteResult;
+                        }
+
+                        std::unique_lock<std::mutex> lock(mutex);
+                        for (usize j = 0; j < state.params.size(); j++)
+                        {
+                            SpsaParam& param = state.params[j];
+                            const auto& searchParam = searchParams[param.idx];
+                            f64 a = param.a
+                                / std::pow(SPSA_A_RATIO * iterations + iteration + 1.0, SPSA_ALPHA);
+                            // a / c^2 * c * result * sign(step)
+                            param.value += a / steps[j] * result;
+                            param.value = std::clamp(param.value,
+                                static_cast<f64>(searchParam.min),
+                                static_cast<f64>(searchParam.max));
+                        }
+
+                        state.iterations++;
+                        if (state.iterations % SAVE_INTERVAL == 0)
+                        {
+                            saveState(config, state);
+                            f64 seconds = std::chrono::duration<f64>(
+                                std::chrono::steady_clock::now() - startTime)
+                                              .count();
+                            std::cout << "Played " << state.iterations << " of "
+                                      << config.iterations << " game pairs, "
+                                      << 2 * (state.iterations - startIterations) / seconds
+                                      << " games/s" << std::endl;
+                        }
+                    }
+                });
+        }
+    }
+
+    saveState(config, state);
+    std::cout << "Finished " << state.iterations << " game pairs, tuned values:" << std::endl;
+    printParams(state);
+}
+
+#endif
+
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "../defs.h"
+
+namespace tune
+{
+
+struct SpsaConfig
+{
+    // EPD or FEN file with the openings, which are played in a random order
+    std::string openingsFilename;
+    // the tuned values are saved here as they change, and a tune resumes from the file
+    std::string outputFilename;
+    // the search params to tune, or empty for all of them
+    std::vector<std::string> paramNames;
+    // each iteration is one game pair
+    u32 iterations;
+    u64 nodes;
+    u32 numThreads;
+    // for each of the two searches of each thread
+    i32 hashMB;
+    // learning rate at the end of the tune, scaled by the square of each param's step
+    f64 learningRate;
+};
+
+// tunes the search params with SPSA, playing a game pair between the values plus and minus
+// a random perturbation for each iteration, with one game pair at a time on each thread.
+// The perturbation of each param starts at step * iterations^0.101 and decays to its step
+// at the last iteration, and the learning rate decays to learningRate there, the same
+// as c_end and r_end in OpenBench's SPSA
+// only available in builds with EXTERNAL_TUNE defined, since the params are constexpr otherwise
+void runSpsa(const SpsaConfig& config);
+
+}
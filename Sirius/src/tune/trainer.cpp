@@ -0,0 +1,551 @@
+#include "trainer.h"
+#include "../datagen/viriformat.h"
+#include "../eval/nnue.h"
+#include "../move_ordering.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace tune
+{
+
+using eval::nnue::HIDDEN_SIZE;
+using eval::nnue::INPUT_SIZE;
+
+namespace
+{
+
+// all parameters are stored in one array so that the gradients
+// and optimizer state can be handled uniformly
+constexpr usize FEATURE_WEIGHTS = 0;
+constexpr usize FEATURE_BIAS = FEATURE_WEIGHTS + INPUT_SIZE * HIDDEN_SIZE;
+constexpr usize OUTPUT_WEIGHTS = FEATURE_BIAS + HIDDEN_SIZE;
+constexpr usize OUTPUT_BIAS = OUTPUT_WEIGHTS + 2 * HIDDEN_SIZE;
+constexpr usize PARAM_COUNT = OUTPUT_BIAS + 1;
+
+// output weights are clipped so that they fit in the range the inference kernels allow
+constexpr f32 MAX_OUTPUT_WEIGHT =
+    static_cast<f32>(eval::nnue::MAX_OUTPUT_WEIGHT) / static_cast<f32>(eval::nnue::QB);
+
+constexpr usize SHUFFLE_BUFFER_SIZE = 1 << 18;
+constexpr u32 REPORT_INTERVAL = 256;
+
+constexpr f32 ADAM_BETA1 = 0.9f;
+constexpr f32 ADAM_BETA2 = 0.999f;
+constexpr f32 ADAM_EPSILON = 1e-8f;
+
+struct TrainingPosition
+{
+    // features from the side to move's perspective, and the other side's
+    std::array<u16, 32> stmFeatures;
+    std::array<u16, 32> nstmFeatures;
+    u8 featureCount;
+    f32 target;
+};
+
+f32 sigmoid(f32 x)
+{
+    return 1.0f / (1.0f + std::exp(-x));
+}
+
+TrainingPosition makePosition(const Board& board, i32 score, marlinformat::WDL wdl, f32 wdlWeight)
+{
+    TrainingPosition position;
+    position.featureCount = 0;
+
+    Color stm = board.sideToMove();
+    Bitboard pieces = board.allPieces();
+    while (pieces.any())
+    {
+        Square sq = pieces.poplsb();
+        Color color = getPieceColor(board.pieceAt(sq));
+        PieceType type = getPieceType(board.pieceAt(sq));
+        position.stmFeatures[position.featureCount] =
+            static_cast<u16>(eval::nnue::featureIndex(stm, color, type, sq));
+        position.nstmFeatures[position.featureCount] =
+            static_cast<u16>(eval::nnue::featureIndex(~stm, color, type, sq));
+        position.featureCount++;
+    }
+
+    // scores and results are stored from white's perspective
+    f32 result = wdl == marlinformat::WDL::WHITE_WIN ? 1.0f
+        : wdl == marlinformat::WDL::DRAW             ? 0.5f
+                                                     : 0.0f;
+    if (stm == Color::BLACK)
+    {
+        score = -score;
+        result = 1.0f - result;
+    }
+
+    f32 scoreTarget = sigmoid(static_cast<f32>(score) / eval::nnue::EVAL_SCALE);
+    position.target = wdlWeight * result + (1.0f - wdlWeight) * scoreTarget;
+    return position;
+}
+
+class DataReader
+{
+public:
+    DataReader(const std::string& filename, DataFormat format, f32 wdlWeight);
+
+    bool isOpen() const;
+    // returns false once the end of the file is reached
+    bool next(TrainingPosition& position);
+    void rewind();
+
+private:
+    bool nextViriformat(TrainingPosition& position);
+    bool nextMarlinformat(TrainingPosition& position);
+
+    std::ifstream m_File;
+    DataFormat m_Format;
+    f32 m_WdlWeight;
+
+    viriformat::Game m_Game;
+    usize m_MoveIdx;
+    Board m_Board;
+    marlinformat::WDL m_WDL;
+};
+
+DataReader::DataReader(const std::string& filename, DataFormat format, f32 wdlWeight)
+    : m_File(filename, std::ios::binary),
+      m_Format(format),
+      m_WdlWeight(wdlWeight),
+      m_MoveIdx(0),
+      m_WDL(marlinformat::WDL::DRAW)
+{
+}
+
+bool DataReader::isOpen() const
+{
+    return m_File.is_open();
+}
+
+bool DataReader::next(TrainingPosition& position)
+{
+    if (m_Format == DataFormat::VIRIFORMAT)
+        return nextViriformat(position);
+    return nextMarlinformat(position);
+}
+
+void DataReader::rewind()
+{
+    m_File.clear();
+    m_File.seekg(0);
+    m_Game = {};
+    m_MoveIdx = 0;
+}
+
+bool DataReader::nextViriformat(TrainingPosition& position)
+{
+    while (true)
+    {
+        if (m_MoveIdx >= m_Game.moves.size())
+        {
+            if (m_File.peek() == EOF)
+                return false;
+            m_Game = viriformat::Game::read(m_File);
+            auto unpacked = marlinformat::unpackBoard(m_Game.startpos);
+            m_Board = unpacked.board;
+            m_WDL = unpacked.wdl;
+            m_MoveIdx = 0;
+            continue;
+        }
+
+        auto [viriMove, score] = m_Game.moves[m_MoveIdx++];
+        Move move = viriMove.toMove();
+
+        // same filtering as extract
+        bool skip = m_Board.checkers().any() || !moveIsQuiet(m_Board, move) || isMateScore(score);
+        if (!skip)
+            position = makePosition(m_Board, score, m_WDL, m_WdlWeight);
+
+        m_Board.makeMove(move);
+        if (!skip)
+            return true;
+    }
+}
+
+bool DataReader::nextMarlinformat(TrainingPosition& position)
+{
+    while (true)
+    {
+        marlinformat::PackedBoard packedBoard;
+        m_File.read(reinterpret_cast<char*>(&packedBoard), sizeof(packedBoard));
+        if (m_File.gcount() != sizeof(packedBoard))
+            return false;
+
+        auto [board, score, wdl] = marlinformat::unpackBoard(packedBoard);
+        if (board.checkers().any() || isMateScore(score))
+            continue;
+
+        position = makePosition(board, score, wdl, m_WdlWeight);
+        return true;
+    }
+}
+
+// accumulates the gradient of the squared error into grads and returns the error
+f32 backprop(const std::vector<f32>& params, std::vector<f32>& grads,
+    const TrainingPosition& position)
+{
+    alignas(64) std::array<f32, HIDDEN_SIZE> stmAcc;
+    alignas(64) std::array<f32, HIDDEN_SIZE> nstmAcc;
+
+    std::copy_n(&params[FEATURE_BIAS], HIDDEN_SIZE, stmAcc.begin());
+    std::copy_n(&params[FEATURE_BIAS], HIDDEN_SIZE, nstmAcc.begin());
+    for (i32 i = 0; i < position.featureCount; i++)
+    {
+        const f32* stmWeights = &params[FEATURE_WEIGHTS + position.stmFeatures[i] * HIDDEN_SIZE];
+        const f32* nstmWeights = &params[FEATURE_WEIGHTS + position.nstmFeatures[i] * HIDDEN_SIZE];
+        for (i32 j = 0; j < HIDDEN_SIZE; j++)
+        {
+            stmAcc[j] += stmWeights[j];
+            nstmAcc[j] += nstmWeights[j];
+        }
+    }
+
+    const f32* outputWeights = &params[OUTPUT_WEIGHTS];
+    f32 output = params[OUTPUT_BIAS];
+    for (i32 j = 0; j < HIDDEN_SIZE; j++)
+    {
+        f32 stmActivated = std::clamp(stmAcc[j], 0.0f, 1.0f);
+        f32 nstmActivated = std::clamp(nstmAcc[j], 0.0f, 1.0f);
+        output += stmActivated * stmActivated * outputWeights[j]
+            + nstmActivated * nstmActivated * outputWeights[HIDDEN_SIZE + j];
+    }
+
+    f32 prediction = sigmoid(output);
+    f32 error = prediction - position.target;
+    f32 outputGrad = 2.0f * error * prediction * (1.0f - prediction);
+
+    grads[OUTPUT_BIAS] += outputGrad;
+
+    // reuse the accumulators for their gradients
+    f32* outputWeightGrads = &grads[OUTPUT_WEIGHTS];
+    for (i32 j = 0; j < HIDDEN_SIZE; j++)
+    {
+        f32 stmActivated = std::clamp(stmAcc[j], 0.0f, 1.0f);
+        f32 nstmActivated = std::clamp(nstmAcc[j], 0.0f, 1.0f);
+        outputWeightGrads[j] += outputGrad * stmActivated * stmActivated;
+        outputWeightGrads[HIDDEN_SIZE + j] += outputGrad * nstmActivated * nstmActivated;
+
+        stmAcc[j] = stmAcc[j] > 0.0f && stmAcc[j] < 1.0f
+            ? outputGrad * outputWeights[j] * 2.0f * stmAcc[j]
+            : 0.0f;
+        nstmAcc[j] = nstmAcc[j] > 0.0f && nstmAcc[j] < 1.0f
+            ? outputGrad * outputWeights[HIDDEN_SIZE + j] * 2.0f * nstmAcc[j]
+            : 0.0f;
+    }
+
+    f32* featureBiasGrads = &grads[FEATURE_BIAS];
+    for (i32 j = 0; j < HIDDEN_SIZE; j++)
+        featureBiasGrads[j] += stmAcc[j] + nstmAcc[j];
+
+    for (i32 i = 0; i < position.featureCount; i++)
+    {
+        f32* stmGrads = &grads[FEATURE_WEIGHTS + position.stmFeatures[i] * HIDDEN_SIZE];
+        f32* nstmGrads = &grads[FEATURE_WEIGHTS + position.nstmFeatures[i] * HIDDEN_SIZE];
+        for (i32 j = 0; j < HIDDEN_SIZE; j++)
+        {
+            stmGrads[j] += stmAcc[j];
+            nstmGrads[j] += nstmAcc[j];
+        }
+    }
+
+    return error * error;
+}
+
+// threads that live for the whole run and are woken for each phase of a batch, since
+// starting new threads for every batch costs a real share of the time of small batches
+class WorkerPool
+{
+public:
+    explicit WorkerPool(u32 numThreads);
+    ~WorkerPool();
+
+    // runs task(i) for each thread index i, with index 0 on the calling
+    // thread, and returns once every call has finished
+    void run(const std::function<void(u32)>& task);
+
+private:
+    void workerLoop(u32 idx);
+
+    std::vector<std::thread> m_Threads;
+    std::mutex m_Mutex;
+    std::condition_variable m_WorkCV;
+    std::condition_variable m_DoneCV;
+    const std::function<void(u32)>* m_Task = nullptr;
+    u64 m_Generation = 0;
+    u32 m_Pending = 0;
+    bool m_Quit = false;
+};
+
+WorkerPool::WorkerPool(u32 numThreads)
+{
+    for (u32 i = 1; i < numThreads; i++)
+        m_Threads.emplace_back(&WorkerPool::workerLoop, this, i);
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(m_Mutex);
+        m_Quit = true;
+    }
+    m_WorkCV.notify_all();
+    for (auto& thread : m_Threads)
+        thread.join();
+}
+
+void WorkerPool::run(const std::function<void(u32)>& task)
+{
+    {
+        std::lock_guard<std::mutex> guard(m_Mutex);
+        m_Task = &task;
+        m_Pending = static_cast<u32>(m_Threads.size());
+        m_Generation++;
+    }
+    m_WorkCV.notify_all();
+
+    task(0);
+
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_DoneCV.wait(lock,
+        [this]
+        {
+            return m_Pending == 0;
+        });
+}
+
+void WorkerPool::workerLoop(u32 idx)
+{
+    u64 generation = 0;
+    for (;;)
+    {
+        const std::function<void(u32)>* task;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_WorkCV.wait(lock,
+                [&]
+                {
+                    return m_Quit || m_Generation != generation;
+                });
+            if (m_Quit)
+                return;
+            generation = m_Generation;
+            task = m_Task;
+        }
+
+        (*task)(idx);
+
+        std::lock_guard<std::mutex> guard(m_Mutex);
+        if (--m_Pending == 0)
+            m_DoneCV.notify_one();
+    }
+}
+
+struct Trainer
+{
+    Trainer(const TrainConfig& config);
+
+    // returns the summed error of the batch
+    f64 trainBatch(const TrainingPosition* positions, usize count);
+    void save(const std::string& filename) const;
+
+    const TrainConfig& config;
+    std::vector<f32> params;
+    std::vector<f32> momentum;
+    std::vector<f32> velocity;
+    // zeroed by the optimizer step as it sums them, so that no batch has to clear them
+    std::vector<std::vector<f32>> threadGrads;
+    std::vector<f64> threadErrors;
+    u64 step;
+    WorkerPool pool;
+};
+
+Trainer::Trainer(const TrainConfig& config)
+    : config(config),
+      params(PARAM_COUNT),
+      momentum(PARAM_COUNT),
+      velocity(PARAM_COUNT),
+      threadGrads(config.numThreads, std::vector<f32>(PARAM_COUNT)),
+      threadErrors(config.numThreads),
+      step(0),
+      pool(config.numThreads)
+{
+    std::mt19937 gen(std::random_device{}());
+
+    f32 featureRange = 1.0f / std::sqrt(static_cast<f32>(INPUT_SIZE));
+    std::uniform_real_distribution<f32> featureDist(-featureRange, featureRange);
+    for (usize i = FEATURE_WEIGHTS; i < OUTPUT_WEIGHTS; i++)
+        params[i] = featureDist(gen);
+
+    f32 outputRange = 1.0f / std::sqrt(static_cast<f32>(2 * HIDDEN_SIZE));
+    std::uniform_real_distribution<f32> outputDist(-outputRange, outputRange);
+    for (usize i = OUTPUT_WEIGHTS; i < PARAM_COUNT; i++)
+        params[i] = outputDist(gen);
+}
+
+f64 Trainer::trainBatch(const TrainingPosition* positions, usize count)
+{
+    u32 numThreads = config.numThreads;
+    std::fill(threadErrors.begin(), threadErrors.end(), 0.0);
+
+    pool.run(
+        [this, numThreads, positions, count](u32 i)
+        {
+            auto& grads = threadGrads[i];
+            for (usize j = count * i / numThreads; j < count * (i + 1) / numThreads; j++)
+                threadErrors[i] += backprop(params, grads, positions[j]);
+        });
+
+    step++;
+    f32 lr = config.learningRate;
+    f32 momentumCorrection = 1.0f - std::pow(ADAM_BETA1, static_cast<f32>(step));
+    f32 velocityCorrection = 1.0f - std::pow(ADAM_BETA2, static_cast<f32>(step));
+
+    // adam, with the gradients summed over threads
+    pool.run(
+        [=, this](u32 i)
+        {
+            usize begin = PARAM_COUNT * i / numThreads;
+            usize end = PARAM_COUNT * (i + 1) / numThreads;
+            for (usize j = begin; j < end; j++)
+            {
+                f32 grad = 0.0f;
+                for (auto& grads : threadGrads)
+                {
+                    grad += grads[j];
+                    grads[j] = 0.0f;
+                }
+                grad /= static_cast<f32>(count);
+
+                momentum[j] = ADAM_BETA1 * momentum[j] + (1.0f - ADAM_BETA1) * grad;
+                velocity[j] = ADAM_BETA2 * velocity[j] + (1.0f - ADAM_BETA2) * grad * grad;
+                f32 m = momentum[j] / momentumCorrection;
+                f32 v = velocity[j] / velocityCorrection;
+                params[j] -= lr * m / (std::sqrt(v) + ADAM_EPSILON);
+
+                if (j >= OUTPUT_WEIGHTS && j < OUTPUT_BIAS)
+                    params[j] = std::clamp(params[j], -MAX_OUTPUT_WEIGHT, MAX_OUTPUT_WEIGHT);
+            }
+        });
+
+    f64 error = 0.0;
+    for (f64 threadError : threadErrors)
+        error += threadError;
+    return error;
+}
+
+i16 quantize(f32 value, f32 scale)
+{
+    return static_cast<i16>(std::clamp(std::round(value * scale), -32768.0f, 32767.0f));
+}
+
+void Trainer::save(const std::string& filename) const
+{
+    using namespace eval::nnue;
+
+    auto network = std::make_unique<Network>();
+    for (i32 feature = 0; feature < INPUT_SIZE; feature++)
+        for (i32 i = 0; i < HIDDEN_SIZE; i++)
+            network->featureWeights[feature][i] =
+                quantize(params[FEATURE_WEIGHTS + feature * HIDDEN_SIZE + i], QA);
+
+    for (i32 i = 0; i < HIDDEN_SIZE; i++)
+        network->featureBias[i] = quantize(params[FEATURE_BIAS + i], QA);
+
+    for (i32 i = 0; i < 2 * HIDDEN_SIZE; i++)
+        network->outputWeights[i] = quantize(params[OUTPUT_WEIGHTS + i], QB);
+
+    network->outputBias = quantize(params[OUTPUT_BIAS], QA * QB);
+
+    saveNetwork(*network, filename);
+}
+
+}
+
+void runTraining(const TrainConfig& config)
+{
+    DataReader reader(config.dataFilename, config.format, config.wdlWeight);
+    if (!reader.isOpen())
+    {
+        std::cout << "Could not open file " << config.dataFilename << std::endl;
+        return;
+    }
+
+    std::cout << "Training on " << config.dataFilename << " for " << config.epochs
+              << " epochs with " << config.numThreads << " threads" << std::endl;
+
+    std::mt19937 gen(std::random_device{}());
+    Trainer trainer(config);
+
+    // positions are streamed from the file, and shuffled within a buffer
+    std::vector<TrainingPosition> buffer;
+    buffer.reserve(SHUFFLE_BUFFER_SIZE);
+
+    for (u32 epoch = 1; epoch <= config.epochs; epoch++)
+    {
+        auto t1 = std::chrono::steady_clock::now();
+        reader.rewind();
+
+        u64 positions = 0;
+        u64 batches = 0;
+        f64 totalError = 0.0;
+        bool endOfFile = false;
+
+        while (!endOfFile)
+        {
+            buffer.clear();
+            TrainingPosition position;
+            while (buffer.size() < SHUFFLE_BUFFER_SIZE)
+            {
+                if (!reader.next(position))
+                {
+                    endOfFile = true;
+                    break;
+                }
+                buffer.push_back(position);
+            }
+
+            std::shuffle(buffer.begin(), buffer.end(), gen);
+
+            for (usize begin = 0; begin < buffer.size(); begin += config.batchSize)
+            {
+                usize count = std::min<usize>(config.batchSize, buffer.size() - begin);
+                totalError += trainer.trainBatch(&buffer[begin], count);
+                positions += count;
+                batches++;
+
+                if (batches % REPORT_INTERVAL == 0)
+                    std::cout << "epoch " << epoch << " batch " << batches << " loss "
+                              << totalError / static_cast<f64>(positions) << std::endl;
+            }
+        }
+
+        auto t2 = std::chrono::steady_clock::now();
+        f64 seconds = std::chrono::duration_cast<std::chrono::duration<f64>>(t2 - t1).count();
+
+        if (positions == 0)
+        {
+            std::cout << "No positions in " << config.dataFilename << std::endl;
+            return;
+        }
+
+        trainer.save(config.outputFilename);
+
+        std::cout << "epoch " << epoch << " finished: loss " << totalError / positions << ", "
+                  << positions << " positions, " << static_cast<u64>(positions / seconds)
+                  << " positions/s, saved to " << config.outputFilename << std::endl;
+    }
+}
+
+}
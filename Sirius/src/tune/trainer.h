@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+
+#include "../defs.h"
+
+namespace tune
+{
+
+enum class DataFormat
+{
+    VIRIFORMAT,
+    MARLINFORMAT
+};
+
+struct TrainConfig
+{
+    std::string dataFilename;
+    std::string outputFilename;
+    DataFormat format;
+    u32 epochs;
+    u32 batchSize;
+    u32 numThreads;
+    f32 learningRate;
+    // weight of the game result in the target, the rest is the search score
+    f32 wdlWeight;
+};
+
+// trains a network with the same architecture as eval::nnue::Network
+// and writes it in the format that the engine loads
+void runTraining(const TrainConfig& config);
+
+}
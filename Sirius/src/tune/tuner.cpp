@@ -0,0 +1,579 @@
+#include "tuner.h"
+
+#include <iostream>
+
+#ifdef EVAL_TUNE
+
+#include "../board.h"
+#include "../eval/endgame.h"
+#include "../eval/eval.h"
+#include "../eval/eval_params.h"
+#include "../eval/eval_trace.h"
+#include "../util/parallel_for.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+#endif
+
+namespace tune
+{
+
+#ifndef EVAL_TUNE
+
+void runTuning(const TuneConfig& config)
+{
+    std::cout << "Tuning requires a build with EVAL_TUNE defined" << std::endl;
+}
+
+#else
+
+using namespace eval;
+
+namespace
+{
+
+constexpr usize LOAD_CHUNK_SIZE = 1 << 16;
+constexpr u32 REPORT_INTERVAL = 10;
+constexpr u32 SAVE_INTERVAL = 100;
+
+constexpr f64 ADAM_BETA1 = 0.9;
+constexpr f64 ADAM_BETA2 = 0.999;
+constexpr f64 ADAM_EPSILON = 1e-8;
+
+constexpr i32 MG = 0;
+constexpr i32 EG = 1;
+
+using ParamArray = std::vector<std::array<f64, 2>>;
+
+// only the king safety terms need the coefficients of each side separately,
+// every other parameter stores white's minus black's in white
+struct Coefficient
+{
+    u16 index;
+    i8 white;
+    i8 black;
+};
+
+struct Position
+{
+    u64 begin;
+    u16 count;
+    u8 phase;
+    u8 scale;
+    // from white's perspective
+    i16 eval;
+    f32 result;
+    f32 score;
+    f32 target;
+};
+
+struct Dataset
+{
+    std::vector<Coefficient> coeffs;
+    std::vector<Position> positions;
+};
+
+bool isSafetyParam(u32 index)
+{
+    return index >= SAFETY_BEGIN && index < SAFETY_END;
+}
+
+bool isComplexityParam(u32 index)
+{
+    return index >= COMPLEXITY_BEGIN && index < COMPLEXITY_END;
+}
+
+f64 sigmoid(f64 x)
+{
+    return 1.0 / (1.0 + std::exp(-x));
+}
+
+f64 adjustSafety(f64 value)
+{
+    return (value + std::max(value, 0.0) * value / 128.0) / 8.0;
+}
+
+f64 adjustSafetyDerivative(f64 value)
+{
+    return (1.0 + 2.0 * std::max(value, 0.0) / 128.0) / 8.0;
+}
+
+// lines are written by extract as "<fen> | <score>cp | <result>"
+bool parseLine(const std::string& line, std::string& fen, f32& score, f32& result)
+{
+    usize first = line.find('|');
+    usize second = line.find('|', first + 1);
+    if (first == std::string::npos || second == std::string::npos)
+        return false;
+
+    fen = line.substr(0, first);
+    try
+    {
+        score = std::stof(line.substr(first + 1, second - first - 1));
+        result = std::stof(line.substr(second + 1));
+    }
+    catch (const std::exception&)
+    {
+        return false;
+    }
+    return true;
+}
+
+// returns false if a coefficient doesn't fit
+bool addTrace(Dataset& dataset, const EvalTrace& trace, f32 score, f32 result)
+{
+    Position position = {};
+    position.begin = dataset.coeffs.size();
+    position.phase = static_cast<u8>(trace.phase);
+    position.scale = static_cast<u8>(trace.scale);
+    position.eval = static_cast<i16>(std::clamp(trace.eval, -32767, 32767));
+    position.result = result;
+    position.score = score;
+
+    for (u32 i = 0; i < PARAM_COUNT; i++)
+    {
+        i32 white = trace.coeffs[i][Color::WHITE];
+        i32 black = trace.coeffs[i][Color::BLACK];
+        if (!isSafetyParam(i))
+        {
+            white -= black;
+            black = 0;
+        }
+        if (white == 0 && black == 0)
+            continue;
+
+        if (std::abs(white) > 127 || std::abs(black) > 127)
+        {
+            dataset.coeffs.resize(position.begin);
+            return false;
+        }
+        dataset.coeffs.push_back(
+            {static_cast<u16>(i), static_cast<i8>(white), static_cast<i8>(black)});
+        position.count++;
+    }
+
+    dataset.positions.push_back(position);
+    return true;
+}
+
+struct LoadStats
+{
+    u64 lines;
+    u64 skipped;
+};
+
+// traces a chunk of lines on every thread, then appends them to dataset in order
+void traceChunk(const std::vector<std::string>& lines, Dataset& dataset, LoadStats& stats,
+    u32 numThreads)
+{
+    std::vector<Dataset> threadData(numThreads);
+    std::vector<u64> threadSkipped(numThreads);
+
+    parallelFor(numThreads, lines.size(),
+        [&](u32 threadIdx, usize begin, usize end)
+        {
+            Board board;
+            auto trace = std::make_unique<EvalTrace>();
+            std::string fen;
+            for (usize i = begin; i < end; i++)
+            {
+                f32 score, result;
+                if (!parseLine(lines[i], fen, score, result))
+                {
+                    threadSkipped[threadIdx]++;
+                    continue;
+                }
+
+                board.setToFen(fen);
+                if (!traceEvaluate(board, *trace)
+                    || !addTrace(threadData[threadIdx], *trace, score, result))
+                    threadSkipped[threadIdx]++;
+            }
+        });
+
+    for (u32 i = 0; i < numThreads; i++)
+    {
+        u64 offset = dataset.coeffs.size();
+        for (Position position : threadData[i].positions)
+        {
+            position.begin += offset;
+            dataset.positions.push_back(position);
+        }
+        dataset.coeffs.insert(
+            dataset.coeffs.end(), threadData[i].coeffs.begin(), threadData[i].coeffs.end());
+        stats.skipped += threadSkipped[i];
+    }
+    stats.lines += lines.size();
+}
+
+struct TermSums
+{
+    std::array<f64, 2> linear;
+    std::array<f64, 2> tempo;
+    ColorArray<std::array<f64, 2>> safety;
+    f64 complexity;
+};
+
+TermSums sumTerms(const Dataset& dataset, const Position& position, const ParamArray& params)
+{
+    TermSums sums = {};
+    const Coefficient* coeffs = &dataset.coeffs[position.begin];
+    for (u32 i = 0; i < position.count; i++)
+    {
+        const Coefficient& coeff = coeffs[i];
+        const auto& param = params[coeff.index];
+        for (i32 phase : {MG, EG})
+        {
+            if (coeff.index == TEMPO_INDEX)
+                sums.tempo[phase] += coeff.white * param[phase];
+            else if (isSafetyParam(coeff.index))
+            {
+                sums.safety[Color::WHITE][phase] += coeff.white * param[phase];
+                sums.safety[Color::BLACK][phase] += coeff.black * param[phase];
+            }
+            else if (isComplexityParam(coeff.index))
+                sums.complexity += phase == EG ? coeff.white * param[EG] : 0.0;
+            else
+                sums.linear[phase] += coeff.white * param[phase];
+        }
+    }
+    return sums;
+}
+
+// the same steps as eval::evaluate, from white's perspective
+struct ModelEval
+{
+    f64 eval;
+    // eg score before the complexity is applied
+    f64 eg;
+    bool complexityActive;
+};
+
+ModelEval evaluateModel(const Position& position, const TermSums& sums)
+{
+    f64 mg = sums.linear[MG] + adjustSafety(sums.safety[Color::WHITE][MG])
+        - adjustSafety(sums.safety[Color::BLACK][MG]);
+    f64 eg = sums.linear[EG] + adjustSafety(sums.safety[Color::WHITE][EG])
+        - adjustSafety(sums.safety[Color::BLACK][EG]);
+
+    f64 egSign = (eg > 0) - (eg < 0);
+    bool complexityActive = sums.complexity > -std::abs(eg);
+    f64 finalEg = eg + egSign * std::max(sums.complexity, -std::abs(eg)) + sums.tempo[EG];
+    f64 finalMg = mg + sums.tempo[MG];
+
+    f64 phase = position.phase;
+    f64 scaledEg = finalEg * position.scale / SCALE_FACTOR_NORMAL;
+    f64 eval = (finalMg * phase + scaledEg * (24 - phase)) / 24;
+    return {eval, eg, complexityActive};
+}
+
+// returns the squared error, and adds its gradient to grads
+f64 backprop(const Dataset& dataset, const Position& position, const ParamArray& params,
+    ParamArray& grads, f64 k)
+{
+    TermSums sums = sumTerms(dataset, position, params);
+    ModelEval model = evaluateModel(position, sums);
+
+    f64 prediction = sigmoid(k * model.eval / 400.0);
+    f64 error = prediction - position.target;
+    f64 evalGrad = 2.0 * error * prediction * (1.0 - prediction) * k / 400.0;
+
+    f64 mgGrad = evalGrad * position.phase / 24.0;
+    f64 egGrad =
+        evalGrad * position.scale / SCALE_FACTOR_NORMAL * (24 - position.phase) / 24.0;
+
+    // when the complexity clamps the eg score to 0, nothing before it affects the eg score
+    f64 egSign = (model.eg > 0) - (model.eg < 0);
+    f64 preComplexityEgGrad = egSign == 0 || model.complexityActive ? egGrad : 0.0;
+    f64 complexityGrad = model.complexityActive ? egSign * egGrad : 0.0;
+
+    std::array<f64, 2> safetyGrads[2];
+    for (Color color : {Color::WHITE, Color::BLACK})
+    {
+        safetyGrads[static_cast<i32>(color)][MG] =
+            mgGrad * adjustSafetyDerivative(sums.safety[color][MG]);
+        safetyGrads[static_cast<i32>(color)][EG] =
+            preComplexityEgGrad * adjustSafetyDerivative(sums.safety[color][EG]);
+    }
+
+    const Coefficient* coeffs = &dataset.coeffs[position.begin];
+    for (u32 i = 0; i < position.count; i++)
+    {
+        const Coefficient& coeff = coeffs[i];
+        auto& grad = grads[coeff.index];
+        if (coeff.index == TEMPO_INDEX)
+        {
+            grad[MG] += coeff.white * mgGrad;
+            grad[EG] += coeff.white * egGrad;
+        }
+        else if (isSafetyParam(coeff.index))
+        {
+            grad[MG] += coeff.white * safetyGrads[0][MG] - coeff.black * safetyGrads[1][MG];
+            grad[EG] += coeff.white * safetyGrads[0][EG] - coeff.black * safetyGrads[1][EG];
+        }
+        else if (isComplexityParam(coeff.index))
+            grad[EG] += coeff.white * complexityGrad;
+        else
+        {
+            grad[MG] += coeff.white * mgGrad;
+            grad[EG] += coeff.white * preComplexityEgGrad;
+        }
+    }
+
+    return error * error;
+}
+
+std::vector<f64> evaluateAll(const Dataset& dataset, const ParamArray& params, u32 numThreads)
+{
+    std::vector<f64> evals(dataset.positions.size());
+    parallelFor(numThreads, evals.size(),
+        [&](u32, usize begin, usize end)
+        {
+            for (usize i = begin; i < end; i++)
+            {
+                const Position& position = dataset.positions[i];
+                evals[i] = evaluateModel(position, sumTerms(dataset, position, params)).eval;
+            }
+        });
+    return evals;
+}
+
+// finds the scaling constant that best maps the evals to the game results
+f64 computeK(const Dataset& dataset, const std::vector<f64>& evals)
+{
+    auto loss = [&](f64 k)
+    {
+        f64 total = 0.0;
+        for (usize i = 0; i < evals.size(); i++)
+        {
+            f64 error = sigmoid(k * evals[i] / 400.0) - dataset.positions[i].result;
+            total += error * error;
+        }
+        return total / static_cast<f64>(evals.size());
+    };
+
+    f64 lo = 0.0, hi = 10.0;
+    for (i32 i = 0; i < 100; i++)
+    {
+        f64 m1 = lo + (hi - lo) / 3.0;
+        f64 m2 = hi - (hi - lo) / 3.0;
+        if (loss(m1) < loss(m2))
+            hi = m2;
+        else
+            lo = m1;
+    }
+    return (lo + hi) / 2.0;
+}
+
+std::string formatScorePair(const std::array<f64, 2>& param)
+{
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "S(%4d, %4d)", static_cast<i32>(std::lround(param[MG])),
+        static_cast<i32>(std::lround(param[EG])));
+    return buf;
+}
+
+// formats the same way as eval_constants.h, with psqts as 8x8 boards
+std::string formatParam(
+    const ParamArray& params, const std::vector<u32>& dims, usize depth, u32& index, i32 indent)
+{
+    if (depth == dims.size())
+        return formatScorePair(params[index++]);
+
+    std::string pad(indent + 4, ' ');
+    std::string result = "{";
+    if (depth == dims.size() - 1)
+    {
+        if (dims[depth] == 64)
+        {
+            result += "\n";
+            for (u32 i = 0; i < 64; i++)
+            {
+                result += i % 8 == 0 ? pad : " ";
+                result += formatScorePair(params[index++]) + ",";
+                if (i % 8 == 7)
+                    result += "\n";
+            }
+            return result + std::string(indent, ' ') + "}";
+        }
+
+        for (u32 i = 0; i < dims[depth]; i++)
+            result += (i == 0 ? "" : ", ") + formatScorePair(params[index++]);
+        return result + "}";
+    }
+
+    bool boards = dims.back() == 64;
+    result += "\n";
+    for (u32 i = 0; i < dims[depth]; i++)
+    {
+        result += pad + formatParam(params, dims, depth + 1, index, indent + 4);
+        result += boards || i + 1 < dims[depth] ? ",\n" : "\n";
+    }
+    return result + std::string(indent, ' ') + "}";
+}
+
+void writeParams(const std::string& filename, const ParamArray& params)
+{
+    std::ofstream file(filename);
+    file << "#pragma once\n\n#include \"../defs.h\"\n\nnamespace eval\n{\n\n";
+    file << "#ifdef RUNTIME_EVAL_WEIGHTS\n// can be replaced by loadEvalWeights\n";
+    file << "#define EVAL_PARAM inline\n#else\n#define EVAL_PARAM constexpr\n#endif\n\n";
+    file << "// clang-format off\n#define S(mg, eg) ScorePair(mg, eg)\n\n";
+    for (const ParamInfo& info : paramInfos())
+    {
+        if (info.name == nullptr)
+        {
+            file << '\n';
+            continue;
+        }
+
+        file << "EVAL_PARAM ScorePair " << info.name;
+        for (u32 dim : info.dims)
+            file << '[' << dim << ']';
+        u32 index = info.index;
+        file << " = " << formatParam(params, info.dims, 0, index, 0) << ";\n";
+    }
+    file << "\n#undef S\n#undef EVAL_PARAM\n// clang-format on\n\n}\n";
+}
+
+void writeWeights(const std::string& filename, const ParamArray& params)
+{
+    std::array<ScorePair, PARAM_COUNT> rounded;
+    for (u32 i = 0; i < PARAM_COUNT; i++)
+        rounded[i] = ScorePair(static_cast<i32>(std::lround(params[i][MG])),
+            static_cast<i32>(std::lround(params[i][EG])));
+    saveEvalWeights(filename, rounded);
+}
+
+void saveParams(const TuneConfig& config, const ParamArray& params)
+{
+    writeParams(config.outputFilename, params);
+    if (!config.weightsFilename.empty())
+        writeWeights(config.weightsFilename, params);
+}
+
+}
+
+void runTuning(const TuneConfig& config)
+{
+    std::ifstream file(config.dataFilename);
+    if (!file.is_open())
+    {
+        std::cout << "Could not open file " << config.dataFilename << std::endl;
+        return;
+    }
+
+    auto t1 = std::chrono::steady_clock::now();
+
+    Dataset dataset;
+    LoadStats stats = {};
+    std::vector<std::string> lines;
+    lines.reserve(LOAD_CHUNK_SIZE);
+    std::string line;
+    while (std::getline(file, line))
+    {
+        lines.push_back(line);
+        if (lines.size() == LOAD_CHUNK_SIZE)
+        {
+            traceChunk(lines, dataset, stats, config.numThreads);
+            lines.clear();
+        }
+    }
+    traceChunk(lines, dataset, stats, config.numThreads);
+
+    auto t2 = std::chrono::steady_clock::now();
+    f64 loadSeconds = std::chrono::duration_cast<std::chrono::duration<f64>>(t2 - t1).count();
+
+    std::cout << "Loaded " << dataset.positions.size() << " positions (" << stats.skipped
+              << " skipped) with " << dataset.coeffs.size() << " coefficients in " << loadSeconds
+              << "s" << std::endl;
+    if (dataset.positions.empty())
+        return;
+
+    ParamArray params(PARAM_COUNT);
+    auto defaults = currentParams();
+    for (u32 i = 0; i < PARAM_COUNT; i++)
+        params[i] = {static_cast<f64>(defaults[i].mg()), static_cast<f64>(defaults[i].eg())};
+
+    // the tuner's eval is in floating point, so it only matches the engine's up to rounding
+    std::vector<f64> evals = evaluateAll(dataset, params, config.numThreads);
+    f64 evalError = 0.0;
+    for (usize i = 0; i < evals.size(); i++)
+        evalError += std::abs(evals[i] - dataset.positions[i].eval);
+    std::cout << "Mean difference from the engine's eval: " << evalError / evals.size()
+              << std::endl;
+
+    f64 k = computeK(dataset, evals);
+    std::cout << "Optimal K: " << k << std::endl;
+    for (Position& position : dataset.positions)
+        position.target = static_cast<f32>(config.wdlWeight * position.result
+            + (1.0 - config.wdlWeight) * sigmoid(k * position.score / 400.0));
+
+    ParamArray momentum(PARAM_COUNT);
+    ParamArray velocity(PARAM_COUNT);
+    std::vector<ParamArray> threadGrads(config.numThreads, ParamArray(PARAM_COUNT));
+    std::vector<f64> threadLoss(config.numThreads);
+
+    f64 count = static_cast<f64>(dataset.positions.size());
+    for (u32 epoch = 1; epoch <= config.epochs; epoch++)
+    {
+        parallelFor(config.numThreads, dataset.positions.size(),
+            [&](u32 threadIdx, usize begin, usize end)
+            {
+                auto& grads = threadGrads[threadIdx];
+                std::fill(grads.begin(), grads.end(), std::array<f64, 2>{});
+                threadLoss[threadIdx] = 0.0;
+                for (usize i = begin; i < end; i++)
+                    threadLoss[threadIdx] +=
+                        backprop(dataset, dataset.positions[i], params, grads, k);
+            });
+
+        f64 loss = 0.0;
+        for (f64 threadLossValue : threadLoss)
+            loss += threadLossValue;
+        loss /= count;
+
+        f64 momentumCorrection = 1.0 - std::pow(ADAM_BETA1, epoch);
+        f64 velocityCorrection = 1.0 - std::pow(ADAM_BETA2, epoch);
+        for (u32 i = 0; i < PARAM_COUNT; i++)
+        {
+            for (i32 phase : {MG, EG})
+            {
+                f64 grad = 0.0;
+                for (const auto& grads : threadGrads)
+                    grad += grads[i][phase];
+                grad /= count;
+
+                momentum[i][phase] = ADAM_BETA1 * momentum[i][phase] + (1.0 - ADAM_BETA1) * grad;
+                velocity[i][phase] =
+                    ADAM_BETA2 * velocity[i][phase] + (1.0 - ADAM_BETA2) * grad * grad;
+                f64 m = momentum[i][phase] / momentumCorrection;
+                f64 v = velocity[i][phase] / velocityCorrection;
+                params[i][phase] -= config.learningRate * m / (std::sqrt(v) + ADAM_EPSILON);
+            }
+        }
+
+        if (epoch % REPORT_INTERVAL == 0 || epoch == config.epochs)
+        {
+            auto t3 = std::chrono::steady_clock::now();
+            f64 seconds = std::chrono::duration_cast<std::chrono::duration<f64>>(t3 - t2).count();
+            std::cout << "epoch " << epoch << " loss " << loss << " " << epoch / seconds
+                      << " epochs/s" << std::endl;
+        }
+
+        if (epoch % SAVE_INTERVAL == 0 || epoch == config.epochs)
+            saveParams(config, params);
+    }
+
+    if (config.epochs == 0)
+        saveParams(config, params);
+}
+
+#endif
+
+}
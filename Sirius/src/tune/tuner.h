@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+
+#include "../defs.h"
+
+namespace tune
+{
+
+struct TuneConfig
+{
+    std::string dataFilename;
+    std::string outputFilename;
+    // also written as a weights file for loadEvalWeights if not empty
+    std::string weightsFilename;
+    u32 epochs;
+    u32 numThreads;
+    f32 learningRate;
+    // weight of the game result in the target, the rest is the search score
+    f32 wdlWeight;
+};
+
+// tunes the hand crafted eval on the fens written by extract, and writes the
+// tuned parameters in the format of eval_constants.h, and optionally a weights file
+// only available in builds with EVAL_TUNE defined, since it relies on eval tracing
+void runTuning(const TuneConfig& config);
+
+}
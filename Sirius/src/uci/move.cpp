@@ -429,6 +429,8 @@ search_moves:
 
 std::string convMoveToUCI(const Board& board, Move move)
 {
+    if (move == Move::nullmove())
+        return "0000";
     std::string str(4 + (move.type() == MoveType::PROMOTION), ' ');
     str[0] = static_cast<char>(move.fromSq().file() + 'a');
     str[1] = static_cast<char>(move.fromSq().rank() + '1');
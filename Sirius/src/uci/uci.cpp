@@ -3,12 +3,25 @@
 #include <optional>
 #include <string>
 
+#include "../analyze.h"
 #include "../bench.h"
+#include "../datagen/compactformat.h"
 #include "../datagen/datagen.h"
+#include "../datagen/dedup.h"
 #include "../datagen/extract.h"
+#include "../datagen/makebook.h"
+#include "../datagen/pgn.h"
+#include "../datagen/relabel.h"
+#include "../datagen/shuffle.h"
 #include "../eval/eval.h"
+#include "../eval/eval_params.h"
+#include "../eval/nnue.h"
+#include "../match.h"
 #include "../misc.h"
 #include "../sirius.h"
+#include "../tune/trainer.h"
+#include "../tune/spsa.h"
+#include "../tune/tuner.h"
 #include "fen.h"
 #include "move.h"
 #include "uci.h"
@@ -19,26 +32,99 @@
 namespace uci
 {
 
-UCI* uci;
-
 UCI::UCI()
 {
     calcLegalMoves();
+    m_Search.setReporter(this);
 
     const auto& hashCallback = [this](const UCIOption& option)
     {
         m_Search.setTTSize(static_cast<i32>(option.intValue()));
     };
+    const auto& pawnHashCallback = [this](const UCIOption& option)
+    {
+        m_Search.setPawnTableSize(static_cast<i32>(option.intValue()));
+    };
+    const auto& evalFileCallback = [this](const UCIOption& option)
+    {
+        if (option.stringValue().empty() || option.stringValue() == "<empty>")
+        {
+            m_Search.setNetwork(nullptr);
+            return;
+        }
+
+        try
+        {
+            m_Search.setNetwork(eval::nnue::loadNetwork(option.stringValue()));
+            std::cout << "info string loaded network " << option.stringValue() << " using "
+                      << eval::nnue::kernelName() << " kernels" << std::endl;
+        }
+        catch (const std::runtime_error& e)
+        {
+            m_Search.setNetwork(nullptr);
+            std::cout << "info string " << e.what() << std::endl;
+        }
+    };
+    const auto& useNNUECallback = [this](const UCIOption& option)
+    {
+        m_Search.setUseNNUE(option.boolValue());
+        if (option.boolValue() && !m_Search.network())
+            std::cout << "info string no network loaded, using the hand crafted eval"
+                      << std::endl;
+    };
+    const auto& bookFileCallback = [this](const UCIOption& option)
+    {
+        m_Book.close();
+        if (option.stringValue().empty() || option.stringValue() == "<empty>")
+            return;
+
+        if (m_Book.open(option.stringValue()))
+            std::cout << "info string loaded book " << option.stringValue() << std::endl;
+        else
+            std::cout << "info string could not load book " << option.stringValue()
+                      << std::endl;
+    };
     const auto& threadsCallback = [this](const UCIOption& option)
     {
         m_Search.setThreads(static_cast<i32>(option.intValue()));
     };
     m_Options = {{"UCI_Chess960", UCIOption("UCI_Chess960", UCIOption::BoolData{false})},
         {"Hash", UCIOption("Hash", {64, 64, 1, 33554432}, hashCallback)},
+        {"PawnHash",
+            UCIOption("PawnHash",
+                {PawnTable::DEFAULT_SIZE_MB, PawnTable::DEFAULT_SIZE_MB, 1, 1024},
+                pawnHashCallback)},
         {"Threads", UCIOption("Threads", {1, 1, 1, 2048}, threadsCallback)},
         {"MoveOverhead", UCIOption("MoveOverhead", {10, 10, 1, 100})},
         {"PrettyPrint", UCIOption("PrettyPrint", UCIOption::BoolData{true})},
-        {"UCI_ShowWDL", UCIOption("UCI_ShowWDL", UCIOption::BoolData{true})}};
+        {"UCI_ShowWDL", UCIOption("UCI_ShowWDL", UCIOption::BoolData{true})},
+        {"EvalFile", UCIOption("EvalFile", UCIOption::StringData{""}, evalFileCallback)},
+        {"UseNNUE", UCIOption("UseNNUE", UCIOption::BoolData{false}, useNNUECallback)},
+        {"BookFile", UCIOption("BookFile", UCIOption::StringData{""}, bookFileCallback)},
+        {"BookDepth", UCIOption("BookDepth", {20, 20, 0, 1000})},
+        {"BookBestMove", UCIOption("BookBestMove", UCIOption::BoolData{false})}};
+#ifdef RUNTIME_EVAL_WEIGHTS
+    m_Options.insert({"EvalWeights",
+        UCIOption("EvalWeights", UCIOption::StringData{""},
+            [this](const UCIOption& option)
+            {
+                if (option.stringValue().empty() || option.stringValue() == "<empty>")
+                    return;
+
+                try
+                {
+                    eval::loadEvalWeights(option.stringValue());
+                    std::cout << "info string loaded eval weights " << option.stringValue()
+                              << std::endl;
+                }
+                catch (const std::runtime_error& e)
+                {
+                    std::cout << "info string " << e.what() << std::endl;
+                }
+                // cached pawn structure scores and evals were computed with the old weights
+                m_Search.newGame();
+            })});
+#endif
 #ifdef EXTERNAL_TUNE
     for (auto& param : search::searchParams())
     {
@@ -46,14 +132,21 @@ UCI::UCI()
             UCIOption(param.name, {param.value, param.defaultValue, param.min, param.max},
                 [&param](const UCIOption& option)
                 {
+                    // searches load the value, and run the callback, on their own threads
                     param.value = static_cast<i32>(option.intValue());
-                    if (param.callback)
-                        param.callback();
                 })});
     }
 #endif
 }
 
+UCI::~UCI()
+{
+    // a search in progress would report to the options after they are destroyed
+    if (m_Search.searching())
+        m_Search.stop();
+    m_Search.setReporter(nullptr);
+}
+
 void UCI::setToFen(const char* fen, bool frc)
 {
     m_Board.setToFen(fen, frc);
@@ -329,12 +422,68 @@ bool UCI::execCommand(const std::string& command)
             if (!m_Search.searching())
                 benchCommand();
             break;
+        case Command::EVAL_BENCH:
+            if (!m_Search.searching())
+                evalBenchCommand();
+            break;
+        case Command::ANALYZE:
+            if (!m_Search.searching())
+                analyzeCommand(stream);
+            break;
+        case Command::MATCH:
+            if (!m_Search.searching())
+                matchCommand(stream);
+            break;
         case Command::DATAGEN:
             datagenCommand(stream);
             break;
         case Command::EXTRACT:
             extractCommand(stream);
             break;
+        case Command::SHUFFLE:
+            shuffleCommand(stream);
+            break;
+        case Command::DEDUP:
+            dedupCommand(stream);
+            break;
+        case Command::COMPRESS:
+        {
+            std::string inputFilename, outputFilename;
+            stream >> inputFilename >> outputFilename;
+            datagen::compressGames(inputFilename, outputFilename);
+            break;
+        }
+        case Command::DECOMPRESS:
+        {
+            std::string inputFilename, outputFilename;
+            stream >> inputFilename >> outputFilename;
+            datagen::decompressGames(inputFilename, outputFilename);
+            break;
+        }
+        case Command::RELABEL:
+            if (!m_Search.searching())
+                relabelCommand(stream);
+            break;
+        case Command::PGN_TO_VIRI:
+            if (!m_Search.searching())
+                pgnToViriCommand(stream);
+            break;
+        case Command::MAKE_BOOK:
+            if (!m_Search.searching())
+                makeBookCommand(stream);
+            break;
+        case Command::TRAIN:
+            if (!m_Search.searching())
+                trainCommand(stream);
+            break;
+        case Command::TUNE:
+            if (!m_Search.searching())
+                tuneCommand(stream);
+            break;
+        case Command::SPSA:
+            if (!m_Search.searching())
+                spsaCommand(stream);
+            break;
     }
     return false;
 }
@@ -367,10 +516,36 @@ UCI::Command UCI::getCommand(const std::string& command) const
         return Command::EVAL;
     else if (command == "bench")
         return Command::BENCH;
+    else if (command == "evalbench")
+        return Command::EVAL_BENCH;
+    else if (command == "analyze")
+        return Command::ANALYZE;
+    else if (command == "match")
+        return Command::MATCH;
     else if (command == "datagen")
         return Command::DATAGEN;
     else if (command == "extract")
         return Command::EXTRACT;
+    else if (command == "shuffle")
+        return Command::SHUFFLE;
+    else if (command == "dedup")
+        return Command::DEDUP;
+    else if (command == "relabel")
+        return Command::RELABEL;
+    else if (command == "compress")
+        return Command::COMPRESS;
+    else if (command == "decompress")
+        return Command::DECOMPRESS;
+    else if (command == "pgn2viri")
+        return Command::PGN_TO_VIRI;
+    else if (command == "makebook")
+        return Command::MAKE_BOOK;
+    else if (command == "train")
+        return Command::TRAIN;
+    else if (command == "tune")
+        return Command::TUNE;
+    else if (command == "spsa")
+        return Command::SPSA;
 
     return Command::INVALID;
 }
@@ -398,6 +573,13 @@ void UCI::uciCommand() const
                           << std::endl;
                 break;
             }
+            case UCIOption::Type::STRING:
+            {
+                const std::string& value = option.second.stringValue();
+                std::cout << "string default " << (value.empty() ? "<empty>" : value)
+                          << std::endl;
+                break;
+            }
             default:
                 break;
         }
@@ -470,6 +652,7 @@ void UCI::goCommand(std::istringstream& stream)
     SearchLimits limits = {};
     limits.maxDepth = 1000;
     limits.overhead = Duration(m_Options["MoveOverhead"].intValue());
+    bool infinite = false;
     while (stream.tellg() != -1)
     {
         stream >> tok;
@@ -529,6 +712,19 @@ void UCI::goCommand(std::istringstream& stream)
         }
         else if (tok == "infinite")
         {
+            infinite = true;
+        }
+    }
+
+    // an infinite search has to wait for stop before sending bestmove
+    if (m_Book.isOpen() && !infinite && m_Board.gamePly() < m_Options["BookDepth"].intValue())
+    {
+        Move bookMove =
+            m_Book.pickMove(m_Board, m_LegalMoves, m_Options["BookBestMove"].boolValue());
+        if (bookMove != Move::nullmove())
+        {
+            reportBestMove(bookMove);
+            return;
         }
     }
     m_Search.run(limits, m_Board);
@@ -575,6 +771,15 @@ void UCI::setOptionCommand(std::istringstream& stream)
             i32 value = parseBool(str);
             if (value != -1)
                 option.setBoolValue(static_cast<bool>(value));
+            break;
+        }
+        case UCIOption::Type::STRING:
+        {
+            // the value is the rest of the line, so paths can contain spaces
+            std::string value;
+            std::getline(stream >> std::ws, value);
+            option.setStringValue(value);
+            break;
         }
         default:
             break;
@@ -605,6 +810,14 @@ void UCI::evalCommand()
     }
     i32 staticEval = eval::evaluateSingle(m_Board);
     std::cout << "static eval: " << staticEval << "cp" << std::endl;
+
+    if (const eval::nnue::Network* network = m_Search.network())
+    {
+        eval::nnue::Accumulator accumulator;
+        accumulator.init(*network, m_Board);
+        i32 nnueEval = eval::nnue::evaluate(*network, accumulator, m_Board.sideToMove());
+        std::cout << "nnue eval: " << nnueEval << "cp" << std::endl;
+    }
 }
 
 void UCI::benchCommand()
@@ -612,6 +825,139 @@ void UCI::benchCommand()
     runBench(m_Search, BENCH_DEPTH);
 }
 
+void UCI::evalBenchCommand()
+{
+    runEvalBench(EVAL_BENCH_ITERATIONS);
+}
+
+void UCI::analyzeCommand(std::istringstream& stream)
+{
+    AnalyzeConfig config = {};
+    stream >> config.epdFilename;
+    config.numThreads = 1;
+    config.hashMB = 64;
+    std::string tok;
+
+    while (stream.tellg() != -1)
+    {
+        stream >> tok;
+        if (tok == "outfile")
+        {
+            stream >> config.outputFilename;
+        }
+        else if (tok == "nodes")
+        {
+            stream >> config.nodes;
+        }
+        else if (tok == "depth")
+        {
+            stream >> config.depth;
+        }
+        else if (tok == "movetime")
+        {
+            stream >> config.movetime;
+        }
+        else if (tok == "threads")
+        {
+            stream >> config.numThreads;
+        }
+        else if (tok == "hash")
+        {
+            stream >> config.hashMB;
+        }
+    }
+
+    config.numThreads = std::max(config.numThreads, 1u);
+    if (config.nodes == 0 && config.depth <= 0 && config.movetime <= 0)
+        config.nodes = 1000000;
+    analyzeEpd(config);
+}
+
+void UCI::matchCommand(std::istringstream& stream)
+{
+    MatchConfig config = {};
+    stream >> config.openingsFilename;
+    config.numGames = 1000;
+    config.numThreads = 1;
+    config.hashMB = 16;
+    config.elo0 = 0;
+    config.elo1 = 5;
+    config.alpha = 0.05;
+    config.beta = 0.05;
+    std::string tok;
+
+    while (stream.tellg() != -1)
+    {
+        stream >> tok;
+        if (tok == "games")
+        {
+            stream >> config.numGames;
+        }
+        else if (tok == "nodes")
+        {
+            stream >> config.nodes;
+        }
+        else if (tok == "tc")
+        {
+            // <base>+<increment> in seconds
+            f64 baseTime = 0, increment = 0;
+            char plus;
+            stream >> baseTime >> plus >> increment;
+            config.baseTime = static_cast<i64>(baseTime * 1000);
+            config.increment = static_cast<i64>(increment * 1000);
+        }
+        else if (tok == "threads")
+        {
+            stream >> config.numThreads;
+        }
+        else if (tok == "hash")
+        {
+            stream >> config.hashMB;
+        }
+        else if (tok == "elo0")
+        {
+            stream >> config.elo0;
+        }
+        else if (tok == "elo1")
+        {
+            stream >> config.elo1;
+        }
+        else if (tok == "alpha")
+        {
+            stream >> config.alpha;
+        }
+        else if (tok == "beta")
+        {
+            stream >> config.beta;
+        }
+        else if (tok == "evalfile1" || tok == "evalfile2")
+        {
+            stream >> config.engines[tok.back() - '1'].evalFile;
+        }
+        else if (tok == "param1" || tok == "param2")
+        {
+            // <name>=<value>
+            std::string param;
+            stream >> param;
+            std::istringstream paramStream(param);
+            std::string name;
+            i32 value = 0;
+            if (!std::getline(paramStream, name, '=') || !(paramStream >> value))
+            {
+                std::cout << "Expected <name>=<value> after " << tok << std::endl;
+                return;
+            }
+            config.engines[tok.back() - '1'].params.push_back({name, value});
+        }
+    }
+
+    config.numThreads = std::max(config.numThreads, 1u);
+    config.hashMB = std::max(config.hashMB, 1);
+    if (config.nodes == 0 && config.baseTime <= 0)
+        config.nodes = 10000;
+    runMatch(config);
+}
+
 void UCI::datagenCommand(std::istringstream& stream)
 {
     std::string tok;
@@ -621,6 +967,7 @@ void UCI::datagenCommand(std::istringstream& stream)
     config.numGames = 1000000;
     config.numThreads = 8;
     config.outputFilename = "datagen.bin";
+    config.openingNodes = 1000;
     while (stream.tellg() != -1)
     {
         stream >> tok;
@@ -648,16 +995,32 @@ void UCI::datagenCommand(std::istringstream& stream)
         {
             config.DFRC = true;
         }
+        else if (tok == "shardgames")
+        {
+            stream >> config.shardGames;
+        }
+        else if (tok == "book")
+        {
+            stream >> config.bookFilename;
+        }
+        else if (tok == "openingnodes")
+        {
+            stream >> config.openingNodes;
+        }
     }
     datagen::runDatagen(config);
 }
 
 void UCI::extractCommand(std::istringstream& stream)
 {
-    std::string inputFilename, outputFilename;
-    stream >> inputFilename >> outputFilename;
-    u32 maxGames = UINT32_MAX;
-    u32 ppg = 10;
+    datagen::ExtractConfig config = {};
+    stream >> config.dataFilename >> config.outputFilename;
+    config.maxGames = UINT32_MAX;
+    config.ppg = 10;
+    config.numThreads = 1;
+    config.maxPositions = 1ull << 25;
+    config.format = datagen::ExtractFormat::TEXT;
+    config.shardSize = 0;
     std::string tok;
 
     while (stream.tellg() != -1)
@@ -665,15 +1028,395 @@ void UCI::extractCommand(std::istringstream& stream)
         stream >> tok;
         if (tok == "maxgames")
         {
-            stream >> maxGames;
+            stream >> config.maxGames;
         }
         else if (tok == "ppg")
         {
-            stream >> ppg;
+            stream >> config.ppg;
+        }
+        else if (tok == "threads")
+        {
+            stream >> config.numThreads;
+        }
+        else if (tok == "maxpositions")
+        {
+            stream >> config.maxPositions;
+        }
+        else if (tok == "format")
+        {
+            std::string format;
+            stream >> format;
+            if (format == "marlin")
+                config.format = datagen::ExtractFormat::MARLINFORMAT;
+            else if (format == "bullet")
+                config.format = datagen::ExtractFormat::BULLETFORMAT;
+            else
+                config.format = datagen::ExtractFormat::TEXT;
+        }
+        else if (tok == "shardsize")
+        {
+            stream >> config.shardSize;
+        }
+    }
+
+    config.numThreads = std::max(config.numThreads, 1u);
+    datagen::extract(config);
+}
+
+void UCI::shuffleCommand(std::istringstream& stream)
+{
+    datagen::ShuffleConfig config = {};
+    stream >> config.outputFilename;
+    config.memoryMB = 1024;
+    config.numThreads = 1;
+    config.shardSize = 0;
+    std::string tok;
+
+    while (stream.tellg() != -1)
+    {
+        stream >> tok;
+        if (tok == "memory")
+        {
+            stream >> config.memoryMB;
+        }
+        else if (tok == "threads")
+        {
+            stream >> config.numThreads;
+        }
+        else if (tok == "tmpdir")
+        {
+            stream >> config.tempDir;
+        }
+        else if (tok == "shardsize")
+        {
+            stream >> config.shardSize;
+        }
+        else
+        {
+            config.inputFilenames.push_back(tok);
+        }
+    }
+
+    config.numThreads = std::max(config.numThreads, 1u);
+    config.memoryMB = std::max<u64>(config.memoryMB, 1);
+    datagen::shuffle(config);
+}
+
+void UCI::dedupCommand(std::istringstream& stream)
+{
+    datagen::DedupConfig config = {};
+    stream >> config.inputFilename >> config.outputFilename;
+    config.format = datagen::DedupFormat::VIRIFORMAT;
+    config.expectedPositions = 0;
+    config.falsePositiveRate = 0.001;
+    config.numThreads = 1;
+    std::string tok;
+
+    while (stream.tellg() != -1)
+    {
+        stream >> tok;
+        if (tok == "format")
+        {
+            std::string format;
+            stream >> format;
+            if (format == "marlin")
+                config.format = datagen::DedupFormat::MARLINFORMAT;
+            else
+                config.format = datagen::DedupFormat::VIRIFORMAT;
+        }
+        else if (tok == "positions")
+        {
+            stream >> config.expectedPositions;
+        }
+        else if (tok == "fpr")
+        {
+            stream >> config.falsePositiveRate;
+        }
+        else if (tok == "threads")
+        {
+            stream >> config.numThreads;
+        }
+    }
+
+    config.numThreads = std::max(config.numThreads, 1u);
+    config.falsePositiveRate = std::clamp(config.falsePositiveRate, 1e-9, 0.5);
+    datagen::dedup(config);
+}
+
+void UCI::relabelCommand(std::istringstream& stream)
+{
+    datagen::RelabelConfig config = {};
+    stream >> config.inputFilename >> config.outputFilename;
+    config.format = datagen::RelabelFormat::VIRIFORMAT;
+    config.softNodes = 20000;
+    config.hardNodes = 8000000;
+    config.depth = MAX_PLY;
+    config.numThreads = 1;
+    config.hashMB = 16;
+    std::string tok;
+
+    while (stream.tellg() != -1)
+    {
+        stream >> tok;
+        if (tok == "format")
+        {
+            std::string format;
+            stream >> format;
+            if (format == "marlin")
+                config.format = datagen::RelabelFormat::MARLINFORMAT;
+            else
+                config.format = datagen::RelabelFormat::VIRIFORMAT;
+        }
+        else if (tok == "softlimit")
+        {
+            stream >> config.softNodes;
+        }
+        else if (tok == "hardlimit")
+        {
+            stream >> config.hardNodes;
+        }
+        else if (tok == "depth")
+        {
+            stream >> config.depth;
+        }
+        else if (tok == "threads")
+        {
+            stream >> config.numThreads;
+        }
+        else if (tok == "hash")
+        {
+            stream >> config.hashMB;
+        }
+    }
+
+    config.numThreads = std::max(config.numThreads, 1u);
+    config.depth = std::clamp(config.depth, 1, MAX_PLY);
+    config.hashMB = std::max(config.hashMB, 1);
+    datagen::relabel(config);
+}
+
+void UCI::pgnToViriCommand(std::istringstream& stream)
+{
+    datagen::PgnConfig config = {};
+    stream >> config.inputFilename >> config.outputFilename;
+    config.scores = datagen::PgnScores::COMMENTS;
+    config.searchNodes = 5000;
+    config.numThreads = 1;
+    std::string tok;
+
+    while (stream.tellg() != -1)
+    {
+        stream >> tok;
+        if (tok == "scores")
+        {
+            std::string scores;
+            stream >> scores;
+            if (scores == "search")
+                config.scores = datagen::PgnScores::SEARCH;
+            else if (scores == "none")
+                config.scores = datagen::PgnScores::NONE;
+            else
+                config.scores = datagen::PgnScores::COMMENTS;
+        }
+        else if (tok == "nodes")
+        {
+            stream >> config.searchNodes;
+        }
+        else if (tok == "threads")
+        {
+            stream >> config.numThreads;
+        }
+    }
+
+    config.numThreads = std::max(config.numThreads, 1u);
+    config.searchNodes = std::max<u64>(config.searchNodes, 1);
+    datagen::pgnToViri(config);
+}
+
+void UCI::makeBookCommand(std::istringstream& stream)
+{
+    datagen::MakeBookConfig config = {};
+    stream >> config.dataFilename >> config.outputFilename;
+    config.maxPly = 20;
+    config.minGames = 2;
+    config.numThreads = 1;
+    std::string tok;
+
+    while (stream.tellg() != -1)
+    {
+        stream >> tok;
+        if (tok == "depth")
+        {
+            stream >> config.maxPly;
+        }
+        else if (tok == "mingames")
+        {
+            stream >> config.minGames;
+        }
+        else if (tok == "threads")
+        {
+            stream >> config.numThreads;
+        }
+    }
+
+    config.numThreads = std::max(config.numThreads, 1u);
+    datagen::makeBook(config);
+}
+
+void UCI::trainCommand(std::istringstream& stream)
+{
+    tune::TrainConfig config = {};
+    stream >> config.dataFilename;
+    config.outputFilename = "trained.nnue";
+    config.format = tune::DataFormat::VIRIFORMAT;
+    config.epochs = 10;
+    config.batchSize = 16384;
+    config.numThreads = 1;
+    config.learningRate = 0.001f;
+    config.wdlWeight = 0.3f;
+    std::string tok;
+
+    while (stream.tellg() != -1)
+    {
+        stream >> tok;
+        if (tok == "outfile")
+        {
+            stream >> config.outputFilename;
+        }
+        else if (tok == "epochs")
+        {
+            stream >> config.epochs;
+        }
+        else if (tok == "batchsize")
+        {
+            stream >> config.batchSize;
+        }
+        else if (tok == "threads")
+        {
+            stream >> config.numThreads;
+        }
+        else if (tok == "lr")
+        {
+            stream >> config.learningRate;
+        }
+        else if (tok == "wdl")
+        {
+            stream >> config.wdlWeight;
+        }
+        else if (tok == "format")
+        {
+            std::string format;
+            stream >> format;
+            if (format == "marlin")
+                config.format = tune::DataFormat::MARLINFORMAT;
+            else
+                config.format = tune::DataFormat::VIRIFORMAT;
+        }
+    }
+
+    config.numThreads = std::max(config.numThreads, 1u);
+    config.batchSize = std::max(config.batchSize, 1u);
+    tune::runTraining(config);
+}
+
+void UCI::tuneCommand(std::istringstream& stream)
+{
+    tune::TuneConfig config = {};
+    stream >> config.dataFilename;
+    config.outputFilename = "eval_constants.h";
+    config.epochs = 1000;
+    config.numThreads = 1;
+    config.learningRate = 1.0f;
+    config.wdlWeight = 1.0f;
+    std::string tok;
+
+    while (stream.tellg() != -1)
+    {
+        stream >> tok;
+        if (tok == "outfile")
+        {
+            stream >> config.outputFilename;
+        }
+        else if (tok == "weightsfile")
+        {
+            stream >> config.weightsFilename;
+        }
+        else if (tok == "epochs")
+        {
+            stream >> config.epochs;
+        }
+        else if (tok == "threads")
+        {
+            stream >> config.numThreads;
+        }
+        else if (tok == "lr")
+        {
+            stream >> config.learningRate;
+        }
+        else if (tok == "wdl")
+        {
+            stream >> config.wdlWeight;
+        }
+    }
+
+    config.numThreads = std::max(config.numThreads, 1u);
+    tune::runTuning(config);
+}
+
+void UCI::spsaCommand(std::istringstream& stream)
+{
+    tune::SpsaConfig config = {};
+    stream >> config.openingsFilename;
+    config.outputFilename = "spsa.txt";
+    config.iterations = 10000;
+    config.nodes = 5000;
+    config.numThreads = 1;
+    config.hashMB = 16;
+    config.learningRate = 0.002;
+    std::string tok;
+
+    while (stream.tellg() != -1)
+    {
+        stream >> tok;
+        if (tok == "outfile")
+        {
+            stream >> config.outputFilename;
+        }
+        else if (tok == "pairs")
+        {
+            stream >> config.iterations;
+        }
+        else if (tok == "nodes")
+        {
+            stream >> config.nodes;
+        }
+        else if (tok == "threads")
+        {
+            stream >> config.numThreads;
+        }
+        else if (tok == "hash")
+        {
+            stream >> config.hashMB;
+        }
+        else if (tok == "lr")
+        {
+            stream >> config.learningRate;
+        }
+        else if (tok == "params")
+        {
+            // comma separated names
+            std::string names;
+            stream >> names;
+            std::istringstream namesStream(names);
+            for (std::string name; std::getline(namesStream, name, ',');)
+                config.paramNames.push_back(name);
         }
     }
 
-    datagen::extract(inputFilename, outputFilename, maxGames, ppg);
+    config.numThreads = std::max(config.numThreads, 1u);
+    config.hashMB = std::max(config.hashMB, 1);
+    config.nodes = std::max<u64>(config.nodes, 1);
+    tune::runSpsa(config);
 }
 
 }
@@ -2,6 +2,7 @@
 
 #include "../board.h"
 #include "../movegen.h"
+#include "../polyglot.h"
 #include "../search.h"
 #include "../time_man.h"
 #include "uci_option.h"
@@ -12,11 +13,11 @@
 namespace uci
 {
 
-class UCI
+class UCI : public search::SearchReporter
 {
 public:
     UCI();
-    ~UCI() = default;
+    ~UCI();
 
     enum class Command
     {
@@ -35,13 +36,26 @@ public:
         RUN_PERFT_TESTS,
         EVAL,
         BENCH,
+        EVAL_BENCH,
+        ANALYZE,
+        MATCH,
         DATAGEN,
-        EXTRACT
+        EXTRACT,
+        SHUFFLE,
+        DEDUP,
+        RELABEL,
+        COMPRESS,
+        DECOMPRESS,
+        PGN_TO_VIRI,
+        MAKE_BOOK,
+        TRAIN,
+        TUNE,
+        SPSA
     };
 
     void run(std::string cmd);
-    void reportSearchInfo(const SearchInfo& info) const;
-    void reportBestMove(Move bestMove) const;
+    void reportSearchInfo(const SearchInfo& info) const override;
+    void reportBestMove(Move bestMove) const override;
 
 private:
     std::unique_lock<std::mutex> lockStdout() const;
@@ -63,17 +77,27 @@ private:
     void evalCommand();
     void perftCommand(std::istringstream& stream);
     void benchCommand();
+    void evalBenchCommand();
+    void analyzeCommand(std::istringstream& stream);
+    void matchCommand(std::istringstream& stream);
     void datagenCommand(std::istringstream& stream);
     void extractCommand(std::istringstream& stream);
+    void shuffleCommand(std::istringstream& stream);
+    void dedupCommand(std::istringstream& stream);
+    void relabelCommand(std::istringstream& stream);
+    void pgnToViriCommand(std::istringstream& stream);
+    void makeBookCommand(std::istringstream& stream);
+    void trainCommand(std::istringstream& stream);
+    void tuneCommand(std::istringstream& stream);
+    void spsaCommand(std::istringstream& stream);
 
     mutable std::mutex m_StdoutMutex;
     Board m_Board;
     MoveList m_LegalMoves;
     search::Search m_Search;
+    polyglot::Book m_Book;
 
     std::unordered_map<std::string, UCIOption> m_Options;
 };
 
-extern UCI* uci;
-
 }
@@ -9,7 +9,6 @@
 namespace uci
 {
 
-// currently only supports integers
 class UCIOption
 {
 public:
@@ -18,7 +17,8 @@ public:
     {
         NONE,
         BOOL, // check
-        INT // spin
+        INT, // spin
+        STRING // string
     };
 
     struct IntData
@@ -34,15 +34,23 @@ public:
         bool value;
     };
 
+    struct StringData
+    {
+        std::string value;
+    };
+
     UCIOption();
     UCIOption(std::string_view name, IntData data, Callback callback = Callback());
     UCIOption(std::string_view name, BoolData data, Callback callback = Callback());
+    UCIOption(std::string_view name, StringData data, Callback callback = Callback());
     void setIntValue(i64 value);
     void setBoolValue(bool value);
+    void setStringValue(const std::string& value);
 
     Type type() const;
     i64 intValue() const;
     bool boolValue() const;
+    const std::string& stringValue() const;
     const IntData& intData() const;
     const std::string& name() const;
 
@@ -50,7 +58,7 @@ private:
     Type m_Type;
     std::string m_Name;
     Callback m_Callback;
-    std::variant<IntData, BoolData> m_Data;
+    std::variant<IntData, BoolData, StringData> m_Data;
 };
 
 inline UCIOption::UCIOption()
@@ -68,6 +76,11 @@ inline UCIOption::UCIOption(std::string_view name, BoolData data, Callback callb
 {
 }
 
+inline UCIOption::UCIOption(std::string_view name, StringData data, Callback callback)
+    : m_Type(Type::STRING), m_Name(name), m_Callback(callback), m_Data(data)
+{
+}
+
 inline void UCIOption::setIntValue(i64 value)
 {
     assert(m_Type == Type::INT);
@@ -84,6 +97,14 @@ inline void UCIOption::setBoolValue(bool value)
         m_Callback(*this);
 }
 
+inline void UCIOption::setStringValue(const std::string& value)
+{
+    assert(m_Type == Type::STRING);
+    std::get<StringData>(m_Data).value = value;
+    if (m_Callback)
+        m_Callback(*this);
+}
+
 inline UCIOption::Type UCIOption::type() const
 {
     return m_Type;
@@ -101,6 +122,12 @@ inline bool UCIOption::boolValue() const
     return std::get<BoolData>(m_Data).value;
 }
 
+inline const std::string& UCIOption::stringValue() const
+{
+    assert(m_Type == Type::STRING);
+    return std::get<StringData>(m_Data).value;
+}
+
 inline const UCIOption::IntData& UCIOption::intData() const
 {
     assert(m_Type == Type::INT);
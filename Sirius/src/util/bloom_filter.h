@@ -0,0 +1,91 @@
+#pragma once
+
+#include "../defs.h"
+#include "murmur.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <memory>
+
+// a bloom filter where all of the bits for a key are in the same 64 byte block,
+// so that each lookup only touches one cache line. Threads can insert at the same
+// time as long as each owns different blocks, since an insert isn't atomic
+class BlockedBloomFilter
+{
+public:
+    BlockedBloomFilter(u64 expectedKeys, f64 falsePositiveRate);
+
+    // the block that the bits for key are in
+    u64 blockIndex(u64 key) const;
+
+    // sets the bits for key, and returns whether they were all already set,
+    // which means the key was probably inserted before
+    bool insert(u64 key);
+
+    u64 sizeBytes() const;
+    u32 hashCount() const;
+
+private:
+    static constexpr u32 BLOCK_BITS = 512;
+
+    struct alignas(64) Block
+    {
+        std::array<u64, BLOCK_BITS / 64> words;
+    };
+
+    std::unique_ptr<Block[]> m_Blocks;
+    u64 m_BlockCount;
+    u32 m_HashCount;
+};
+
+inline BlockedBloomFilter::BlockedBloomFilter(u64 expectedKeys, f64 falsePositiveRate)
+{
+    // the optimal size and number of hashes for an unblocked filter, blocking
+    // raises the false positive rate slightly above this
+    f64 ln2 = std::log(2.0);
+    f64 keys = static_cast<f64>(std::max<u64>(expectedKeys, 1));
+    f64 bits = -keys * std::log(falsePositiveRate) / (ln2 * ln2);
+    m_BlockCount = std::max<u64>(static_cast<u64>(std::ceil(bits / BLOCK_BITS)), 1);
+    m_HashCount = std::clamp(static_cast<u32>(std::lround(bits / keys * ln2)), 1u, 16u);
+    m_Blocks = std::make_unique<Block[]>(m_BlockCount);
+}
+
+inline u64 BlockedBloomFilter::blockIndex(u64 key) const
+{
+    return murmurHash3(key) % m_BlockCount;
+}
+
+inline bool BlockedBloomFilter::insert(u64 key)
+{
+    u64 hash = murmurHash3(key);
+    Block& block = m_Blocks[hash % m_BlockCount];
+
+    // double hashing within the block
+    u64 bitHash = murmurHash3(hash ^ 0x9e3779b97f4a7c15);
+    u32 bit = static_cast<u32>(bitHash);
+    u32 step = static_cast<u32>(bitHash >> 32) | 1;
+
+    bool present = true;
+    for (u32 i = 0; i < m_HashCount; i++, bit += step)
+    {
+        u32 idx = bit % BLOCK_BITS;
+        u64 mask = 1ull << (idx % 64);
+        if (!(block.words[idx / 64] & mask))
+        {
+            block.words[idx / 64] |= mask;
+            present = false;
+        }
+    }
+    return present;
+}
+
+inline u64 BlockedBloomFilter::sizeBytes() const
+{
+    return m_BlockCount * sizeof(Block);
+}
+
+inline u32 BlockedBloomFilter::hashCount() const
+{
+    return m_HashCount;
+}
@@ -0,0 +1,100 @@
+#include "mapped_file.h"
+
+#include <filesystem>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const std::string& filename)
+{
+    close();
+
+    std::error_code ec;
+    u64 size = std::filesystem::file_size(filename, ec);
+    if (ec || size == 0)
+        return false;
+
+#ifdef _WIN32
+    m_FileHandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_FileHandle == INVALID_HANDLE_VALUE)
+    {
+        m_FileHandle = nullptr;
+        return false;
+    }
+    m_MappingHandle = CreateFileMappingA(m_FileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!m_MappingHandle)
+    {
+        close();
+        return false;
+    }
+    m_Data = static_cast<const u8*>(MapViewOfFile(m_MappingHandle, FILE_MAP_READ, 0, 0, 0));
+#else
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    m_Data = data == MAP_FAILED ? nullptr : static_cast<const u8*>(data);
+#endif
+    if (!m_Data)
+    {
+        close();
+        return false;
+    }
+    m_Size = size;
+    return true;
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+    if (m_Data)
+        UnmapViewOfFile(m_Data);
+    if (m_MappingHandle)
+        CloseHandle(m_MappingHandle);
+    if (m_FileHandle)
+        CloseHandle(m_FileHandle);
+    m_MappingHandle = nullptr;
+    m_FileHandle = nullptr;
+#else
+    if (m_Data)
+        munmap(const_cast<u8*>(m_Data), m_Size);
+#endif
+    m_Data = nullptr;
+    m_Size = 0;
+}
+
+bool MappedFile::isOpen() const
+{
+    return m_Data != nullptr;
+}
+
+const u8* MappedFile::data() const
+{
+    return m_Data;
+}
+
+usize MappedFile::size() const
+{
+    return m_Size;
+}
+
+void MappedFile::adviseSequential() const
+{
+#ifndef _WIN32
+    if (m_Data)
+        madvise(const_cast<u8*>(m_Data), m_Size, MADV_SEQUENTIAL);
+#endif
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "../defs.h"
+
+#include <string>
+
+// a read only memory mapping of a whole file
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // false if the file can't be mapped, which includes it being empty
+    bool open(const std::string& filename);
+    void close();
+
+    bool isOpen() const;
+    const u8* data() const;
+    usize size() const;
+
+    // hints that the file will be read from start to end
+    void adviseSequential() const;
+
+private:
+    const u8* m_Data = nullptr;
+    usize m_Size = 0;
+#ifdef _WIN32
+    void* m_FileHandle = nullptr;
+    void* m_MappingHandle = nullptr;
+#endif
+};
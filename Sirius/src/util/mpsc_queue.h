@@ -0,0 +1,73 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+// a lock free queue for any number of producers and one consumer. Producers push onto
+// a linked stack, and the consumer takes the whole stack at once and reverses it
+template<typename T>
+class MPSCQueue
+{
+public:
+    MPSCQueue() = default;
+    ~MPSCQueue();
+
+    MPSCQueue(const MPSCQueue&) = delete;
+    MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+    void push(T value);
+    // blocks until something has been pushed, and returns everything
+    // that has been pushed since the last call in the order it was pushed
+    std::vector<T> popAll();
+
+private:
+    struct Node
+    {
+        T value;
+        Node* next;
+    };
+
+    std::atomic<Node*> m_Head = nullptr;
+};
+
+template<typename T>
+MPSCQueue<T>::~MPSCQueue()
+{
+    Node* node = m_Head.load();
+    while (node)
+    {
+        Node* next = node->next;
+        delete node;
+        node = next;
+    }
+}
+
+template<typename T>
+void MPSCQueue<T>::push(T value)
+{
+    Node* node = new Node{std::move(value), m_Head.load(std::memory_order_relaxed)};
+    while (!m_Head.compare_exchange_weak(
+        node->next, node, std::memory_order_release, std::memory_order_relaxed))
+        ;
+    m_Head.notify_one();
+}
+
+template<typename T>
+std::vector<T> MPSCQueue<T>::popAll()
+{
+    Node* node;
+    while ((node = m_Head.exchange(nullptr, std::memory_order_acquire)) == nullptr)
+        m_Head.wait(nullptr, std::memory_order_acquire);
+
+    std::vector<T> values;
+    while (node)
+    {
+        Node* next = node->next;
+        values.push_back(std::move(node->value));
+        delete node;
+        node = next;
+    }
+    std::reverse(values.begin(), values.end());
+    return values;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "../defs.h"
+
+#include <thread>
+#include <vector>
+
+// runs func(threadIdx, begin, end) on numThreads threads, splitting [0, count)
+// into one contiguous range for each thread, and waits for all of them
+template<typename Func>
+void parallelFor(u32 numThreads, usize count, const Func& func)
+{
+    std::vector<std::jthread> threads;
+    threads.reserve(numThreads);
+    for (u32 i = 0; i < numThreads; i++)
+        threads.emplace_back(func, i, count * i / numThreads, count * (i + 1) / numThreads);
+}
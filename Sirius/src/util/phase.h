@@ -0,0 +1,18 @@
+#pragma once
+
+#include "../board.h"
+#include "../defs.h"
+
+#include <algorithm>
+
+// the phases of boardPhase go from 0 to PHASE_COUNT - 1
+constexpr i32 PHASE_COUNT = 25;
+
+// weighted count of non pawn material, from 0 to 24
+inline i32 boardPhase(const Board& board)
+{
+    i32 phase = 4 * board.pieces(PieceType::QUEEN).popcount()
+        + 2 * board.pieces(PieceType::ROOK).popcount()
+        + (board.pieces(PieceType::BISHOP) | board.pieces(PieceType::KNIGHT)).popcount();
+    return std::min(phase, PHASE_COUNT - 1);
+}